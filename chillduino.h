@@ -24,6 +24,10 @@
 #ifndef CHILLDUINO_H
 #define CHILLDUINO_H
 
+#include "chillduino_modes.h"
+#include "chillduino_statistics.h"
+#include "chillduino_thermistor.h"
+
 /**
  * The software version for the chillduino.
  *
@@ -75,15 +79,88 @@
  * The number of chillduino modes.
  *
  * This number is used in the software to allow the user to cycle through
- * the mode settings.
+ * the mode settings, unless a table of mode profiles is given.
  */
 #define CHILLDUINO_MODE_COUNT   4
 
+/**
+ * The number of ticks returned when no timer is running.
+ *
+ */
+#define CHILLDUINO_NEVER ((unsigned long) -1)
+
+/**
+ * The number of values written by Chillduino::getState().
+ *
+ */
+#define CHILLDUINO_STATE_SIZE   51
+
+/**
+ * The limits on how much a single defrost can scale the learned
+ * defrost interval, as multiples of 1/256.
+ *
+ * An adaptive defrost that ends early lengthens the next interval by
+ * at most four times, and one that times out shortens it by at most
+ * four times, so a single odd defrost cannot swing the schedule.
+ *
+ */
+#define CHILLDUINO_DEFROST_MINIMUM_SCALE 64
+#define CHILLDUINO_DEFROST_MAXIMUM_SCALE 1024
+
+/**
+ * The share of each correction applied to the learned defrost
+ * interval, as a right shift. A shift of one moves the interval half
+ * way towards the interval the last defrost asked for.
+ *
+ */
+#define CHILLDUINO_DEFROST_LEARNING_SHIFT 1
+
+/**
+ * The number of thermistor samples fitted to find how fast the fresh
+ * food is cooling.
+ *
+ */
+#define CHILLDUINO_SLOPE_SAMPLES 4
+
+/**
+ * The slope of the fitted samples is their sum weighted by
+ * 2i - (CHILLDUINO_SLOPE_SAMPLES - 1), in counts per sample times this
+ * scale.
+ *
+ */
+#define CHILLDUINO_SLOPE_SCALE \
+  (CHILLDUINO_SLOPE_SAMPLES * \
+    (CHILLDUINO_SLOPE_SAMPLES * CHILLDUINO_SLOPE_SAMPLES - 1) / 6)
+
+/**
+ * The fraction bits of the learned coast, which is in samples.
+ *
+ */
+#define CHILLDUINO_COAST_SHIFT 4
+
+/**
+ * The largest learned coast, in 1/16 samples.
+ *
+ */
+#define CHILLDUINO_MAXIMUM_COAST 0xFFFF
+
 class Chillduino {
   private:
+#ifdef CHILLDUINO_STATISTICS
+    ChillduinoStatistics _statistics;
+#endif
     int _minimumFreshFoodThermistorReading;
     int _currentFreshFoodThermistorReading;
     int _maximumFreshFoodThermistorReading;
+    int _shedMarginTemperature;
+    int _shedMaximumFreshFoodThermistorReading;
+    int _slopeReadings[CHILLDUINO_SLOPE_SAMPLES];
+    int _slopeReadingCount;
+    int _slope;
+    int _stopReading;
+    int _lowestReading;
+    int _stopSlope;
+    unsigned int _learnedCoast;
     int _previousDefrostSwitchReading;
     int _currentDefrostSwitchReading;
     int _previousDoorSwitchReading;
@@ -91,15 +168,21 @@ class Chillduino {
     int _previousModeSwitchReading;
     int _currentModeSwitchReading;
     int _mode;
+    int _modeCount;
     int _minimumOpensForForceDefrost;
     int _remainingOpensForForceDefrost;
     unsigned long _minimumCompressorTicksPerDefrost;
     unsigned long _maximumCompressorTicksPerDefrost;
     unsigned long _remainingCompressorTicksUntilDefrost;
     unsigned long _defrostDurationInTicks;
+    unsigned long _targetDefrostDurationInTicks;
+    unsigned long _learnedCompressorTicksPerDefrost;
     unsigned long _remainingTicksWhileDefrosting;
     unsigned long _remainingTicksForCompressorChange;
     unsigned long _minimumTicksForCompressorChange;
+    unsigned long _startDelayInTicks;
+    unsigned long _slopeSampleTicks;
+    unsigned long _remainingTicksForSlopeSample;
     unsigned long _remainingTicksForDoorClose;
     unsigned long _minimumTicksForDoorClose;
     unsigned long _remainingTicksForHeldModeSwitch;
@@ -112,12 +195,18 @@ class Chillduino {
     unsigned long _remainingTicksForBimetalCutoff;
     unsigned long _minimumTicksForBimetalCutoff;
     unsigned long _doorOpenDurationInTicks;
+    unsigned long _modeDefrostDurationInTicks;
+    unsigned long _modeTicksForCompressorChange;
+    const ChillduinoModeProfile *_modeProfiles;
     bool _isCompressorRunning;
     bool _isDefrostRunning;
     bool _isBimetalCutoff;
     bool _isDoorOpen;
     bool _isWiFiToggled;
     bool _isChanged;
+    bool _isDefrostForced;
+    bool _isShedding;
+    bool _isCoasting;
 
   public:
 
@@ -126,9 +215,21 @@ class Chillduino {
      *
      */
     Chillduino(void) :
+#ifdef CHILLDUINO_STATISTICS
+      _statistics(),
+#endif
       _minimumFreshFoodThermistorReading(0),
       _currentFreshFoodThermistorReading(0),
       _maximumFreshFoodThermistorReading(0),
+      _shedMarginTemperature(0),
+      _shedMaximumFreshFoodThermistorReading(0),
+      _slopeReadings(),
+      _slopeReadingCount(0),
+      _slope(0),
+      _stopReading(0),
+      _lowestReading(0),
+      _stopSlope(0),
+      _learnedCoast(0),
       _previousDefrostSwitchReading(0),
       _currentDefrostSwitchReading(0),
       _previousDoorSwitchReading(0),
@@ -136,15 +237,21 @@ class Chillduino {
       _previousModeSwitchReading(0),
       _currentModeSwitchReading(0),
       _mode(CHILLDUINO_MODE_COLDER),
+      _modeCount(CHILLDUINO_MODE_COUNT),
       _minimumOpensForForceDefrost(0),
       _remainingOpensForForceDefrost(0),
       _minimumCompressorTicksPerDefrost(0),
       _maximumCompressorTicksPerDefrost(0),
       _remainingCompressorTicksUntilDefrost(0),
       _defrostDurationInTicks(0),
+      _targetDefrostDurationInTicks(0),
+      _learnedCompressorTicksPerDefrost(0),
       _remainingTicksWhileDefrosting(0),
       _remainingTicksForCompressorChange(0),
       _minimumTicksForCompressorChange(0),
+      _startDelayInTicks(0),
+      _slopeSampleTicks(0),
+      _remainingTicksForSlopeSample(0),
       _remainingTicksForDoorClose(0),
       _minimumTicksForDoorClose(0),
       _remainingTicksForHeldModeSwitch(0),
@@ -157,12 +264,18 @@ class Chillduino {
       _remainingTicksForBimetalCutoff(0),
       _minimumTicksForBimetalCutoff(0),
       _doorOpenDurationInTicks(0),
+      _modeDefrostDurationInTicks(0),
+      _modeTicksForCompressorChange(0),
+      _modeProfiles(0),
       _isCompressorRunning(false),
       _isDefrostRunning(false),
       _isBimetalCutoff(false),
       _isDoorOpen(false),
       _isWiFiToggled(false),
-      _isChanged(false) { }
+      _isChanged(false),
+      _isDefrostForced(false),
+      _isShedding(false),
+      _isCoasting(false) { }
 
     /**
      * Sets the minimum fresh food thermistor reading allowed.
@@ -176,6 +289,14 @@ class Chillduino {
       return *this;
     }
 
+    /**
+     * Gets the minimum fresh food thermistor reading allowed.
+     *
+     */
+    int getMinimumFreshFoodThermistorReading(void) const {
+      return _minimumFreshFoodThermistorReading;
+    }
+
     /**
      * Sets the current fresh food thermistor reading.
      *
@@ -198,9 +319,94 @@ class Chillduino {
      */
     Chillduino& setMaximumFreshFoodThermistorReading(int reading) {
       _maximumFreshFoodThermistorReading = reading;
+      updateShedMaximum();
+      return *this;
+    }
+
+    /**
+     * Gets the maximum fresh food thermistor reading allowed.
+     *
+     */
+    int getMaximumFreshFoodThermistorReading(void) const {
+      return _maximumFreshFoodThermistorReading;
+    }
+
+    /**
+     * Sets the minimum fresh food temperature allowed, in tenths of a
+     * degree Celsius.
+     *
+     * The temperature is converted to the nearest thermistor reading
+     * and behaves exactly as setMinimumFreshFoodThermistorReading().
+     *
+     */
+    Chillduino& setMinimumFreshFoodTemperature(int temperature) {
+      _minimumFreshFoodThermistorReading =
+        chillduinoThermistorReading(temperature);
+      return *this;
+    }
+
+    /**
+     * Sets the current fresh food temperature, in tenths of a degree
+     * Celsius.
+     *
+     * This is meant for simulation. The chillduino itself should set
+     * the thermistor reading, which avoids converting every sample.
+     *
+     */
+    Chillduino& setCurrentFreshFoodTemperature(int temperature) {
+      _currentFreshFoodThermistorReading =
+        chillduinoThermistorReading(temperature);
       return *this;
     }
 
+    /**
+     * Sets the maximum fresh food temperature allowed, in tenths of a
+     * degree Celsius.
+     *
+     * The temperature is converted to the nearest thermistor reading
+     * and behaves exactly as setMaximumFreshFoodThermistorReading().
+     *
+     */
+    Chillduino& setMaximumFreshFoodTemperature(int temperature) {
+      _maximumFreshFoodThermistorReading =
+        chillduinoThermistorReading(temperature);
+      updateShedMaximum();
+      return *this;
+    }
+
+    /**
+     * Gets the minimum fresh food temperature allowed, in tenths of a
+     * degree Celsius.
+     *
+     */
+    int getMinimumFreshFoodTemperature(void) const {
+      return chillduinoThermistorTemperature(
+        _minimumFreshFoodThermistorReading);
+    }
+
+    /**
+     * Gets the current fresh food temperature, in tenths of a degree
+     * Celsius.
+     *
+     * The conversion is accurate to within CHILLDUINO_THERMISTOR_TOLERANCE
+     * over the range of temperatures a refrigerator sees.
+     *
+     */
+    int getFreshFoodTemperature(void) const {
+      return chillduinoThermistorTemperature(
+        _currentFreshFoodThermistorReading);
+    }
+
+    /**
+     * Gets the maximum fresh food temperature allowed, in tenths of a
+     * degree Celsius.
+     *
+     */
+    int getMaximumFreshFoodTemperature(void) const {
+      return chillduinoThermistorTemperature(
+        _maximumFreshFoodThermistorReading);
+    }
+
     /**
      * Sets the minimum amount of time (in ticks) that the compressor must
      * run before running the defrost.
@@ -216,6 +422,14 @@ class Chillduino {
       return *this;
     }
 
+    /**
+     * Gets the minimum compressor ticks per defrost.
+     *
+     */
+    unsigned long getMinimumCompressorTicksPerDefrost(void) const {
+      return _minimumCompressorTicksPerDefrost;
+    }
+
     /**
      * Sets the maximum amount of time (in ticks) that the compressor must
      * run before running the defrost.
@@ -231,6 +445,14 @@ class Chillduino {
       return *this;
     }
 
+    /**
+     * Gets the maximum compressor ticks per defrost.
+     *
+     */
+    unsigned long getMaximumCompressorTicksPerDefrost(void) const {
+      return _maximumCompressorTicksPerDefrost;
+    }
+
     /**
      * Gets the amount of time (in ticks) the compressor still needs to
      * be ran before a defrost cycle is able to be started.
@@ -265,6 +487,55 @@ class Chillduino {
       return *this;
     }
 
+    /**
+     * Sets how long (in ticks) each defrost should ideally take,
+     * enabling adaptive defrost.
+     *
+     * The time the bimetal takes to end a defrost tells how much frost
+     * there was. After each defrost the interval until the next one is
+     * scaled by the target over the time the defrost took, so a unit
+     * that builds up little frost defrosts less often and wastes less
+     * heater energy, while one that times out defrosts sooner. The
+     * interval is kept between the minimum and maximum compressor
+     * ticks per defrost, and the door still brings the next defrost
+     * forward. The target should be shorter than the defrost duration
+     * and below 2^24 ticks (4.6 hours), and the maximum compressor ticks
+     * per defrost below 2^30 ticks (298 hours), so that the fixed-point
+     * scaling cannot overflow. Setting a target of zero (the default)
+     * disables adaptive defrost.
+     *
+     */
+    Chillduino& setTargetDefrostDurationInTicks(unsigned long ticks) {
+      _targetDefrostDurationInTicks = ticks;
+      return *this;
+    }
+
+    /**
+     * Gets the learned amount of time (in ticks) the compressor runs
+     * between adaptive defrosts.
+     *
+     * This is zero until the first adaptive defrost has ended. It
+     * should be persisted whenever it changes, which is at most once
+     * per defrost.
+     *
+     */
+    unsigned long getLearnedCompressorTicksPerDefrost(void) const {
+      return _learnedCompressorTicksPerDefrost;
+    }
+
+    /**
+     * Sets the learned amount of time (in ticks) the compressor runs
+     * between adaptive defrosts.
+     *
+     * This should only be used after reboot to restore the persisted
+     * value. Zero starts learning over from the maximum.
+     *
+     */
+    Chillduino& setLearnedCompressorTicksPerDefrost(unsigned long ticks) {
+      _learnedCompressorTicksPerDefrost = ticks;
+      return *this;
+    }
+
     /**
      * Sets the minimum time (in ticks) that the compressor must wait
      * after changing state before it is able to change state again.
@@ -279,6 +550,108 @@ class Chillduino {
       return *this;
     }
 
+    /**
+     * Sets the time (in ticks) between the thermistor samples used to
+     * predict the end of a compressor run, enabling predictive cutoff.
+     *
+     * The evaporator keeps cooling the fresh food after the compressor
+     * stops, so a run that ends at the minimum reading overshoots the
+     * band, and the compressor lockout then keeps the fresh food too
+     * cold. While the compressor runs, a least-squares fit over the last
+     * CHILLDUINO_SLOPE_SAMPLES samples gives how fast the fresh food is
+     * cooling. After each run the distance the reading kept falling is
+     * divided by that rate to learn how long the fresh food coasts, and
+     * later runs end once the predicted coast would reach the minimum
+     * reading. The samples should span a few counts of cooling. Setting
+     * zero (the default) disables predictive cutoff.
+     *
+     */
+    Chillduino& setSlopeSampleTicks(unsigned long ticks) {
+      _slopeSampleTicks = ticks;
+      return *this;
+    }
+
+    /**
+     * Gets how long the fresh food keeps cooling after the compressor
+     * stops, in 1/16 slope samples.
+     *
+     */
+    unsigned int getLearnedCoast(void) const {
+      return _learnedCoast;
+    }
+
+    /**
+     * Sets how long the fresh food keeps cooling after the compressor
+     * stops, in 1/16 slope samples.
+     *
+     * This should only be used after reboot to restore a previously
+     * learned value.
+     *
+     */
+    Chillduino& setLearnedCoast(unsigned int coast) {
+      _learnedCoast = coast;
+      return *this;
+    }
+
+    /**
+     * Sets the time (in ticks) the compressor waits before it is able
+     * to start after power is restored or a grid shed ends.
+     *
+     * When power returns to a building every unit finds itself warm at
+     * the same moment. Giving each unit a different delay, such as one
+     * derived from its UUID, staggers the compressor starts so that
+     * their inrush currents do not add up. The delay begins as soon as
+     * it is set, so this should be set once after reboot.
+     *
+     */
+    Chillduino& setStartDelayInTicks(unsigned long ticks) {
+      _startDelayInTicks = ticks;
+      delayCompressorStart();
+      return *this;
+    }
+
+    /**
+     * Sets how far (in tenths of a degree Celsius) above the maximum
+     * temperature the fresh food may warm while a grid shed defers
+     * compressor starts.
+     *
+     * The limit follows the maximum, so a mode change moves it too.
+     *
+     */
+    Chillduino& setShedMarginTemperature(int margin) {
+      _shedMarginTemperature = margin;
+      updateShedMaximum();
+      return *this;
+    }
+
+    /**
+     * Starts or ends a grid shed.
+     *
+     * While shedding, a compressor that is off waits until the fresh
+     * food is warmer than the maximum reading plus the shed margin, so
+     * the utility can lower the load without the food warming beyond
+     * that bound. A running compressor and the defrost are unaffected.
+     * Ending the shed applies the start delay again, so that the units
+     * that were waiting do not all start at once.
+     *
+     */
+    Chillduino& setShedding(bool isShedding) {
+      if (_isShedding && !isShedding) {
+        delayCompressorStart();
+      }
+
+      _isShedding = isShedding;
+      return *this;
+    }
+
+    /**
+     * Gets whether a grid shed is deferring compressor starts.
+     *
+     */
+    bool isShedding(void) const {
+      return _isShedding;
+    }
+
     /**
      * Sets the minimum time (in ticks) that the door switch reading
      * must remain unchanged before triggering a door close event.
@@ -339,7 +712,8 @@ class Chillduino {
      * This value should be updated as frequently as possible.
      * The reading is compared to the previous reading to determine
      * if the mode switch was pressed. Once pressed, the mode is
-     * cycled in the following order: OFF -> COLD -> COLDER -> COLDEST.
+     * cycled in the following order: OFF -> COLD -> COLDER -> COLDEST,
+     * or in the order of the mode profiles.
      *
      */
     Chillduino& setModeSwitchReading(int reading) {
@@ -352,14 +726,83 @@ class Chillduino {
      *
      * This should only be used after reboot as a way to continue
      * using the previous mode selection. This will force the mode
-     * so that the mode switch will continue from this setting.
+     * so that the mode switch will continue from this setting. A mode
+     * outside of getModeCount() is ignored.
      *
      */
     Chillduino& setMode(int mode) {
+      if (mode < 0 || mode >= _modeCount) {
+        return *this;
+      }
+
       _mode = mode;
+      applyModeProfile();
       return *this;
     }
 
+    /**
+     * Sets the table of mode profiles, which is expected to be in flash.
+     *
+     * The mode switch then cycles through every profile in the table,
+     * and entering a mode applies its band and overrides. Settings
+     * changed afterwards last until the next mode change. Without a
+     * table the mode switch cycles through the CHILLDUINO_MODE_COUNT
+     * built in modes and leaves the band to the caller. A current mode
+     * past the end of the table is turned off.
+     *
+     */
+    Chillduino& setModeProfiles(const ChillduinoModeProfile *profiles,
+        int count) {
+      _modeProfiles = profiles;
+      _modeCount = count;
+
+      if (_mode >= _modeCount) {
+        _mode = CHILLDUINO_MODE_OFF;
+      }
+
+      applyModeProfile();
+      return *this;
+    }
+
+    /**
+     * Gets the number of modes the mode switch cycles through.
+     *
+     */
+    int getModeCount(void) const {
+      return _modeCount;
+    }
+
+    /**
+     * Gets the LEDs of the current mode profile, or zero without one.
+     *
+     */
+    unsigned char getModeLeds(void) const {
+      return hasModeProfile()
+        ? CHILLDUINO_READ_BYTE(&_modeProfiles[_mode].leds) : 0;
+    }
+
+    /**
+     * Gets the thermistor band that setMode() would apply for a mode.
+     *
+     * The readings are left unchanged for a mode without a profile,
+     * including the off mode, since those keep the current band.
+     *
+     */
+    void getModeThermistorReadings(int mode, int &minimum,
+        int &maximum) const {
+      if (_modeProfiles == 0 || mode <= CHILLDUINO_MODE_OFF
+          || mode >= _modeCount) {
+        return;
+      }
+
+      ChillduinoModeProfile profile;
+      chillduinoReadModeProfile(_modeProfiles, mode, profile);
+      minimum = chillduinoThermistorReading(
+        profile.minimumFreshFoodTemperature);
+      maximum = chillduinoThermistorReading(
+        profile.maximumFreshFoodTemperature);
+    }
+
     /**
      * Sets the minimum time (in ticks) allowed when forcing a defrost.
      *
@@ -421,6 +864,36 @@ class Chillduino {
       return *this;
     }
 
+#ifdef CHILLDUINO_STATISTICS
+    /**
+     * Sets the length of the window (in ticks) over which the compressor
+     * duty cycle and starts are reported, enabling statistics.
+     *
+     * Statistics are only compiled in when CHILLDUINO_STATISTICS is
+     * defined before this file is included, and are disabled until a
+     * window is set. Setting a window of zero disables them again. The
+     * window should be set once, before the chillduino starts running.
+     *
+     */
+    Chillduino& setStatisticsWindowInTicks(unsigned long ticks) {
+      _statistics.setWindowInTicks(ticks);
+      return *this;
+    }
+
+    /**
+     * Copies a snapshot of the runtime statistics into the statistics.
+     *
+     * The snapshot includes the time spent in the current states up to
+     * the last tick. When ticks are counted from an interrupt, the
+     * interrupt should be disabled while the snapshot is taken.
+     *
+     */
+    void getStatistics(ChillduinoStatistics &statistics) const {
+      statistics = _statistics;
+      statistics.account();
+    }
+#endif
+
     /**
      * Returns true if the compressor is running.
      *
@@ -485,6 +958,10 @@ class Chillduino {
      *
      */
     void tick(void) {
+#ifdef CHILLDUINO_STATISTICS
+      _statistics.tick();
+#endif
+
       if (_remainingTicksForCompressorChange > 0) {
         _remainingTicksForCompressorChange--;
       }
@@ -499,6 +976,10 @@ class Chillduino {
         _remainingTicksWhileDefrosting--;
       }
 
+      if (_remainingTicksForSlopeSample > 0) {
+        _remainingTicksForSlopeSample--;
+      }
+
       if (_remainingTicksForDoorClose > 0) {
         _remainingTicksForDoorClose--;
       }
@@ -533,30 +1014,40 @@ class Chillduino {
      * This function should be called as frequently as possible.
      * It is preferable (although not required) to have the update loop
      * called at the same rate as the tick. This function must not be
-     * called from an interrupt as its time is not guaranteed.
+     * called from an interrupt as its time is not guaranteed. A loop
+     * that runs slower than the tick should count the ticks instead of
+     * calling tick() and pass them to loop(unsigned long).
      *
      */
     void loop(void) {
       _isChanged = false;
+      updateSlope();
 
       if (_mode == CHILLDUINO_MODE_OFF) {
+        _isDefrostForced = false;
+
         if (isCompressorRunning()) {
           stopRunningCompressor();
         }
 
         if (isDefrostRunning()) {
-          stopRunningDefrost();
+          stopRunningDefrost(CHILLDUINO_DEFROST_ABORTED);
         }
       }
       else if (isCompressorReadyForChange()) {
         if (isDefrostRunning()) {
           if (isDefrostComplete()) {
+            learnDefrostInterval(true);
             delayDefrost();
           }
           else if (isBimetalCutoff()) {
-            stopRunningDefrost();
+            learnDefrostInterval(false);
+            stopRunningDefrost(CHILLDUINO_DEFROST_BIMETAL);
           }
         }
+        else if (isDefrostForced()) {
+          forceDefrost();
+        }
         else if (isCompressorRunning() && isReadyForDefrost()) {
           stopRunningCompressor();
           startRunningDefrost();
@@ -564,8 +1055,10 @@ class Chillduino {
         else if (isFreshFoodWarm() && !isCompressorRunning()) {
           startRunningCompressor();
         }
-        else if (isFreshFoodCold() && isCompressorRunning()) {
+        else if ((isFreshFoodCold() || isFreshFoodCoastingCold())
+            && isCompressorRunning()) {
           stopRunningCompressor();
+          startCoasting();
         }
       }
 
@@ -604,24 +1097,249 @@ class Chillduino {
       }
     }
 
+    /**
+     * Gets the number of ticks until a running timer expires.
+     *
+     * While the inputs remain unchanged the outputs can only change
+     * on the tick that expires a timer, so every tick before that one
+     * can be skipped. Returns CHILLDUINO_NEVER if no such timer is
+     * running.
+     *
+     */
+    unsigned long getTicksUntilNextEvent(void) const {
+      unsigned long ticks = CHILLDUINO_NEVER;
+
+      ticks = earliest(ticks, _remainingTicksForCompressorChange);
+
+      if (_isCompressorRunning) {
+        ticks = earliest(ticks, _remainingCompressorTicksUntilDefrost);
+      }
+
+      if (_isCompressorRunning && _slopeSampleTicks > 0) {
+        ticks = earliest(ticks, _remainingTicksForSlopeSample);
+      }
+
+      ticks = earliest(ticks, _remainingTicksWhileDefrosting);
+      ticks = earliest(ticks, _remainingTicksForDoorClose);
+      ticks = earliest(ticks, _remainingTicksForBimetalCutoff);
+      ticks = earliest(ticks, _remainingTicksForCloseBeforeForceDefrost);
+
+      if (_isDefrostForced && isCompressorReadyForChange()) {
+        ticks = 1;
+      }
+
+      return ticks;
+    }
+
+    /**
+     * Copies every value that determines the behavior of the
+     * chillduino into the state and returns the number of values.
+     *
+     * Two chillduinos with equal states behave identically when given
+     * the same inputs. Statistics are not included. The state must hold
+     * CHILLDUINO_STATE_SIZE values.
+     *
+     */
+    unsigned int getState(unsigned long *state) const {
+      unsigned long *start = state;
+
+      *state++ = _minimumFreshFoodThermistorReading;
+      *state++ = _currentFreshFoodThermistorReading;
+      *state++ = _maximumFreshFoodThermistorReading;
+      *state++ = _shedMaximumFreshFoodThermistorReading;
+
+      for (unsigned int i = 0; i < CHILLDUINO_SLOPE_SAMPLES; i++) {
+        *state++ = _slopeReadings[i];
+      }
+
+      *state++ = _slopeReadingCount;
+      *state++ = _slope;
+      *state++ = _stopReading;
+      *state++ = _lowestReading;
+      *state++ = _stopSlope;
+      *state++ = _learnedCoast;
+      *state++ = _previousDefrostSwitchReading;
+      *state++ = _currentDefrostSwitchReading;
+      *state++ = _previousDoorSwitchReading;
+      *state++ = _currentDoorSwitchReading;
+      *state++ = _previousModeSwitchReading;
+      *state++ = _currentModeSwitchReading;
+      *state++ = _mode;
+      *state++ = _minimumOpensForForceDefrost;
+      *state++ = _remainingOpensForForceDefrost;
+      *state++ = _minimumCompressorTicksPerDefrost;
+      *state++ = _maximumCompressorTicksPerDefrost;
+      *state++ = _remainingCompressorTicksUntilDefrost;
+      *state++ = _defrostDurationInTicks;
+      *state++ = _targetDefrostDurationInTicks;
+      *state++ = _learnedCompressorTicksPerDefrost;
+      *state++ = _remainingTicksWhileDefrosting;
+      *state++ = _remainingTicksForCompressorChange;
+      *state++ = _minimumTicksForCompressorChange;
+      *state++ = _startDelayInTicks;
+      *state++ = _slopeSampleTicks;
+      *state++ = _remainingTicksForSlopeSample;
+      *state++ = _remainingTicksForDoorClose;
+      *state++ = _minimumTicksForDoorClose;
+      *state++ = _remainingTicksForHeldModeSwitch;
+      *state++ = _minimumTicksForHeldModeSwitch;
+      *state++ = _remainingTicksForForceDefrost;
+      *state++ = _minimumTicksForForceDefrost;
+      *state++ = _previousTicksForCloseBeforeForceDefrost;
+      *state++ = _remainingTicksForCloseBeforeForceDefrost;
+      *state++ = _minimumTicksForCloseBeforeForceDefrost;
+      *state++ = _remainingTicksForBimetalCutoff;
+      *state++ = _minimumTicksForBimetalCutoff;
+      *state++ = _doorOpenDurationInTicks;
+      *state++ = _modeCount;
+      *state++ = _modeDefrostDurationInTicks;
+      *state++ = _modeTicksForCompressorChange;
+      *state++ = (_isCompressorRunning << 0)
+        | (_isDefrostRunning << 1)
+        | (_isBimetalCutoff << 2)
+        | (_isDoorOpen << 3)
+        | (_isWiFiToggled << 4)
+        | (_isChanged << 5)
+        | (_isDefrostForced << 6)
+        | (_isShedding << 7)
+        | (_isCoasting << 8);
+
+      return state - start;
+    }
+
+    /**
+     * Checks the input values after the amount of time (in ticks) that
+     * elapsed since the previous call, without calling tick().
+     *
+     * The outputs end up exactly as if tick() then loop() had been
+     * called once per elapsed tick with the current inputs, including
+     * any timer that expired between the calls, but only the ticks in
+     * which something can change are evaluated. The main loop can
+     * therefore run far slower than the tick, or stall, while the tick
+     * interrupt only counts. isChanged() reports whether anything
+     * changed during any of the elapsed ticks. With no elapsed ticks
+     * this is the same as loop().
+     *
+     */
+    void loop(unsigned long elapsedTicks) {
+      if (elapsedTicks == 0) {
+        loop();
+      }
+      else {
+        _isChanged = advance(elapsedTicks);
+      }
+    }
+
     /**
      * Causes the amount of time (in ticks) to elapse.
      *
+     * This behaves exactly as calling tick() then loop() once per tick,
+     * except that the ticks in which nothing can change are skipped.
      * This is a helper function that should only be used for testing.
      * This function should not be used in production.
      *
      */
     void elapse(unsigned long ticks) {
-      while (ticks--) {
+      advance(ticks);
+    }
+
+  private:
+    bool advance(unsigned long ticks) {
+      bool isChanged = false;
+
+      while (ticks > 0) {
         tick();
         loop();
+        ticks--;
+
+        if (_isChanged) {
+          isChanged = true;
+        }
+        else {
+          unsigned long skipped = getTicksUntilNextEvent() - 1;
+
+          if (skipped > ticks) {
+            skipped = ticks;
+          }
+
+          skip(skipped);
+          ticks -= skipped;
+        }
       }
+
+      return isChanged;
+    }
+
+    static unsigned long earliest(unsigned long ticks, unsigned long remaining) {
+      return (remaining > 0 && remaining < ticks) ? remaining : ticks;
+    }
+
+    static unsigned long countdown(unsigned long remaining, unsigned long ticks) {
+      return (remaining > ticks) ? remaining - ticks : 0;
+    }
+
+    void skip(unsigned long ticks) {
+      if (ticks == 0) {
+        return;
+      }
+
+#ifdef CHILLDUINO_STATISTICS
+      _statistics.elapse(ticks);
+#endif
+
+      _remainingTicksForCompressorChange =
+        countdown(_remainingTicksForCompressorChange, ticks);
+
+      if (_isCompressorRunning) {
+        _remainingCompressorTicksUntilDefrost =
+          countdown(_remainingCompressorTicksUntilDefrost, ticks);
+      }
+
+      _remainingTicksWhileDefrosting =
+        countdown(_remainingTicksWhileDefrosting, ticks);
+      _remainingTicksForSlopeSample =
+        countdown(_remainingTicksForSlopeSample, ticks);
+      _remainingTicksForDoorClose =
+        countdown(_remainingTicksForDoorClose, ticks);
+      _remainingTicksForHeldModeSwitch =
+        countdown(_remainingTicksForHeldModeSwitch, ticks);
+      _remainingTicksForForceDefrost =
+        countdown(_remainingTicksForForceDefrost, ticks);
+      _remainingTicksForBimetalCutoff =
+        countdown(_remainingTicksForBimetalCutoff, ticks);
+      _remainingTicksForCloseBeforeForceDefrost =
+        countdown(_remainingTicksForCloseBeforeForceDefrost, ticks);
+
+      _previousTicksForCloseBeforeForceDefrost =
+        _remainingTicksForCloseBeforeForceDefrost;
+
+      if (_isDoorOpen) {
+        _doorOpenDurationInTicks += ticks;
+      }
+      else {
+        _doorOpenDurationInTicks = 0;
+      }
+    }
+
+    void updateShedMaximum(void) {
+      int maximum = _maximumFreshFoodThermistorReading;
+
+      if (_shedMarginTemperature > 0) {
+        int shed = chillduinoThermistorReading(
+          chillduinoThermistorTemperature(maximum) + _shedMarginTemperature);
+
+        if (shed > maximum) {
+          maximum = shed;
+        }
+      }
+
+      _shedMaximumFreshFoodThermistorReading = maximum;
     }
 
-  private:
     bool isFreshFoodWarm(void) const {
-      return _currentFreshFoodThermistorReading
-        > _maximumFreshFoodThermistorReading;
+      return _currentFreshFoodThermistorReading > (_isShedding
+        ? _shedMaximumFreshFoodThermistorReading
+        : _maximumFreshFoodThermistorReading);
     }
 
     bool isFreshFoodCold(void) const {
@@ -659,6 +1377,9 @@ class Chillduino {
         _isDoorOpen = true;
         _isChanged = true;
         _remainingOpensForForceDefrost--;
+#ifdef CHILLDUINO_STATISTICS
+        _statistics.setDoorOpen(true);
+#endif
       }
 
       _remainingTicksForDoorClose = _minimumTicksForDoorClose;
@@ -668,6 +1389,9 @@ class Chillduino {
       if (_isDoorOpen && _remainingTicksForDoorClose == 0) {
         _isDoorOpen = false;
         _isChanged = true;
+#ifdef CHILLDUINO_STATISTICS
+        _statistics.setDoorOpen(false);
+#endif
 
         if (_remainingOpensForForceDefrost == 0 &&
             _remainingTicksForForceDefrost > 0) {
@@ -677,7 +1401,10 @@ class Chillduino {
 
         if (_remainingCompressorTicksUntilDefrost >
             _minimumCompressorTicksPerDefrost) {
-          _remainingCompressorTicksUntilDefrost -= _doorOpenDurationInTicks;
+          _remainingCompressorTicksUntilDefrost =
+            _minimumCompressorTicksPerDefrost + countdown(
+              _remainingCompressorTicksUntilDefrost -
+              _minimumCompressorTicksPerDefrost, _doorOpenDurationInTicks);
         }
       }
     }
@@ -686,14 +1413,31 @@ class Chillduino {
       if (_remainingOpensForForceDefrost == 0 &&
           _remainingTicksForCloseBeforeForceDefrost == 0 &&
           _previousTicksForCloseBeforeForceDefrost > 0) {
-        stopRunningCompressor();
-        startRunningDefrost();
+        if (_mode != CHILLDUINO_MODE_OFF && !_isDefrostRunning) {
+          _isDefrostForced = true;
+
+          if (isCompressorReadyForChange()) {
+            forceDefrost();
+          }
+        }
       }
 
       _previousTicksForCloseBeforeForceDefrost =
         _remainingTicksForCloseBeforeForceDefrost;
     }
 
+    bool isDefrostForced(void) const {
+      return _isDefrostForced;
+    }
+
+    void forceDefrost(void) {
+      stopRunningCompressor();
+      startRunningDefrost();
+#ifdef CHILLDUINO_STATISTICS
+      _statistics.startDefrost(true);
+#endif
+    }
+
     bool isDefrostSwitchChanged(void) const {
       return _previousDefrostSwitchReading != _currentDefrostSwitchReading;
     }
@@ -741,8 +1485,42 @@ class Chillduino {
     }
 
     void cycleToNextMode(void) {
-      _mode = (_mode + 1) % CHILLDUINO_MODE_COUNT;
+      _mode = (_mode + 1) % _modeCount;
       _isChanged = true;
+      applyModeProfile();
+    }
+
+    bool hasModeProfile(void) const {
+      return _modeProfiles != 0 && _mode >= 0 && _mode < _modeCount;
+    }
+
+    void applyModeProfile(void) {
+      if (!hasModeProfile()) {
+        _modeDefrostDurationInTicks = 0;
+        _modeTicksForCompressorChange = 0;
+        return;
+      }
+
+      ChillduinoModeProfile profile;
+      chillduinoReadModeProfile(_modeProfiles, _mode, profile);
+
+      if (_mode != CHILLDUINO_MODE_OFF) {
+        setMinimumFreshFoodTemperature(profile.minimumFreshFoodTemperature);
+        setMaximumFreshFoodTemperature(profile.maximumFreshFoodTemperature);
+      }
+
+      _modeDefrostDurationInTicks = profile.defrostDurationInTicks;
+      _modeTicksForCompressorChange = profile.ticksForCompressorChange;
+    }
+
+    unsigned long getDefrostDuration(void) const {
+      return _modeDefrostDurationInTicks
+        ? _modeDefrostDurationInTicks : _defrostDurationInTicks;
+    }
+
+    unsigned long getTicksForCompressorChange(void) const {
+      return _modeTicksForCompressorChange
+        ? _modeTicksForCompressorChange : _minimumTicksForCompressorChange;
     }
 
     void toggleWiFi(void) {
@@ -751,33 +1529,203 @@ class Chillduino {
     }
 
     void startRunningCompressor(void) {
+      if (_isCoasting) {
+        learnCoast();
+      }
+
+      _slopeReadingCount = 0;
+      _remainingTicksForSlopeSample = 0;
       _isChanged = true;
       _isCompressorRunning = true;
-      _remainingTicksForCompressorChange = _minimumTicksForCompressorChange;
+      _remainingTicksForCompressorChange = getTicksForCompressorChange();
+#ifdef CHILLDUINO_STATISTICS
+      _statistics.setCompressorRunning(true);
+#endif
+    }
+
+    void updateSlope(void) {
+      if (_isCoasting && _currentFreshFoodThermistorReading < _lowestReading) {
+        _lowestReading = _currentFreshFoodThermistorReading;
+      }
+
+      if (_slopeSampleTicks == 0 || !_isCompressorRunning
+          || _remainingTicksForSlopeSample > 0) {
+        return;
+      }
+
+      _remainingTicksForSlopeSample = _slopeSampleTicks;
+      _slope = 0;
+
+      for (int i = 0; i < CHILLDUINO_SLOPE_SAMPLES - 1; i++) {
+        _slopeReadings[i] = _slopeReadings[i + 1];
+        _slope += (2 * i - (CHILLDUINO_SLOPE_SAMPLES - 1)) * _slopeReadings[i];
+      }
+
+      _slopeReadings[CHILLDUINO_SLOPE_SAMPLES - 1] =
+        _currentFreshFoodThermistorReading;
+      _slope += (CHILLDUINO_SLOPE_SAMPLES - 1)
+        * _currentFreshFoodThermistorReading;
+
+      if (_slopeReadingCount < CHILLDUINO_SLOPE_SAMPLES) {
+        _slopeReadingCount++;
+      }
+    }
+
+    bool isFreshFoodCoastingCold(void) const {
+      if (_slopeReadingCount < CHILLDUINO_SLOPE_SAMPLES || _slope >= 0
+          || _currentFreshFoodThermistorReading
+            > _maximumFreshFoodThermistorReading) {
+        return false;
+      }
+
+      unsigned long coast = ((unsigned long) _learnedCoast * -_slope)
+        / (CHILLDUINO_SLOPE_SCALE << CHILLDUINO_COAST_SHIFT);
+
+      return _currentFreshFoodThermistorReading
+        < _minimumFreshFoodThermistorReading + (long) coast;
+    }
+
+    void startCoasting(void) {
+      if (_slopeSampleTicks == 0) {
+        return;
+      }
+
+      _isCoasting = true;
+      _stopReading = _currentFreshFoodThermistorReading;
+      _lowestReading = _currentFreshFoodThermistorReading;
+      _stopSlope = (_slopeReadingCount < CHILLDUINO_SLOPE_SAMPLES)
+        ? 0 : _slope;
+    }
+
+    void learnCoast(void) {
+      _isCoasting = false;
+
+      // without a rate at the stop there is nothing to divide by
+      if (_stopSlope >= 0) {
+        return;
+      }
+
+      unsigned long coast = ((unsigned long) (_stopReading - _lowestReading)
+        * CHILLDUINO_SLOPE_SCALE << CHILLDUINO_COAST_SHIFT) / -_stopSlope;
+
+      if (coast > CHILLDUINO_MAXIMUM_COAST) {
+        coast = CHILLDUINO_MAXIMUM_COAST;
+      }
+
+      if (_learnedCoast == 0) {
+        _learnedCoast = coast;
+      }
+      else if (coast > _learnedCoast) {
+        _learnedCoast += (coast - _learnedCoast) >> 1;
+      }
+      else {
+        _learnedCoast -= (_learnedCoast - coast) >> 1;
+      }
+    }
+
+    void delayCompressorStart(void) {
+      if (!_isCompressorRunning && !_isDefrostRunning
+          && _remainingTicksForCompressorChange < _startDelayInTicks) {
+        _remainingTicksForCompressorChange = _startDelayInTicks;
+      }
     }
 
     void stopRunningCompressor(void) {
       _isChanged = true;
       _isCompressorRunning = false;
-      _remainingTicksForCompressorChange = _minimumTicksForCompressorChange;
+      _remainingTicksForCompressorChange = getTicksForCompressorChange();
+#ifdef CHILLDUINO_STATISTICS
+      _statistics.setCompressorRunning(false);
+#endif
     }
 
     void startRunningDefrost(void) {
       _isChanged = true;
       _isDefrostRunning = true;
-      _remainingTicksWhileDefrosting = _defrostDurationInTicks;
+      _isDefrostForced = false;
+      _remainingTicksWhileDefrosting = getDefrostDuration();
+#ifdef CHILLDUINO_STATISTICS
+      _statistics.startDefrost(false);
+#endif
     }
 
-    void stopRunningDefrost(void) {
+    void stopRunningDefrost(int reason) {
       _isChanged = true;
       _isDefrostRunning = false;
-      _remainingCompressorTicksUntilDefrost = _maximumCompressorTicksPerDefrost;
+      _remainingCompressorTicksUntilDefrost = isDefrostAdaptive()
+        ? getDefrostInterval() : _maximumCompressorTicksPerDefrost;
+#ifdef CHILLDUINO_STATISTICS
+      _statistics.stopDefrost(reason);
+#else
+      (void) reason;
+#endif
     }
 
     void delayDefrost(void) {
       _isChanged = true;
       _isDefrostRunning = false;
-      _remainingCompressorTicksUntilDefrost = _minimumCompressorTicksPerDefrost;
+      _remainingCompressorTicksUntilDefrost = isDefrostAdaptive()
+        ? getDefrostInterval() : _minimumCompressorTicksPerDefrost;
+#ifdef CHILLDUINO_STATISTICS
+      _statistics.stopDefrost(CHILLDUINO_DEFROST_TIMED_OUT);
+#endif
+    }
+
+    bool isDefrostAdaptive(void) const {
+      return _targetDefrostDurationInTicks > 0;
+    }
+
+    unsigned long getDefrostInterval(void) const {
+      unsigned long interval = _learnedCompressorTicksPerDefrost;
+
+      if (interval == 0 || interval > _maximumCompressorTicksPerDefrost) {
+        return _maximumCompressorTicksPerDefrost;
+      }
+
+      return (interval < _minimumCompressorTicksPerDefrost)
+        ? _minimumCompressorTicksPerDefrost : interval;
+    }
+
+    void learnDefrostInterval(bool isTimedOut) {
+      if (!isDefrostAdaptive()) {
+        return;
+      }
+
+      // a timeout only tells that the frost needed more than the whole
+      // duration, so it is counted as needing twice as long
+      unsigned long duration = getDefrostDuration();
+      unsigned long heated = isTimedOut ? 2 * duration
+        : duration - _remainingTicksWhileDefrosting;
+      unsigned long interval = getDefrostInterval();
+      unsigned long scale = (heated > 0)
+        ? (_targetDefrostDurationInTicks << 8) / heated
+        : CHILLDUINO_DEFROST_MAXIMUM_SCALE;
+
+      if (scale < CHILLDUINO_DEFROST_MINIMUM_SCALE) {
+        scale = CHILLDUINO_DEFROST_MINIMUM_SCALE;
+      }
+      else if (scale > CHILLDUINO_DEFROST_MAXIMUM_SCALE) {
+        scale = CHILLDUINO_DEFROST_MAXIMUM_SCALE;
+      }
+
+      unsigned long wanted = (interval >> 8) * scale
+        + (((interval & 0xFF) * scale) >> 8);
+
+      if (wanted > interval) {
+        interval += (wanted - interval) >> CHILLDUINO_DEFROST_LEARNING_SHIFT;
+      }
+      else {
+        interval -= (interval - wanted) >> CHILLDUINO_DEFROST_LEARNING_SHIFT;
+      }
+
+      if (interval < _minimumCompressorTicksPerDefrost) {
+        interval = _minimumCompressorTicksPerDefrost;
+      }
+      else if (interval > _maximumCompressorTicksPerDefrost) {
+        interval = _maximumCompressorTicksPerDefrost;
+      }
+
+      _learnedCompressorTicksPerDefrost = interval;
     }
 };
 
@@ -23,63 +23,136 @@
 
 #include <EEPROM.h>
 #include <chillhub.h>
+
+#define CHILLDUINO_STATISTICS
+
 #include "chillduino.h"
+#include "chillduino_configuration.h"
+#include "chillduino_pins.h"
+#include "chillduino_series.h"
 
 #define THERMISTOR_ID    0x91
 #define COMPRESSOR_ID    0x92
 #define DEFROST_ID       0x93
 #define DOOR_ID          0x94
 #define BIMETAL_ID       0x95
+#define SERIES_ID        0x96
+#define CONFIGURATION_ID 0x97
+#define STATISTICS_ID    0x98
+#define SHED_ID          0x99
 
 #define RX               0
 #define TX               1
-#define LED_MODE_COLDEST 4
-#define LED_MODE_COLDER  5
-#define LED_MODE_COLD    6
-#define LED_MODE_OFF     7
-#define COMPRESSOR       9
-#define DEFROST          10
-#define DEFROST_SWITCH   11
 #define DOOR_LED         13
-#define MODE_SWITCH      SCK
 #define THERMISTOR       A0
-#define RELAY_WATCHDOG   A2
-#define DOOR_SWITCH      A4
 #define RNG              A11
 
-#define THERMISTOR_MIN_COLD    294
-#define THERMISTOR_MAX_COLD    374
-#define THERMISTOR_MIN_COLDER  215
-#define THERMISTOR_MAX_COLDER  345
-#define THERMISTOR_MIN_COLDEST 197
-#define THERMISTOR_MAX_COLDEST 332
+// the relays, switches and mode LEDs are driven through their ports;
+// the comments give the Arduino pin numbers
+typedef ChillduinoPin<ChillduinoPortD, PORTD4> LedModeColdest;  // 4
+typedef ChillduinoPin<ChillduinoPortC, PORTC6> LedModeColder;   // 5
+typedef ChillduinoPin<ChillduinoPortD, PORTD7> LedModeCold;     // 6
+typedef ChillduinoPin<ChillduinoPortE, PORTE6> LedModeOff;      // 7
+typedef ChillduinoPin<ChillduinoPortB, PORTB5> Compressor;      // 9
+typedef ChillduinoPin<ChillduinoPortB, PORTB6> Defrost;         // 10
+typedef ChillduinoPin<ChillduinoPortB, PINB7> DefrostSwitch;    // 11
+typedef ChillduinoPin<ChillduinoPortB, PINB1> ModeSwitch;       // SCK
+typedef ChillduinoPin<ChillduinoPortF, PORTF5> RelayWatchdog;   // A2
+typedef ChillduinoPin<ChillduinoPortF, PINF1> DoorSwitch;       // A4
+
+// both switches on PORTB are sampled in one read
+typedef ChillduinoPortB Switches;
+
+// temperature bands in tenths of a degree Celsius
+#define TEMPERATURE_MIN_COLD     59
+#define TEMPERATURE_MAX_COLD    130
+#define TEMPERATURE_MIN_COLDER  (-21)
+#define TEMPERATURE_MAX_COLDER  105
+#define TEMPERATURE_MIN_COLDEST (-41)
+#define TEMPERATURE_MAX_COLDEST  94
 
 #define TICKS_PER_SECOND   ((unsigned long) 1000)
 #define TICKS_PER_MINUTE   (60 * TICKS_PER_SECOND)
 #define TICKS_PER_HOUR     (60 * TICKS_PER_MINUTE)
 
+#define LEDS_COLDEST    _BV(0)
+#define LEDS_COLDER     _BV(1)
+#define LEDS_COLD       _BV(2)
+#define LEDS_OFF        _BV(3)
+
 #define EEPROM_COMPRESSOR_RUNTIME 0
 #define EEPROM_MODE (EEPROM_COMPRESSOR_RUNTIME + sizeof(unsigned long))
-#define EEPROM_UUID (EEPROM_COMPRESSOR_RUNTIME + sizeof(unsigned char))
+#define EEPROM_UUID (EEPROM_MODE + sizeof(unsigned char))
+// frames with the earlier 16-bit field mask were persisted here, so the
+// space is skipped rather than decoded with the wider mask
+#define EEPROM_SHORT_CONFIGURATION (EEPROM_UUID + 16)
+#define EEPROM_DEFROST_INTERVAL (EEPROM_SHORT_CONFIGURATION + 1 + 48)
+#define EEPROM_CONFIGURATION \
+  (EEPROM_DEFROST_INTERVAL + sizeof(unsigned long))
 #define COMPRESSOR_RUNTIME (96 * TICKS_PER_HOUR)
 
+// a nonzero target (such as 25 minutes) learns the defrost interval
+// from how long each defrost takes, within a longer maximum; it is off
+// since it costs more heater time than the fixed schedule unless the
+// unit builds up little frost
+#define DEFROST_TARGET_DURATION 0
+#define MAXIMUM_COMPRESSOR_RUNTIME \
+  (DEFROST_TARGET_DURATION ? 240 * TICKS_PER_HOUR : COMPRESSOR_RUNTIME)
+
+// a nonzero window (such as 2 minutes) spreads the first compressor
+// starts of units that lose power together; it is off so that a unit
+// starts as soon as it is warm unless a configuration frame delays it.
+// a grid shed lets the fresh food warm past the current mode's maximum
+// by at most the margin (in tenths of a degree Celsius) before starting
+#define START_STAGGER 0
+#define SHED_MARGIN   20
+
+// a nonzero period (such as 30 seconds) stops the compressor early by
+// how far the fresh food keeps cooling, learned from readings this far
+// apart; it is off so that units keep stopping at the minimum unless a
+// configuration frame sets the slope sample period
+#define SLOPE_SAMPLE_PERIOD 0
+
+#define ENTROPY_SAMPLES 64
+
+#define SERIES_CAPACITY 64
+#define SERIES_PERIOD_IN_MILLISECONDS 1000
+
+#define STATISTICS_PERIOD_IN_MILLISECONDS 3600000
+
 #define DOOR_LIGHT_DURATION_IN_MILLISECONDS 300000
 #define BRIGHTNESS_STEP_IN_MILLISECONDS 5
 #define MIN(a, b) ((a) < (b) ? (a) : (b))
 #define MAX(a, b) ((a) > (b) ? (a) : (b))
 
+// one row per mode in the order the mode switch cycles through them;
+// the band is in tenths of a degree Celsius and zero keeps the
+// configured defrost duration and compressor lockout
+const ChillduinoModeProfile MODE_PROFILES[] PROGMEM = {
+  { 0, 0, 0, 0, LEDS_OFF },
+  { TEMPERATURE_MIN_COLD, TEMPERATURE_MAX_COLD, 0, 0, LEDS_COLD },
+  { TEMPERATURE_MIN_COLDER, TEMPERATURE_MAX_COLDER, 0, 0, LEDS_COLDER },
+  { TEMPERATURE_MIN_COLDEST, TEMPERATURE_MAX_COLDEST, 0, 0, LEDS_COLDEST }
+};
+
+#define MODE_PROFILE_COUNT (sizeof(MODE_PROFILES) / sizeof(MODE_PROFILES[0]))
+
 Chillduino chillduino;
+ChillduinoSeries<SERIES_CAPACITY> series;
+ChillduinoConfiguration configuration;
 chInterface ChillHub;
 char uuid[37];
-int watchdog = 0;
+int announced = 0;
+int configured = 0;
+volatile unsigned long elapsed = 0;
 unsigned long runtime = 0;
+unsigned long interval = 0;
 int mode = 0;
 
 SIGNAL(TIMER0_COMPA_vect) {
-  chillduino.tick();
-
-  digitalWrite(RELAY_WATCHDOG, watchdog);
-  watchdog ^= 1;
+  // only counts; the ticks are handed to the chillduino by the main loop
+  elapsed++;
+  RelayWatchdog::toggle();
 }
 
 void setInterrupt(void) {
@@ -96,6 +169,8 @@ void chillduino_announce(void) {
   ChillHub.subscribe(deviceIdRequestType, (chillhubCallbackFunction) chillduino_announce);
   ChillHub.subscribe(keepAliveType, (chillhubCallbackFunction) chillduino_keepalive);
   ChillHub.subscribe(setDeviceUUIDType, (chillhubCallbackFunction) chillduino_set_uuid);
+  ChillHub.subscribe(CONFIGURATION_ID, (chillhubCallbackFunction) chillduino_configure);
+  ChillHub.subscribe(SHED_ID, (chillhubCallbackFunction) chillduino_shed);
   ChillHub.createCloudResourceU16("thermistor", THERMISTOR_ID, 0, 0);
   ChillHub.createCloudResourceU16("compressor", COMPRESSOR_ID, 0, 0);
   ChillHub.createCloudResourceU16("defrost", DEFROST_ID, 0, 0);
@@ -111,13 +186,77 @@ void chillduino_set_uuid(uint8_t *uuid) {
   (void) uuid;
 }
 
+void chillduino_configure(uint8_t *frame) {
+  // an array payload starts with its element count; callbacks run from
+  // the main loop, so the frame is applied between loops and only
+  // persisted once the chillduino has accepted it
+  if (configuration.decode(frame + 1, frame[0])
+      && configuration.applyTo(chillduino)) {
+    configured = 1;
+
+    if (configuration.isPersisted()) {
+      EEPROM.write(EEPROM_CONFIGURATION, frame[0]);
+
+      for (int i = 0; i < frame[0]; i++) {
+        EEPROM.write(EEPROM_CONFIGURATION + 1 + i, frame[1 + i]);
+      }
+    }
+  }
+}
+
+void chillduino_shed(uint8_t isShedding) {
+  chillduino.setShedding(isShedding);
+}
+
+void read_configuration(int address) {
+  uint8_t frame[CHILLDUINO_CONFIGURATION_MAXIMUM_LENGTH];
+  int length = EEPROM.read(address);
+
+  if (length > CHILLDUINO_CONFIGURATION_MAXIMUM_LENGTH) {
+    return;
+  }
+
+  for (int i = 0; i < length; i++) {
+    frame[i] = EEPROM.read(address + 1 + i);
+  }
+
+  configured = configuration.decode(frame, length)
+    && configuration.applyTo(chillduino);
+}
+
 void chillduino_push(void) {
   static unsigned long previous = millis();
   unsigned long current = millis();
 
-  if ((current - previous) > 5000) {
+  if ((current - previous) >= SERIES_PERIOD_IN_MILLISECONDS) {
+    previous = current;
+
+    int reading = analogRead(THERMISTOR);
+    series.push(reading);
+
+    if (series.isFull()) {
+      // the whole burst goes out as one array message, decoded on the
+      // host with ChillduinoSeriesDecoder
+      ChillHub.sendU8Msg(SERIES_ID, series.getLength(),
+        (uint8_t *) series.getBuffer());
+      ChillHub.updateCloudResourceU16(THERMISTOR_ID, reading);
+      series.clear();
+    }
+  }
+}
+
+void chillduino_report(void) {
+  static unsigned long previous = millis();
+  unsigned long current = millis();
+
+  if ((current - previous) >= STATISTICS_PERIOD_IN_MILLISECONDS) {
+    uint8_t buffer[CHILLDUINO_STATISTICS_LENGTH];
     previous = current;
-    ChillHub.updateCloudResourceU16(THERMISTOR_ID, analogRead(THERMISTOR));
+
+    ChillduinoStatistics statistics;
+
+    chillduino.getStatistics(statistics);
+    ChillHub.sendU8Msg(STATISTICS_ID, statistics.encode(buffer), buffer);
   }
 }
 
@@ -150,90 +289,112 @@ void adjust_brightness(void) {
   }
 }
 
-int reading_changed(int pin) {
-  static int previous = analogRead(pin);
-  int current = analogRead(pin);
-  int changed = (previous == current) ? 0 : 1;
-  previous = current;
-  return changed;
+int is_uuid_v4(int address) {
+  unsigned char version = EEPROM.read(address + 6);
+  unsigned char variant = EEPROM.read(address + 8);
+
+  return ((version & B11110000) == B01000000)
+    && ((variant & B11000000) == B10000000);
 }
 
-int von_neuman(int pin) {
-  int a, b;
+int collect_entropy(int pin) {
+  static unsigned long entropy = 0;
+  static int samples = 0;
+
+  // mix the noisy low bits of a floating pin with the jitter between
+  // the loop and timer 0, one sample per loop so control is not blocked
+  entropy = ((entropy << 7) | (entropy >> 25))
+    ^ analogRead(pin) ^ (micros() << 3) ^ TCNT0;
 
-  do {
-    a = reading_changed(pin);
-    b = reading_changed(pin);
-  } while (a == b);
+  if (++samples < ENTROPY_SAMPLES) {
+    return 0;
+  }
 
-  return a;
+  srandom(entropy);
+  return 1;
 }
 
-int get_seed(int pin, int bits) {
-  int seed = 0;
+unsigned long start_delay(int address) {
+  unsigned long window = START_STAGGER;
+  unsigned long bits = 0;
+
+  if (!window) {
+    return 0;
+  }
 
-  while (bits-- > 0) {
-    seed |= (von_neuman(pin) << bits);
+  // before the uuid exists every unit waits out the whole window
+  if (!is_uuid_v4(address)) {
+    return window;
   }
 
-  return seed;
+  // the last bytes of the uuid are random, so they spread the units
+  // evenly over the window
+  for (int i = 12; i < 16; i++) {
+    bits = (bits << 8) | EEPROM.read(address + i);
+  }
+
+  return bits % window;
 }
 
 void create_uuid_v4(int address) {
-  unsigned char c = EEPROM.read(address + 6);
-
-  if ((c & B11110000) != B01000000) {
-    // not a valid version 4 uuid so create one
-
-    EEPROM.write(address++, random(256));
-    EEPROM.write(address++, random(256));
-    EEPROM.write(address++, random(256));
-    EEPROM.write(address++, random(256));
-    EEPROM.write(address++, random(256));
-    EEPROM.write(address++, random(256));
-    EEPROM.write(address++, B01000000 | random(16));
-    EEPROM.write(address++, random(256));
-    EEPROM.write(address++, ((random(256) & B00111111) | B10000000));
-    EEPROM.write(address++, random(256));
-    EEPROM.write(address++, random(256));
-    EEPROM.write(address++, random(256));
-    EEPROM.write(address++, random(256));
-    EEPROM.write(address++, random(256));
-    EEPROM.write(address++, random(256));
-    EEPROM.write(address++, random(256));
+  EEPROM.write(address++, random(256));
+  EEPROM.write(address++, random(256));
+  EEPROM.write(address++, random(256));
+  EEPROM.write(address++, random(256));
+  EEPROM.write(address++, random(256));
+  EEPROM.write(address++, random(256));
+  EEPROM.write(address++, B01000000 | random(16));
+  EEPROM.write(address++, random(256));
+  EEPROM.write(address++, ((random(256) & B00111111) | B10000000));
+  EEPROM.write(address++, random(256));
+  EEPROM.write(address++, random(256));
+  EEPROM.write(address++, random(256));
+  EEPROM.write(address++, random(256));
+  EEPROM.write(address++, random(256));
+  EEPROM.write(address++, random(256));
+  EEPROM.write(address++, random(256));
+}
+
+void read_uuid(int address, char *uuid) {
+  static const char hex[] = "0123456789abcdef";
+  static const unsigned char dashes = B00011110;
+
+  for (int i = 0; i < 16; i++) {
+    unsigned char c = EEPROM.read(address + i);
+
+    *uuid++ = hex[c >> 4];
+    *uuid++ = hex[c & 0xF];
+
+    // a dash follows bytes 3, 5, 7 and 9 (8-4-4-4-12)
+    if ((i & 1) && (dashes & (1 << (i >> 1)))) {
+      *uuid++ = '-';
+    }
   }
+
+  *uuid = 0;
 }
 
-void read_hex(int address, char *uuid) {
-  static const char *hex = "0123456789abcdef";
-  int c = EEPROM.read(address);
+void prepare_uuid(void) {
+  if (!is_uuid_v4(EEPROM_UUID)) {
+    if (!collect_entropy(RNG)) {
+      return;
+    }
+
+    create_uuid_v4(EEPROM_UUID);
+  }
 
-  uuid[0] = hex[c >> 4];
-  uuid[1] = hex[c & 4];
+  read_uuid(EEPROM_UUID, uuid);
+  chillduino_announce();
+  announced = 1;
 }
 
-void read_uuid(int address, char *uuid) {
-  read_hex(address++, uuid + 0);
-  read_hex(address++, uuid + 2);
-  read_hex(address++, uuid + 4);
-  read_hex(address++, uuid + 6);
-  uuid[8] = '-';
-  read_hex(address++, uuid + 9);
-  read_hex(address++, uuid + 11);
-  uuid[13] = '-';
-  read_hex(address++, uuid + 14);
-  read_hex(address++, uuid + 16);
-  uuid[18] = '-';
-  read_hex(address++, uuid + 19);
-  read_hex(address++, uuid + 21);
-  uuid[23] = '-';
-  read_hex(address++, uuid + 24);
-  read_hex(address++, uuid + 26);
-  read_hex(address++, uuid + 28);
-  read_hex(address++, uuid + 30);
-  read_hex(address++, uuid + 32);
-  read_hex(address++, uuid + 34);
-  uuid[36] = 0;
+void apply_mode(void) {
+  unsigned char leds = chillduino.getModeLeds();
+
+  LedModeColdest::write(leds & LEDS_COLDEST);
+  LedModeColder::write(leds & LEDS_COLDER);
+  LedModeCold::write(leds & LEDS_COLD);
+  LedModeOff::write(leds & LEDS_OFF);
 }
 
 void setup(void) {
@@ -242,71 +403,94 @@ void setup(void) {
   pinMode(TX, INPUT);
   pinMode(SDA, INPUT);
   pinMode(SCL, INPUT);
-  pinMode(LED_MODE_OFF, OUTPUT);
-  pinMode(LED_MODE_COLD, OUTPUT);
-  pinMode(LED_MODE_COLDER, OUTPUT);
-  pinMode(LED_MODE_COLDEST, OUTPUT);
-  pinMode(DOOR_SWITCH, INPUT);
-  pinMode(DEFROST_SWITCH, INPUT);
-  pinMode(COMPRESSOR, OUTPUT);
-  pinMode(DEFROST, OUTPUT);
-  pinMode(RELAY_WATCHDOG, OUTPUT);
+  LedModeOff::output();
+  LedModeCold::output();
+  LedModeColder::output();
+  LedModeColdest::output();
+  DoorSwitch::input();
+  DefrostSwitch::input();
+  ModeSwitch::input();
+  Compressor::output();
+  Defrost::output();
+  RelayWatchdog::output();
   pinMode(DOOR_LED, OUTPUT);
 
   TCCR4B = TCCR4B & B11111000 | B00000001;
 
   EEPROM.get(EEPROM_COMPRESSOR_RUNTIME, runtime);
 
-  if (runtime > COMPRESSOR_RUNTIME) {
-    runtime = COMPRESSOR_RUNTIME;
+  if (runtime > MAXIMUM_COMPRESSOR_RUNTIME) {
+    runtime = MAXIMUM_COMPRESSOR_RUNTIME;
   }
 
-  mode = EEPROM.read(EEPROM_MODE);
-
-  switch (mode) {
-    case CHILLDUINO_MODE_OFF:
-    case CHILLDUINO_MODE_COLD:
-    case CHILLDUINO_MODE_COLDER:
-    case CHILLDUINO_MODE_COLDEST:
-      break;
+  EEPROM.get(EEPROM_DEFROST_INTERVAL, interval);
 
-    default:
-      mode = CHILLDUINO_MODE_COLDER;
-      break;
+  // an erased EEPROM reads as all ones, so learning starts from the
+  // fixed schedule
+  if (interval > MAXIMUM_COMPRESSOR_RUNTIME) {
+    interval = COMPRESSOR_RUNTIME;
   }
 
-  srandom(get_seed(RNG, 32));
-  create_uuid_v4(EEPROM_UUID);
-  read_uuid(EEPROM_UUID, uuid);
+  mode = EEPROM.read(EEPROM_MODE);
+
+  if (mode >= (int) MODE_PROFILE_COUNT) {
+    mode = CHILLDUINO_MODE_COLDER;
+  }
 
   chillduino
+    .setModeProfiles(MODE_PROFILES, MODE_PROFILE_COUNT)
     .setMode(mode)
-    .setMinimumFreshFoodThermistorReading(THERMISTOR_MIN_COLDER)
-    .setMaximumFreshFoodThermistorReading(THERMISTOR_MAX_COLDER)
     .setMinimumCompressorTicksPerDefrost(12 * TICKS_PER_HOUR)
-    .setMaximumCompressorTicksPerDefrost(COMPRESSOR_RUNTIME)
+    .setMaximumCompressorTicksPerDefrost(MAXIMUM_COMPRESSOR_RUNTIME)
     .setRemainingCompressorTicksUntilDefrost(runtime)
     .setDefrostDurationInTicks(30 * TICKS_PER_MINUTE)
+    .setTargetDefrostDurationInTicks(DEFROST_TARGET_DURATION)
+    .setLearnedCompressorTicksPerDefrost(interval)
     .setMinimumTicksForCompressorChange(10 * TICKS_PER_MINUTE)
+    .setSlopeSampleTicks(SLOPE_SAMPLE_PERIOD)
+    .setStartDelayInTicks(start_delay(EEPROM_UUID))
+    .setShedMarginTemperature(SHED_MARGIN)
     .setMinimumTicksForDoorClose(100)
     .setMinimumTicksForHeldModeSwitch(3 * TICKS_PER_SECOND)
     .setMinimumTicksForForceDefrost(5 * TICKS_PER_SECOND)
     .setMinimumTicksForCloseBeforeForceDefrost(5 * TICKS_PER_SECOND)
     .setMinimumOpensForForceDefrost(3)
-    .setMinimumTicksForBimetalCutoff(100);
+    .setMinimumTicksForBimetalCutoff(100)
+    .setStatisticsWindowInTicks(TICKS_PER_HOUR);
+
+  apply_mode();
+  read_configuration(EEPROM_CONFIGURATION);
 
   Serial.begin(115200);
 
   setInterrupt();
-  chillduino_announce();
+  prepare_uuid();
 }
 
 void loop(void) {
+  if (configured) {
+    configured = 0;
+
+    if (mode != chillduino.getMode()) {
+      mode = chillduino.getMode();
+      EEPROM.write(EEPROM_MODE, mode);
+      apply_mode();
+    }
+  }
+
   chillduino.setCurrentFreshFoodThermistorReading(analogRead(THERMISTOR));
-  chillduino.setDoorSwitchReading(digitalRead(DOOR_SWITCH));
-  chillduino.setModeSwitchReading(digitalRead(MODE_SWITCH));
-  chillduino.setDefrostSwitchReading(digitalRead(DEFROST_SWITCH));
-  chillduino.loop();
+  unsigned char switches = Switches::read();
+
+  chillduino.setDoorSwitchReading(DoorSwitch::read());
+  chillduino.setModeSwitchReading(ModeSwitch::isSet(switches));
+  chillduino.setDefrostSwitchReading(DefrostSwitch::isSet(switches));
+
+  clearInterrupt();
+  unsigned long ticks = elapsed;
+  elapsed = 0;
+  setInterrupt();
+
+  chillduino.loop(ticks);
 
   int current = chillduino.getRemainingCompressorTicksUntilDefrost()
     / TICKS_PER_HOUR;
@@ -321,6 +505,15 @@ void loop(void) {
     // Serial.println(runtime);
   }
 
+  if (interval != chillduino.getLearnedCompressorTicksPerDefrost()) {
+    interval = chillduino.getLearnedCompressorTicksPerDefrost();
+    EEPROM.put(EEPROM_DEFROST_INTERVAL, interval);
+  }
+
+  if (!announced) {
+    prepare_uuid();
+  }
+
   if (chillduino.isChanged()) {
     // Serial.println(chillduino.isDoorOpen()
     //  ? "Door is open" : "Door is closed");
@@ -331,7 +524,7 @@ void loop(void) {
     // Serial.println(chillduino.isDefrostRunning()
     //  ? "Defrost is running" : "Defrost is not running");
     
-    if (chillduino.isWiFiToggled()) {
+    if (chillduino.isWiFiToggled() && announced) {
       // Serial.println("WiFi is toggled");
       ChillHub.sendU8Msg(0x2e, 0);
     }
@@ -339,62 +532,30 @@ void loop(void) {
     if (mode != chillduino.getMode()) {
       mode = chillduino.getMode();
       EEPROM.write(EEPROM_MODE, mode);
+      apply_mode();
     }
 
-    switch (chillduino.getMode()) {
-      case CHILLDUINO_MODE_OFF:
-        digitalWrite(LED_MODE_OFF, 1);
-        digitalWrite(LED_MODE_COLD, 0);
-        digitalWrite(LED_MODE_COLDER, 0);
-        digitalWrite(LED_MODE_COLDEST, 0);
-        break;
-
-      case CHILLDUINO_MODE_COLD:
-        digitalWrite(LED_MODE_OFF, 0);
-        digitalWrite(LED_MODE_COLD, 1);
-        digitalWrite(LED_MODE_COLDER, 0);
-        digitalWrite(LED_MODE_COLDEST, 0);
-        chillduino.setMinimumFreshFoodThermistorReading(THERMISTOR_MIN_COLD);
-        chillduino.setMaximumFreshFoodThermistorReading(THERMISTOR_MAX_COLD);
-        break;
-
-      case CHILLDUINO_MODE_COLDER:
-        digitalWrite(LED_MODE_OFF, 0);
-        digitalWrite(LED_MODE_COLD, 0);
-        digitalWrite(LED_MODE_COLDER, 1);
-        digitalWrite(LED_MODE_COLDEST, 0);
-        chillduino.setMinimumFreshFoodThermistorReading(THERMISTOR_MIN_COLDER);
-        chillduino.setMaximumFreshFoodThermistorReading(THERMISTOR_MAX_COLDER);
-        break;
-
-      case CHILLDUINO_MODE_COLDEST:
-        digitalWrite(LED_MODE_OFF, 0);
-        digitalWrite(LED_MODE_COLD, 0);
-        digitalWrite(LED_MODE_COLDER, 0);
-        digitalWrite(LED_MODE_COLDEST, 1);
-        chillduino.setMinimumFreshFoodThermistorReading(THERMISTOR_MIN_COLDEST);
-        chillduino.setMaximumFreshFoodThermistorReading(THERMISTOR_MAX_COLDEST);
-        break;
-
-      default:
-        break;
-    };
-    
     int isCompressorRunning = chillduino.isCompressorRunning();
     int isDefrostRunning = chillduino.isDefrostRunning();
     int isDoorOpen = chillduino.isDoorOpen();
     int isBimetalCutoff = chillduino.isBimetalCutoff();
 
-    digitalWrite(COMPRESSOR, isCompressorRunning);
-    digitalWrite(DEFROST, isDefrostRunning);
+    Compressor::write(isCompressorRunning);
+    Defrost::write(isDefrostRunning);
 
-    ChillHub.updateCloudResourceU16(COMPRESSOR_ID, isCompressorRunning);
-    ChillHub.updateCloudResourceU16(DEFROST_ID, isDefrostRunning);
-    ChillHub.updateCloudResourceU16(DOOR_ID, isDoorOpen);
-    ChillHub.updateCloudResourceU16(BIMETAL_ID, isBimetalCutoff);
+    if (announced) {
+      ChillHub.updateCloudResourceU16(COMPRESSOR_ID, isCompressorRunning);
+      ChillHub.updateCloudResourceU16(DEFROST_ID, isDefrostRunning);
+      ChillHub.updateCloudResourceU16(DOOR_ID, isDoorOpen);
+      ChillHub.updateCloudResourceU16(BIMETAL_ID, isBimetalCutoff);
+    }
   }
 
   adjust_brightness();
-  chillduino_push();
-  ChillHub.loop();
+
+  if (announced) {
+    chillduino_push();
+    chillduino_report();
+    ChillHub.loop();
+  }
 }
@@ -0,0 +1,450 @@
+/**
+ * Copyright (c) 2015 FirstBuild
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef CHILLDUINO_CONFIGURATION_H
+#define CHILLDUINO_CONFIGURATION_H
+
+#include "chillduino.h"
+
+/**
+ * The chillduino settings that can be changed by a configuration frame.
+ *
+ * Each field is selected by the bit of the same number in the frame's
+ * field mask, and is encoded in the frame in this order.
+ *
+ */
+#define CHILLDUINO_FIELD_MINIMUM_FRESH_FOOD_THERMISTOR_READING      0
+#define CHILLDUINO_FIELD_MAXIMUM_FRESH_FOOD_THERMISTOR_READING      1
+#define CHILLDUINO_FIELD_MINIMUM_COMPRESSOR_TICKS_PER_DEFROST       2
+#define CHILLDUINO_FIELD_MAXIMUM_COMPRESSOR_TICKS_PER_DEFROST       3
+#define CHILLDUINO_FIELD_REMAINING_COMPRESSOR_TICKS_UNTIL_DEFROST   4
+#define CHILLDUINO_FIELD_DEFROST_DURATION_IN_TICKS                  5
+#define CHILLDUINO_FIELD_MINIMUM_TICKS_FOR_COMPRESSOR_CHANGE        6
+#define CHILLDUINO_FIELD_MINIMUM_TICKS_FOR_DOOR_CLOSE               7
+#define CHILLDUINO_FIELD_MINIMUM_TICKS_FOR_HELD_MODE_SWITCH         8
+#define CHILLDUINO_FIELD_MINIMUM_TICKS_FOR_FORCE_DEFROST            9
+#define CHILLDUINO_FIELD_MINIMUM_TICKS_FOR_CLOSE_BEFORE_FORCE_DEFROST 10
+#define CHILLDUINO_FIELD_MINIMUM_OPENS_FOR_FORCE_DEFROST            11
+#define CHILLDUINO_FIELD_MINIMUM_TICKS_FOR_BIMETAL_CUTOFF           12
+#define CHILLDUINO_FIELD_MODE                                       13
+#define CHILLDUINO_FIELD_TARGET_DEFROST_DURATION_IN_TICKS           14
+#define CHILLDUINO_FIELD_START_DELAY_IN_TICKS                       15
+#define CHILLDUINO_FIELD_SHED_MARGIN_TEMPERATURE                    16
+#define CHILLDUINO_FIELD_SLOPE_SAMPLE_TICKS                         17
+
+/**
+ * The number of configurable fields.
+ *
+ * The mask has room for 31 fields besides the persist bit.
+ *
+ */
+#define CHILLDUINO_FIELD_COUNT 18
+
+/**
+ * The mask bit requesting that the configuration be persisted.
+ *
+ * This bit does not select a field. It is up to the sketch to store
+ * the frame and apply it again after a reboot. A persisted frame may
+ * not select the mode or the remaining compressor ticks until defrost,
+ * since applying them again at every reboot would undo the changes
+ * the chillduino has made to them since.
+ *
+ */
+#define CHILLDUINO_CONFIGURATION_PERSIST 0x80000000UL
+
+/**
+ * The largest number of bytes in a configuration frame.
+ *
+ */
+#define CHILLDUINO_CONFIGURATION_MAXIMUM_LENGTH 64
+
+/**
+ * A batch of chillduino settings that are changed together.
+ *
+ * The binary frame starts with a little endian 32-bit field mask,
+ * followed by the value of each selected field in field order.
+ * Thermistor readings and the shed margin are 16-bit, the number of
+ * opens and the mode are 8-bit and all durations in ticks are 32-bit,
+ * all little endian.
+ *
+ * A frame is decoded and validated as a whole, then applied to the
+ * chillduino in one step so that the chillduino never runs with part
+ * of a configuration.
+ *
+ */
+class ChillduinoConfiguration {
+  private:
+    unsigned long _mask;
+    unsigned long _values[CHILLDUINO_FIELD_COUNT];
+
+    static unsigned int getWidth(unsigned int field) {
+      switch (field) {
+        case CHILLDUINO_FIELD_MINIMUM_FRESH_FOOD_THERMISTOR_READING:
+        case CHILLDUINO_FIELD_MAXIMUM_FRESH_FOOD_THERMISTOR_READING:
+        case CHILLDUINO_FIELD_SHED_MARGIN_TEMPERATURE:
+          return 2;
+
+        case CHILLDUINO_FIELD_MINIMUM_OPENS_FOR_FORCE_DEFROST:
+        case CHILLDUINO_FIELD_MODE:
+          return 1;
+
+        default:
+          return 4;
+      }
+    }
+
+    bool isBefore(unsigned int first, unsigned int second) const {
+      return !has(first) || !has(second) || _values[first] < _values[second];
+    }
+
+  public:
+
+    /**
+     * Creates a configuration that does not change any setting.
+     *
+     */
+    ChillduinoConfiguration(void) :
+      _mask(0),
+      _values() { }
+
+    /**
+     * Selects a field and sets its value.
+     *
+     */
+    ChillduinoConfiguration& set(unsigned int field, unsigned long value) {
+      if (field < CHILLDUINO_FIELD_COUNT) {
+        _mask |= 1UL << field;
+        _values[field] = value;
+      }
+
+      return *this;
+    }
+
+    /**
+     * Requests that the configuration be persisted.
+     *
+     */
+    ChillduinoConfiguration& setPersisted(bool isPersisted) {
+      if (isPersisted) {
+        _mask |= CHILLDUINO_CONFIGURATION_PERSIST;
+      }
+      else {
+        _mask &= ~CHILLDUINO_CONFIGURATION_PERSIST;
+      }
+
+      return *this;
+    }
+
+    /**
+     * Returns true if the field is selected.
+     *
+     */
+    bool has(unsigned int field) const {
+      return field < CHILLDUINO_FIELD_COUNT && (_mask & (1UL << field));
+    }
+
+    /**
+     * Gets the value of a selected field.
+     *
+     */
+    unsigned long get(unsigned int field) const {
+      return has(field) ? _values[field] : 0;
+    }
+
+    /**
+     * Returns true if the configuration should be persisted.
+     *
+     */
+    bool isPersisted(void) const {
+      return (_mask & CHILLDUINO_CONFIGURATION_PERSIST) != 0;
+    }
+
+    /**
+     * Returns true if the selected values are consistent.
+     *
+     * The thermistor band and the compressor ticks per defrost must
+     * each have a minimum below their maximum when both are selected.
+     * A persisted configuration must not select the mode or the
+     * remaining compressor ticks until defrost. The mode depends on the
+     * chillduino's table of modes, so it is checked by isValidFor().
+     *
+     */
+    bool isValid(void) const {
+      if (isPersisted() && (has(CHILLDUINO_FIELD_MODE) ||
+          has(CHILLDUINO_FIELD_REMAINING_COMPRESSOR_TICKS_UNTIL_DEFROST))) {
+        return false;
+      }
+
+      return isBefore(CHILLDUINO_FIELD_MINIMUM_FRESH_FOOD_THERMISTOR_READING,
+          CHILLDUINO_FIELD_MAXIMUM_FRESH_FOOD_THERMISTOR_READING)
+        && isBefore(CHILLDUINO_FIELD_MINIMUM_COMPRESSOR_TICKS_PER_DEFROST,
+          CHILLDUINO_FIELD_MAXIMUM_COMPRESSOR_TICKS_PER_DEFROST);
+    }
+
+    /**
+     * Returns true if the selected values can be applied to the
+     * chillduino.
+     *
+     * The mode must be one of the modes the chillduino cycles through.
+     * The band and the compressor ticks per defrost the chillduino
+     * would end up with, merging the selected fields over the band of
+     * the selected mode and the current settings, must each still have
+     * a minimum below their maximum.
+     *
+     */
+    bool isValidFor(const Chillduino &chillduino) const {
+      int minimumReading = chillduino.getMinimumFreshFoodThermistorReading();
+      int maximumReading = chillduino.getMaximumFreshFoodThermistorReading();
+      unsigned long minimumTicks =
+        chillduino.getMinimumCompressorTicksPerDefrost();
+      unsigned long maximumTicks =
+        chillduino.getMaximumCompressorTicksPerDefrost();
+
+      if (!isValid() || get(CHILLDUINO_FIELD_MODE)
+          >= (unsigned long) chillduino.getModeCount()) {
+        return false;
+      }
+
+      if (has(CHILLDUINO_FIELD_MODE)) {
+        chillduino.getModeThermistorReadings(
+          _values[CHILLDUINO_FIELD_MODE], minimumReading, maximumReading);
+      }
+
+      if (has(CHILLDUINO_FIELD_MINIMUM_FRESH_FOOD_THERMISTOR_READING)) {
+        minimumReading =
+          _values[CHILLDUINO_FIELD_MINIMUM_FRESH_FOOD_THERMISTOR_READING];
+      }
+
+      if (has(CHILLDUINO_FIELD_MAXIMUM_FRESH_FOOD_THERMISTOR_READING)) {
+        maximumReading =
+          _values[CHILLDUINO_FIELD_MAXIMUM_FRESH_FOOD_THERMISTOR_READING];
+      }
+
+      if (has(CHILLDUINO_FIELD_MINIMUM_COMPRESSOR_TICKS_PER_DEFROST)) {
+        minimumTicks =
+          _values[CHILLDUINO_FIELD_MINIMUM_COMPRESSOR_TICKS_PER_DEFROST];
+      }
+
+      if (has(CHILLDUINO_FIELD_MAXIMUM_COMPRESSOR_TICKS_PER_DEFROST)) {
+        maximumTicks =
+          _values[CHILLDUINO_FIELD_MAXIMUM_COMPRESSOR_TICKS_PER_DEFROST];
+      }
+
+      return minimumReading < maximumReading && minimumTicks < maximumTicks;
+    }
+
+    /**
+     * Decodes a configuration frame.
+     *
+     * Returns false, leaving the configuration empty, if the frame is
+     * truncated, has trailing bytes, selects an unknown field or is
+     * not valid.
+     *
+     */
+    bool decode(const unsigned char *frame, unsigned int length) {
+      unsigned int position = 4;
+      unsigned long mask = 0;
+
+      _mask = 0;
+
+      if (length < 4) {
+        return false;
+      }
+
+      for (unsigned int i = 4; i-- > 0;) {
+        mask = (mask << 8) | frame[i];
+      }
+
+      if (mask & ~CHILLDUINO_CONFIGURATION_PERSIST
+          & ~((1UL << CHILLDUINO_FIELD_COUNT) - 1)) {
+        return false;
+      }
+
+      for (unsigned int field = 0; field < CHILLDUINO_FIELD_COUNT; field++) {
+        if (mask & (1UL << field)) {
+          unsigned int width = getWidth(field);
+          unsigned long value = 0;
+
+          if (position + width > length) {
+            return false;
+          }
+
+          for (unsigned int i = width; i-- > 0;) {
+            value = (value << 8) | frame[position + i];
+          }
+
+          _values[field] = value;
+          position += width;
+        }
+      }
+
+      _mask = mask;
+
+      if (position != length || !isValid()) {
+        _mask = 0;
+        return false;
+      }
+
+      return true;
+    }
+
+    /**
+     * Encodes the configuration into a frame and returns its length.
+     *
+     * The frame must hold CHILLDUINO_CONFIGURATION_MAXIMUM_LENGTH bytes.
+     *
+     */
+    unsigned int encode(unsigned char *frame) const {
+      unsigned int position = 0;
+      unsigned long mask = _mask;
+
+      while (position < 4) {
+        frame[position++] = (unsigned char) mask;
+        mask >>= 8;
+      }
+
+      for (unsigned int field = 0; field < CHILLDUINO_FIELD_COUNT; field++) {
+        if (has(field)) {
+          unsigned long value = _values[field];
+
+          for (unsigned int i = getWidth(field); i > 0; i--) {
+            frame[position++] = (unsigned char) value;
+            value >>= 8;
+          }
+        }
+      }
+
+      return position;
+    }
+
+    /**
+     * Applies each selected field to the chillduino.
+     *
+     * This should be called between calls to loop() with the tick
+     * interrupt disabled, so that the chillduino sees either all or
+     * none of the new settings. The mode is applied first, so that
+     * settings in the same frame take precedence over its profile.
+     *
+     * Returns false without changing anything if the configuration is
+     * not valid for the chillduino.
+     *
+     */
+    bool applyTo(Chillduino &chillduino) const {
+      if (!isValidFor(chillduino)) {
+        return false;
+      }
+
+      if (has(CHILLDUINO_FIELD_MODE)) {
+        chillduino.setMode(_values[CHILLDUINO_FIELD_MODE]);
+      }
+
+      if (has(CHILLDUINO_FIELD_MINIMUM_FRESH_FOOD_THERMISTOR_READING)) {
+        chillduino.setMinimumFreshFoodThermistorReading(
+          _values[CHILLDUINO_FIELD_MINIMUM_FRESH_FOOD_THERMISTOR_READING]);
+      }
+
+      if (has(CHILLDUINO_FIELD_MAXIMUM_FRESH_FOOD_THERMISTOR_READING)) {
+        chillduino.setMaximumFreshFoodThermistorReading(
+          _values[CHILLDUINO_FIELD_MAXIMUM_FRESH_FOOD_THERMISTOR_READING]);
+      }
+
+      if (has(CHILLDUINO_FIELD_MINIMUM_COMPRESSOR_TICKS_PER_DEFROST)) {
+        chillduino.setMinimumCompressorTicksPerDefrost(
+          _values[CHILLDUINO_FIELD_MINIMUM_COMPRESSOR_TICKS_PER_DEFROST]);
+      }
+
+      if (has(CHILLDUINO_FIELD_MAXIMUM_COMPRESSOR_TICKS_PER_DEFROST)) {
+        chillduino.setMaximumCompressorTicksPerDefrost(
+          _values[CHILLDUINO_FIELD_MAXIMUM_COMPRESSOR_TICKS_PER_DEFROST]);
+      }
+
+      if (has(CHILLDUINO_FIELD_REMAINING_COMPRESSOR_TICKS_UNTIL_DEFROST)) {
+        chillduino.setRemainingCompressorTicksUntilDefrost(
+          _values[CHILLDUINO_FIELD_REMAINING_COMPRESSOR_TICKS_UNTIL_DEFROST]);
+      }
+
+      if (has(CHILLDUINO_FIELD_DEFROST_DURATION_IN_TICKS)) {
+        chillduino.setDefrostDurationInTicks(
+          _values[CHILLDUINO_FIELD_DEFROST_DURATION_IN_TICKS]);
+      }
+
+      if (has(CHILLDUINO_FIELD_MINIMUM_TICKS_FOR_COMPRESSOR_CHANGE)) {
+        chillduino.setMinimumTicksForCompressorChange(
+          _values[CHILLDUINO_FIELD_MINIMUM_TICKS_FOR_COMPRESSOR_CHANGE]);
+      }
+
+      if (has(CHILLDUINO_FIELD_MINIMUM_TICKS_FOR_DOOR_CLOSE)) {
+        chillduino.setMinimumTicksForDoorClose(
+          _values[CHILLDUINO_FIELD_MINIMUM_TICKS_FOR_DOOR_CLOSE]);
+      }
+
+      if (has(CHILLDUINO_FIELD_MINIMUM_TICKS_FOR_HELD_MODE_SWITCH)) {
+        chillduino.setMinimumTicksForHeldModeSwitch(
+          _values[CHILLDUINO_FIELD_MINIMUM_TICKS_FOR_HELD_MODE_SWITCH]);
+      }
+
+      if (has(CHILLDUINO_FIELD_MINIMUM_TICKS_FOR_FORCE_DEFROST)) {
+        chillduino.setMinimumTicksForForceDefrost(
+          _values[CHILLDUINO_FIELD_MINIMUM_TICKS_FOR_FORCE_DEFROST]);
+      }
+
+      if (has(CHILLDUINO_FIELD_MINIMUM_TICKS_FOR_CLOSE_BEFORE_FORCE_DEFROST)) {
+        chillduino.setMinimumTicksForCloseBeforeForceDefrost(
+          _values[CHILLDUINO_FIELD_MINIMUM_TICKS_FOR_CLOSE_BEFORE_FORCE_DEFROST]);
+      }
+
+      if (has(CHILLDUINO_FIELD_MINIMUM_OPENS_FOR_FORCE_DEFROST)) {
+        chillduino.setMinimumOpensForForceDefrost(
+          _values[CHILLDUINO_FIELD_MINIMUM_OPENS_FOR_FORCE_DEFROST]);
+      }
+
+      if (has(CHILLDUINO_FIELD_MINIMUM_TICKS_FOR_BIMETAL_CUTOFF)) {
+        chillduino.setMinimumTicksForBimetalCutoff(
+          _values[CHILLDUINO_FIELD_MINIMUM_TICKS_FOR_BIMETAL_CUTOFF]);
+      }
+
+      if (has(CHILLDUINO_FIELD_TARGET_DEFROST_DURATION_IN_TICKS)) {
+        chillduino.setTargetDefrostDurationInTicks(
+          _values[CHILLDUINO_FIELD_TARGET_DEFROST_DURATION_IN_TICKS]);
+      }
+
+      if (has(CHILLDUINO_FIELD_START_DELAY_IN_TICKS)) {
+        chillduino.setStartDelayInTicks(
+          _values[CHILLDUINO_FIELD_START_DELAY_IN_TICKS]);
+      }
+
+      if (has(CHILLDUINO_FIELD_SHED_MARGIN_TEMPERATURE)) {
+        chillduino.setShedMarginTemperature(
+          _values[CHILLDUINO_FIELD_SHED_MARGIN_TEMPERATURE]);
+      }
+
+      if (has(CHILLDUINO_FIELD_SLOPE_SAMPLE_TICKS)) {
+        chillduino.setSlopeSampleTicks(
+          _values[CHILLDUINO_FIELD_SLOPE_SAMPLE_TICKS]);
+      }
+
+      return true;
+    }
+};
+
+#endif /* CHILLDUINO_CONFIGURATION_H */
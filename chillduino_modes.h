@@ -0,0 +1,78 @@
+/**
+ * Copyright (c) 2015 FirstBuild
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef CHILLDUINO_MODES_H
+#define CHILLDUINO_MODES_H
+
+#include "chillduino_progmem.h"
+
+/**
+ * The settings that make up one chillduino mode.
+ *
+ * The modes are kept as a table of profiles in flash, indexed by mode
+ * and cycled in table order by the mode switch, so a new mode such as
+ * vacation or quick chill is added by adding a row. The first row is
+ * always the OFF mode, whose band is ignored.
+ *
+ */
+struct ChillduinoModeProfile {
+
+  /**
+   * The fresh food temperature band, in tenths of a degree Celsius.
+   *
+   */
+  short minimumFreshFoodTemperature;
+  short maximumFreshFoodTemperature;
+
+  /**
+   * Replaces the configured defrost duration while in this mode,
+   * or zero to keep it.
+   *
+   */
+  unsigned long defrostDurationInTicks;
+
+  /**
+   * Replaces the configured minimum ticks between compressor changes
+   * while in this mode, or zero to keep it.
+   *
+   */
+  unsigned long ticksForCompressorChange;
+
+  /**
+   * The mode indicator LEDs to light. The meaning of each bit is left
+   * to the board so that it can match the output port.
+   *
+   */
+  unsigned char leds;
+};
+
+/**
+ * Copies the profile of a mode out of a table in flash.
+ *
+ */
+inline void chillduinoReadModeProfile(const ChillduinoModeProfile *profiles,
+    int mode, ChillduinoModeProfile &profile) {
+  CHILLDUINO_READ_BLOCK(&profile, &profiles[mode], sizeof(profile));
+}
+
+#endif /* CHILLDUINO_MODES_H */
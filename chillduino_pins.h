@@ -0,0 +1,201 @@
+/**
+ * Copyright (c) 2015 FirstBuild
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef CHILLDUINO_PINS_H
+#define CHILLDUINO_PINS_H
+
+/**
+ * Direct access to the I/O ports.
+ *
+ * A port is named by the data memory address of its PIN register, which
+ * is followed by its DDR and PORT registers. On the AVR the address is
+ * a constant, so every access compiles to a single instruction (sbi,
+ * cbi, sbic or in) instead of the table lookups behind digitalRead()
+ * and digitalWrite(). Elsewhere the registers are plain memory that
+ * tests can read and write.
+ *
+ */
+#define CHILLDUINO_PORT_B 0x23
+#define CHILLDUINO_PORT_C 0x26
+#define CHILLDUINO_PORT_D 0x29
+#define CHILLDUINO_PORT_E 0x2C
+#define CHILLDUINO_PORT_F 0x2F
+
+#define CHILLDUINO_REGISTER_COUNT 0x40
+
+#ifdef __AVR__
+#define CHILLDUINO_REGISTER(address) (*(volatile unsigned char *) (address))
+#else
+inline volatile unsigned char *chillduinoRegisters(void) {
+  static volatile unsigned char registers[CHILLDUINO_REGISTER_COUNT];
+  return registers;
+}
+
+#define CHILLDUINO_REGISTER(address) (chillduinoRegisters()[address])
+#endif
+
+/**
+ * An I/O port resolved at compile time.
+ *
+ */
+template <unsigned int ADDRESS>
+class ChillduinoPort {
+  public:
+
+    /**
+     * Gets the input register.
+     *
+     */
+    static volatile unsigned char& pins(void) {
+      return CHILLDUINO_REGISTER(ADDRESS);
+    }
+
+    /**
+     * Gets the data direction register.
+     *
+     */
+    static volatile unsigned char& directions(void) {
+      return CHILLDUINO_REGISTER(ADDRESS + 1);
+    }
+
+    /**
+     * Gets the output register.
+     *
+     */
+    static volatile unsigned char& outputs(void) {
+      return CHILLDUINO_REGISTER(ADDRESS + 2);
+    }
+
+    /**
+     * Reads every input of the port in a single access.
+     *
+     * The result can be handed to ChillduinoPin::isSet() for each pin.
+     *
+     */
+    static unsigned char read(void) {
+      return pins();
+    }
+};
+
+typedef ChillduinoPort<CHILLDUINO_PORT_B> ChillduinoPortB;
+typedef ChillduinoPort<CHILLDUINO_PORT_C> ChillduinoPortC;
+typedef ChillduinoPort<CHILLDUINO_PORT_D> ChillduinoPortD;
+typedef ChillduinoPort<CHILLDUINO_PORT_E> ChillduinoPortE;
+typedef ChillduinoPort<CHILLDUINO_PORT_F> ChillduinoPortF;
+
+/**
+ * A single pin of a port resolved at compile time.
+ *
+ * Setting, clearing and toggling a pin only touch its own bit, so they
+ * are safe to mix with an interrupt that drives another pin of the
+ * same port.
+ *
+ */
+template <class PORT, unsigned char BIT>
+class ChillduinoPin {
+  public:
+
+    /**
+     * The bit of the pin within its port.
+     *
+     */
+    static const unsigned char MASK = 1 << BIT;
+
+    /**
+     * Makes the pin an output.
+     *
+     */
+    static void output(void) {
+      PORT::directions() |= MASK;
+    }
+
+    /**
+     * Makes the pin an input without a pull-up.
+     *
+     */
+    static void input(void) {
+      PORT::directions() &= ~MASK;
+      PORT::outputs() &= ~MASK;
+    }
+
+    /**
+     * Drives the pin high.
+     *
+     */
+    static void set(void) {
+      PORT::outputs() |= MASK;
+    }
+
+    /**
+     * Drives the pin low.
+     *
+     */
+    static void clear(void) {
+      PORT::outputs() &= ~MASK;
+    }
+
+    /**
+     * Drives the pin high or low.
+     *
+     */
+    static void write(bool value) {
+      if (value) {
+        set();
+      }
+      else {
+        clear();
+      }
+    }
+
+    /**
+     * Inverts the pin.
+     *
+     * On the AVR writing a one to the input register inverts the output.
+     *
+     */
+    static void toggle(void) {
+#ifdef __AVR__
+      PORT::pins() = MASK;
+#else
+      PORT::outputs() ^= MASK;
+#endif
+    }
+
+    /**
+     * Reads the pin.
+     *
+     */
+    static bool read(void) {
+      return (PORT::pins() & MASK) != 0;
+    }
+
+    /**
+     * Reads the pin from a value returned by ChillduinoPort::read().
+     *
+     */
+    static bool isSet(unsigned char inputs) {
+      return (inputs & MASK) != 0;
+    }
+};
+
+#endif /* CHILLDUINO_PINS_H */
@@ -0,0 +1,52 @@
+/**
+ * Copyright (c) 2015 FirstBuild
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef CHILLDUINO_PROGMEM_H
+#define CHILLDUINO_PROGMEM_H
+
+/**
+ * Access to constant tables kept in flash.
+ *
+ * On the AVR a table declared PROGMEM stays in flash instead of being
+ * copied into RAM at startup, and must be read with the pgm_read
+ * functions. Elsewhere the table is an ordinary constant array.
+ *
+ */
+#ifdef __AVR__
+#include <avr/pgmspace.h>
+#define CHILLDUINO_READ_BYTE(address) ((unsigned char) pgm_read_byte(address))
+#define CHILLDUINO_READ_WORD(address) ((short) pgm_read_word(address))
+#define CHILLDUINO_READ_BLOCK(destination, source, size) \
+  memcpy_P(destination, source, size)
+#else
+#include <string.h>
+#ifndef PROGMEM
+#define PROGMEM
+#endif
+#define CHILLDUINO_READ_BYTE(address) (*(address))
+#define CHILLDUINO_READ_WORD(address) (*(address))
+#define CHILLDUINO_READ_BLOCK(destination, source, size) \
+  memcpy(destination, source, size)
+#endif
+
+#endif /* CHILLDUINO_PROGMEM_H */
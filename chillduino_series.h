@@ -0,0 +1,198 @@
+/**
+ * Copyright (c) 2015 FirstBuild
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef CHILLDUINO_SERIES_H
+#define CHILLDUINO_SERIES_H
+
+/**
+ * A fixed size time series of readings.
+ *
+ * Each sample is stored as the difference from the previous sample,
+ * zigzag encoded so that small negative differences stay small, and
+ * written using as few 7-bit groups as possible. A slowly changing
+ * thermistor reading therefore costs a single byte per sample. The
+ * first sample is stored as the difference from zero.
+ *
+ * The encoded buffer is meant to be uploaded as a single message and
+ * decoded on the host with a ChillduinoSeriesDecoder.
+ *
+ */
+template <unsigned int CAPACITY>
+class ChillduinoSeries {
+  public:
+
+    /**
+     * The largest number of bytes a single sample can be encoded into.
+     *
+     */
+    static const unsigned int MAXIMUM_BYTES_PER_SAMPLE =
+      (sizeof(unsigned int) * 8 + 6) / 7;
+
+  private:
+    unsigned char _buffer[CAPACITY];
+    unsigned int _length;
+    unsigned int _count;
+    int _previous;
+
+  public:
+
+    /**
+     * Creates a new empty series.
+     *
+     */
+    ChillduinoSeries(void) :
+      _buffer(),
+      _length(0),
+      _count(0),
+      _previous(0) { }
+
+    /**
+     * Appends a sample to the series.
+     *
+     * Returns false without modifying the series if the sample
+     * might not fit in the remaining space.
+     *
+     */
+    bool push(int sample) {
+      if (isFull()) {
+        return false;
+      }
+
+      int delta = sample - _previous;
+      unsigned int value = (delta < 0)
+        ? (((unsigned int) -(delta + 1)) << 1) | 1
+        : ((unsigned int) delta) << 1;
+
+      while (value >= 0x80) {
+        _buffer[_length++] = (unsigned char) (value | 0x80);
+        value >>= 7;
+      }
+
+      _buffer[_length++] = (unsigned char) value;
+      _previous = sample;
+      _count++;
+      return true;
+    }
+
+    /**
+     * Removes all samples from the series.
+     *
+     */
+    void clear(void) {
+      _length = 0;
+      _count = 0;
+      _previous = 0;
+    }
+
+    /**
+     * Returns true if another sample is not guaranteed to fit.
+     *
+     */
+    bool isFull(void) const {
+      return _length + MAXIMUM_BYTES_PER_SAMPLE > CAPACITY;
+    }
+
+    /**
+     * Gets the encoded samples.
+     *
+     */
+    const unsigned char *getBuffer(void) const {
+      return _buffer;
+    }
+
+    /**
+     * Gets the number of encoded bytes.
+     *
+     */
+    unsigned int getLength(void) const {
+      return _length;
+    }
+
+    /**
+     * Gets the number of samples in the series.
+     *
+     */
+    unsigned int getCount(void) const {
+      return _count;
+    }
+};
+
+/**
+ * Decodes the samples of an uploaded ChillduinoSeries.
+ *
+ */
+class ChillduinoSeriesDecoder {
+  private:
+    const unsigned char *_buffer;
+    unsigned int _length;
+    unsigned int _position;
+    int _previous;
+
+  public:
+
+    /**
+     * Creates a decoder for the encoded bytes of a series.
+     *
+     */
+    ChillduinoSeriesDecoder(const unsigned char *buffer, unsigned int length) :
+      _buffer(buffer),
+      _length(length),
+      _position(0),
+      _previous(0) { }
+
+    /**
+     * Decodes the next sample.
+     *
+     * Returns false once every sample has been decoded or if the
+     * buffer ends in the middle of a sample.
+     *
+     */
+    bool next(int &sample) {
+      unsigned int value = 0;
+      unsigned int shift = 0;
+
+      for (;;) {
+        if (_position >= _length || shift >= sizeof(unsigned int) * 8) {
+          return false;
+        }
+
+        unsigned char c = _buffer[_position++];
+        value |= ((unsigned int) (c & 0x7F)) << shift;
+        shift += 7;
+
+        if ((c & 0x80) == 0) {
+          break;
+        }
+      }
+
+      int delta = (value & 1)
+        ? -((int) (value >> 1)) - 1
+        : (int) (value >> 1);
+
+      _previous += delta;
+      sample = _previous;
+      return true;
+    }
+};
+
+#endif /* CHILLDUINO_SERIES_H */
@@ -0,0 +1,529 @@
+/**
+ * Copyright (c) 2015 FirstBuild
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef CHILLDUINO_STATISTICS_H
+#define CHILLDUINO_STATISTICS_H
+
+/**
+ * The number of buckets the compressor window is divided into.
+ *
+ * The window slides one bucket at a time, so a larger number of buckets
+ * gives a smoother window at the cost of four bytes per bucket.
+ *
+ */
+#define CHILLDUINO_STATISTICS_BUCKETS 6
+
+/**
+ * The number of bytes written by ChillduinoStatistics::encode().
+ *
+ */
+#define CHILLDUINO_STATISTICS_LENGTH 60
+
+/**
+ * The reasons a defrost ends.
+ *
+ * A defrost is completed when the bimetal cuts it off or it times out,
+ * and aborted when it is stopped early, such as by turning the
+ * chillduino off.
+ *
+ */
+#define CHILLDUINO_DEFROST_BIMETAL   0
+#define CHILLDUINO_DEFROST_TIMED_OUT 1
+#define CHILLDUINO_DEFROST_ABORTED   2
+
+/**
+ * Runtime statistics for a chillduino.
+ *
+ * The only work done on every tick is counting it. Time spent in a
+ * state is accounted lazily whenever the state changes or a snapshot
+ * is taken, so each event costs the same no matter how long it has
+ * been since the previous one. The compressor window is kept as a ring
+ * of buckets with running totals, so it is never rescanned.
+ *
+ * A chillduino only keeps statistics when CHILLDUINO_STATISTICS is
+ * defined before chillduino.h is included. Otherwise they take no
+ * memory and no time.
+ *
+ */
+class ChillduinoStatistics {
+  private:
+    bool _isEnabled;
+    bool _isCompressorRunning;
+    bool _isDefrostRunning;
+    bool _isDoorOpen;
+    unsigned long _ticks;
+    unsigned long _accountedTicks;
+    unsigned long _bucketInTicks;
+    unsigned long _bucketStartedAt;
+    unsigned int _bucket;
+    unsigned int _filledBuckets;
+    unsigned long _bucketCompressorTicks[CHILLDUINO_STATISTICS_BUCKETS];
+    unsigned int _bucketCompressorStarts[CHILLDUINO_STATISTICS_BUCKETS];
+    unsigned long _windowCompressorTicks;
+    unsigned int _windowCompressorStarts;
+    unsigned long _compressorStarts;
+    unsigned long _compressorTicks;
+    unsigned long _defrostStartedAt;
+    unsigned long _defrosts;
+    unsigned long _forcedDefrosts;
+    unsigned long _completedDefrosts;
+    unsigned long _completedDefrostTicks;
+    unsigned long _bimetalDefrosts;
+    unsigned long _timedOutDefrosts;
+    unsigned long _abortedDefrosts;
+    unsigned long _doorOpens;
+    unsigned long _doorOpenTicks;
+
+    void clearBucket(unsigned int i) {
+      _windowCompressorTicks -= _bucketCompressorTicks[i];
+      _windowCompressorStarts -= _bucketCompressorStarts[i];
+      _bucketCompressorTicks[i] = 0;
+      _bucketCompressorStarts[i] = 0;
+    }
+
+    void addCompressorTicks(unsigned int i, unsigned long ticks) {
+      _bucketCompressorTicks[i] += ticks;
+      _windowCompressorTicks += ticks;
+    }
+
+    static void encodeU32(unsigned char *&buffer, unsigned long value) {
+      for (int i = 0; i < 4; i++) {
+        *buffer++ = (unsigned char) value;
+        value >>= 8;
+      }
+    }
+
+  public:
+
+    /**
+     * Creates disabled statistics with every count at zero.
+     *
+     */
+    ChillduinoStatistics(void) :
+      _isEnabled(false),
+      _isCompressorRunning(false),
+      _isDefrostRunning(false),
+      _isDoorOpen(false),
+      _ticks(0),
+      _accountedTicks(0),
+      _bucketInTicks(0),
+      _bucketStartedAt(0),
+      _bucket(0),
+      _filledBuckets(0),
+      _bucketCompressorTicks(),
+      _bucketCompressorStarts(),
+      _windowCompressorTicks(0),
+      _windowCompressorStarts(0),
+      _compressorStarts(0),
+      _compressorTicks(0),
+      _defrostStartedAt(0),
+      _defrosts(0),
+      _forcedDefrosts(0),
+      _completedDefrosts(0),
+      _completedDefrostTicks(0),
+      _bimetalDefrosts(0),
+      _timedOutDefrosts(0),
+      _abortedDefrosts(0),
+      _doorOpens(0),
+      _doorOpenTicks(0) { }
+
+    /**
+     * Sets the length of the compressor window and enables the
+     * statistics, or disables them if the length is zero.
+     *
+     */
+    void setWindowInTicks(unsigned long ticks) {
+      account();
+
+      for (unsigned int i = 0; i < CHILLDUINO_STATISTICS_BUCKETS; i++) {
+        clearBucket(i);
+      }
+
+      _bucketInTicks = ticks / CHILLDUINO_STATISTICS_BUCKETS;
+      _isEnabled = _bucketInTicks > 0;
+      _bucketStartedAt = _ticks;
+      _filledBuckets = 0;
+    }
+
+    /**
+     * Counts a single tick.
+     *
+     */
+    void tick(void) {
+      if (_isEnabled) {
+        _ticks++;
+      }
+    }
+
+    /**
+     * Counts a number of ticks in which no event occurred.
+     *
+     */
+    void elapse(unsigned long ticks) {
+      if (_isEnabled) {
+        _ticks += ticks;
+      }
+    }
+
+    /**
+     * Accounts the time spent in the current states up to now.
+     *
+     * This is called for every event, and should be called on a copy
+     * of the statistics before reading a snapshot. It visits at most
+     * one bucket per bucket length elapsed, and never more than
+     * the number of buckets.
+     *
+     * Ticks are only ever compared by their difference, so the window
+     * keeps sliding when the tick count wraps.
+     *
+     */
+    void account(void) {
+      if (!_isEnabled) {
+        return;
+      }
+
+      unsigned long elapsed = _ticks - _accountedTicks;
+      unsigned long buckets = (_ticks - _bucketStartedAt) / _bucketInTicks;
+
+      if (_isCompressorRunning) {
+        _compressorTicks += elapsed;
+      }
+
+      if (_isDoorOpen) {
+        _doorOpenTicks += elapsed;
+      }
+
+      if (buckets >= CHILLDUINO_STATISTICS_BUCKETS) {
+        for (unsigned int i = 0; i < CHILLDUINO_STATISTICS_BUCKETS; i++) {
+          clearBucket(i);
+        }
+
+        _bucket = (_bucket + buckets) % CHILLDUINO_STATISTICS_BUCKETS;
+        _bucketStartedAt += buckets * _bucketInTicks;
+        _filledBuckets = CHILLDUINO_STATISTICS_BUCKETS - 1;
+        _accountedTicks = _bucketStartedAt;
+        buckets = 0;
+
+        if (_isCompressorRunning) {
+          for (unsigned int i = 0; i < CHILLDUINO_STATISTICS_BUCKETS; i++) {
+            if (i != _bucket) {
+              addCompressorTicks(i, _bucketInTicks);
+            }
+          }
+        }
+      }
+
+      while (buckets-- > 0) {
+        _bucketStartedAt += _bucketInTicks;
+
+        if (_isCompressorRunning) {
+          addCompressorTicks(_bucket, _bucketStartedAt - _accountedTicks);
+        }
+
+        _accountedTicks = _bucketStartedAt;
+        _bucket = (_bucket + 1) % CHILLDUINO_STATISTICS_BUCKETS;
+        clearBucket(_bucket);
+
+        if (_filledBuckets < CHILLDUINO_STATISTICS_BUCKETS - 1) {
+          _filledBuckets++;
+        }
+      }
+
+      if (_isCompressorRunning) {
+        addCompressorTicks(_bucket, _ticks - _accountedTicks);
+      }
+
+      _accountedTicks = _ticks;
+    }
+
+    /**
+     * Records a change in the state of the compressor.
+     *
+     */
+    void setCompressorRunning(bool isRunning) {
+      if (!_isEnabled || isRunning == _isCompressorRunning) {
+        return;
+      }
+
+      account();
+      _isCompressorRunning = isRunning;
+
+      if (isRunning) {
+        _compressorStarts++;
+        _windowCompressorStarts++;
+        _bucketCompressorStarts[_bucket]++;
+      }
+    }
+
+    /**
+     * Records the start of a defrost.
+     *
+     */
+    void startDefrost(bool isForced) {
+      if (!_isEnabled) {
+        return;
+      }
+
+      if (isForced) {
+        _forcedDefrosts++;
+      }
+
+      if (!_isDefrostRunning) {
+        _isDefrostRunning = true;
+        _defrostStartedAt = _ticks;
+        _defrosts++;
+      }
+    }
+
+    /**
+     * Records the end of a defrost for one of the CHILLDUINO_DEFROST
+     * reasons.
+     *
+     * Aborted defrosts are counted separately and left out of the
+     * average duration.
+     *
+     */
+    void stopDefrost(int reason) {
+      if (!_isEnabled || !_isDefrostRunning) {
+        return;
+      }
+
+      _isDefrostRunning = false;
+
+      if (reason == CHILLDUINO_DEFROST_ABORTED) {
+        _abortedDefrosts++;
+        return;
+      }
+
+      _completedDefrosts++;
+      _completedDefrostTicks += _ticks - _defrostStartedAt;
+
+      if (reason == CHILLDUINO_DEFROST_BIMETAL) {
+        _bimetalDefrosts++;
+      }
+      else {
+        _timedOutDefrosts++;
+      }
+    }
+
+    /**
+     * Records a change in the state of the door.
+     *
+     */
+    void setDoorOpen(bool isOpen) {
+      if (!_isEnabled || isOpen == _isDoorOpen) {
+        return;
+      }
+
+      account();
+      _isDoorOpen = isOpen;
+
+      if (isOpen) {
+        _doorOpens++;
+      }
+    }
+
+    /**
+     * Returns true if the statistics are being collected.
+     *
+     */
+    bool isEnabled(void) const {
+      return _isEnabled;
+    }
+
+    /**
+     * Gets the number of ticks counted.
+     *
+     */
+    unsigned long getTicks(void) const {
+      return _ticks;
+    }
+
+    /**
+     * Gets the length of the compressor window so far, which is shorter
+     * than the configured window until it has filled up.
+     *
+     */
+    unsigned long getWindowTicks(void) const {
+      if (!_isEnabled) {
+        return 0;
+      }
+
+      unsigned long elapsed = _ticks - _bucketStartedAt;
+      unsigned long buckets = elapsed / _bucketInTicks;
+
+      if (buckets < CHILLDUINO_STATISTICS_BUCKETS - 1 - _filledBuckets) {
+        buckets += _filledBuckets;
+      }
+      else {
+        buckets = CHILLDUINO_STATISTICS_BUCKETS - 1;
+      }
+
+      return buckets * _bucketInTicks + elapsed % _bucketInTicks;
+    }
+
+    /**
+     * Gets the compressor running time within the window.
+     *
+     */
+    unsigned long getWindowCompressorTicks(void) const {
+      return _windowCompressorTicks;
+    }
+
+    /**
+     * Gets the number of compressor starts within the window.
+     *
+     */
+    unsigned int getWindowCompressorStarts(void) const {
+      return _windowCompressorStarts;
+    }
+
+    /**
+     * Gets the compressor duty cycle over the window in tenths of a
+     * percent.
+     *
+     */
+    unsigned int getCompressorDutyCycle(void) const {
+      unsigned long window = getWindowTicks();
+
+      if (window == 0) {
+        return 0;
+      }
+
+      return (window >= 1000)
+        ? _windowCompressorTicks / (window / 1000)
+        : _windowCompressorTicks * 1000 / window;
+    }
+
+    /**
+     * Gets the number of times the compressor has started.
+     *
+     */
+    unsigned long getCompressorStarts(void) const {
+      return _compressorStarts;
+    }
+
+    /**
+     * Gets the total time the compressor has been running.
+     *
+     */
+    unsigned long getCompressorTicks(void) const {
+      return _compressorTicks;
+    }
+
+    /**
+     * Gets the number of defrosts started, including forced defrosts.
+     *
+     */
+    unsigned long getDefrosts(void) const {
+      return _defrosts;
+    }
+
+    /**
+     * Gets the number of defrosts forced by opening the door.
+     *
+     */
+    unsigned long getForcedDefrosts(void) const {
+      return _forcedDefrosts;
+    }
+
+    /**
+     * Gets the average duration of the completed defrosts.
+     *
+     */
+    unsigned long getAverageDefrostTicks(void) const {
+      return _completedDefrosts
+        ? _completedDefrostTicks / _completedDefrosts : 0;
+    }
+
+    /**
+     * Gets the number of defrosts ended by the bimetal.
+     *
+     */
+    unsigned long getBimetalDefrosts(void) const {
+      return _bimetalDefrosts;
+    }
+
+    /**
+     * Gets the number of defrosts that ran for their full duration.
+     *
+     */
+    unsigned long getTimedOutDefrosts(void) const {
+      return _timedOutDefrosts;
+    }
+
+    /**
+     * Gets the number of defrosts stopped before they completed.
+     *
+     */
+    unsigned long getAbortedDefrosts(void) const {
+      return _abortedDefrosts;
+    }
+
+    /**
+     * Gets the number of times the door has been opened.
+     *
+     */
+    unsigned long getDoorOpens(void) const {
+      return _doorOpens;
+    }
+
+    /**
+     * Gets the total time the door has been open.
+     *
+     */
+    unsigned long getDoorOpenTicks(void) const {
+      return _doorOpenTicks;
+    }
+
+    /**
+     * Writes the statistics as little endian 32-bit values and returns
+     * the number of bytes written.
+     *
+     * The buffer must hold CHILLDUINO_STATISTICS_LENGTH bytes.
+     *
+     */
+    unsigned int encode(unsigned char *buffer) const {
+      unsigned char *start = buffer;
+
+      encodeU32(buffer, _ticks);
+      encodeU32(buffer, getWindowTicks());
+      encodeU32(buffer, _windowCompressorTicks);
+      encodeU32(buffer, _windowCompressorStarts);
+      encodeU32(buffer, _compressorStarts);
+      encodeU32(buffer, _compressorTicks);
+      encodeU32(buffer, _defrosts);
+      encodeU32(buffer, _forcedDefrosts);
+      encodeU32(buffer, getAverageDefrostTicks());
+      encodeU32(buffer, _bimetalDefrosts);
+      encodeU32(buffer, _timedOutDefrosts);
+      encodeU32(buffer, _doorOpens);
+      encodeU32(buffer, _doorOpenTicks);
+      encodeU32(buffer, getCompressorDutyCycle());
+      encodeU32(buffer, _abortedDefrosts);
+
+      return buffer - start;
+    }
+};
+
+#endif /* CHILLDUINO_STATISTICS_H */
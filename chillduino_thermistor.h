@@ -0,0 +1,110 @@
+/**
+ * Copyright (c) 2015 FirstBuild
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef CHILLDUINO_THERMISTOR_H
+#define CHILLDUINO_THERMISTOR_H
+
+#include "chillduino_thermistor_table.h"
+
+/**
+ * The largest reading of the 10-bit ADC.
+ *
+ */
+#define CHILLDUINO_THERMISTOR_MAXIMUM_READING 1023
+
+/**
+ * The largest error (in tenths of a degree Celsius) of a converted
+ * temperature between CHILLDUINO_THERMISTOR_MINIMUM_ACCURATE_TEMPERATURE
+ * and CHILLDUINO_THERMISTOR_MAXIMUM_ACCURATE_TEMPERATURE.
+ *
+ * The error is measured against the beta equation the table is
+ * generated from. Outside of that range the table entries are further
+ * apart and the error grows, reaching several degrees near -40 C.
+ *
+ */
+#define CHILLDUINO_THERMISTOR_TOLERANCE                      2
+#define CHILLDUINO_THERMISTOR_MINIMUM_ACCURATE_TEMPERATURE (-300)
+#define CHILLDUINO_THERMISTOR_MAXIMUM_ACCURATE_TEMPERATURE   500
+
+/**
+ * Converts a thermistor reading to a temperature in tenths of a
+ * degree Celsius.
+ *
+ * The temperature is interpolated between the two table entries that
+ * surround the reading, which costs two table reads, a multiply and
+ * a shift.
+ *
+ */
+inline int chillduinoThermistorTemperature(int reading) {
+  if (reading < 0) {
+    reading = 0;
+  }
+  else if (reading > CHILLDUINO_THERMISTOR_MAXIMUM_READING) {
+    reading = CHILLDUINO_THERMISTOR_MAXIMUM_READING;
+  }
+
+  int index = reading >> CHILLDUINO_THERMISTOR_STEP_BITS;
+  int fraction = reading & ((1 << CHILLDUINO_THERMISTOR_STEP_BITS) - 1);
+  int low = CHILLDUINO_READ_WORD(&CHILLDUINO_THERMISTOR_TABLE[index]);
+  int high = CHILLDUINO_READ_WORD(&CHILLDUINO_THERMISTOR_TABLE[index + 1]);
+
+  return low + (((high - low) * fraction
+    + (1 << (CHILLDUINO_THERMISTOR_STEP_BITS - 1)))
+    >> CHILLDUINO_THERMISTOR_STEP_BITS);
+}
+
+/**
+ * Converts a temperature in tenths of a degree Celsius to the nearest
+ * thermistor reading.
+ *
+ * This searches the table and divides, so it is meant for converting
+ * settings rather than samples. Temperatures beyond the table are
+ * clamped to the first or last reading.
+ *
+ */
+inline int chillduinoThermistorReading(int temperature) {
+  int low = CHILLDUINO_READ_WORD(&CHILLDUINO_THERMISTOR_TABLE[0]);
+
+  if (temperature <= low) {
+    return 0;
+  }
+
+  for (int index = 0; index + 1 < CHILLDUINO_THERMISTOR_TABLE_SIZE; index++) {
+    int high = CHILLDUINO_READ_WORD(&CHILLDUINO_THERMISTOR_TABLE[index + 1]);
+
+    if (temperature < high) {
+      long reading = ((long) index << CHILLDUINO_THERMISTOR_STEP_BITS)
+        + ((((long) (temperature - low)) << CHILLDUINO_THERMISTOR_STEP_BITS)
+          + (high - low) / 2) / (high - low);
+
+      return (reading > CHILLDUINO_THERMISTOR_MAXIMUM_READING)
+        ? CHILLDUINO_THERMISTOR_MAXIMUM_READING : (int) reading;
+    }
+
+    low = high;
+  }
+
+  return CHILLDUINO_THERMISTOR_MAXIMUM_READING;
+}
+
+#endif /* CHILLDUINO_THERMISTOR_H */
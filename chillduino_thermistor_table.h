@@ -0,0 +1,53 @@
+/**
+ * Copyright (c) 2015 FirstBuild
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef CHILLDUINO_THERMISTOR_TABLE_H
+#define CHILLDUINO_THERMISTOR_TABLE_H
+
+#include "chillduino_progmem.h"
+
+/**
+ * The thermistor calibration table.
+ *
+ * Generated by host/thermistor.cpp, do not edit.
+ *
+ */
+#define CHILLDUINO_THERMISTOR_BETA               3950
+#define CHILLDUINO_THERMISTOR_NOMINAL_RESISTANCE 10000
+#define CHILLDUINO_THERMISTOR_SERIES_RESISTANCE  10000
+#define CHILLDUINO_THERMISTOR_STEP_BITS          4
+#define CHILLDUINO_THERMISTOR_TABLE_SIZE         65
+
+static const short CHILLDUINO_THERMISTOR_TABLE[CHILLDUINO_THERMISTOR_TABLE_SIZE] PROGMEM = {
+   -400,  -400,  -364,  -302,  -256,  -218,  -186,  -157,
+   -132,  -108,   -87,   -66,   -47,   -29,   -11,     5,
+     22,    37,    53,    68,    83,    97,   111,   125,
+    139,   153,   167,   181,   194,   208,   222,   236,
+    250,   264,   278,   293,   308,   323,   338,   354,
+    370,   386,   403,   421,   439,   458,   477,   498,
+    520,   543,   567,   593,   621,   652,   685,   722,
+    763,   811,   866,   933,  1016,  1127,  1250,  1250,
+   1250
+};
+
+#endif /* CHILLDUINO_THERMISTOR_TABLE_H */
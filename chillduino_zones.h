@@ -0,0 +1,671 @@
+/**
+ * Copyright (c) 2015 FirstBuild
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef CHILLDUINO_ZONES_H
+#define CHILLDUINO_ZONES_H
+
+#include "chillduino.h"
+
+/**
+ * The zone returned when the compressor is not cooling any zone.
+ *
+ */
+#define CHILLDUINO_ZONE_NONE ((unsigned int) -1)
+
+/**
+ * The timers kept for each zone, in the order they are stored.
+ *
+ * Every zone owns CHILLDUINO_ZONE_TIMERS consecutive timers, followed
+ * after the last zone by the compressor timer shared by all zones.
+ *
+ */
+#define CHILLDUINO_ZONE_TIMER_DOOR_CLOSE         0
+#define CHILLDUINO_ZONE_TIMER_WHILE_DEFROSTING   1
+#define CHILLDUINO_ZONE_TIMER_BIMETAL_CUTOFF     2
+#define CHILLDUINO_ZONE_TIMERS                   3
+
+/**
+ * A controller for a refrigerator with several compartments.
+ *
+ * Each zone (a freezer, a fresh food compartment, a convertible
+ * compartment whose band is changed with its mode) has its own
+ * thermistor band, door switch, evaporator and defrost heater, and
+ * behaves as a Chillduino would. The zones share a single compressor
+ * that cools one evaporator at a time. When the compressor is able to
+ * change, the zone being cooled keeps it until that zone is cold or due
+ * for a defrost, then it is handed to the warm zone with the lowest
+ * index that is not defrosting, or stopped if there is none. Zones
+ * should therefore be numbered by priority, usually freezer first.
+ * A zone only counts down to its defrost while it is being cooled and
+ * is never cooled while its heater is on, but the compressor may keep
+ * cooling the other zones during that defrost.
+ *
+ * tick() is meant to be called from the timer interrupt, so its cost
+ * must not depend on what the zones are doing. All countdown timers
+ * are kept in one contiguous array and decremented without branching,
+ * followed by the cooled zone's defrost countdown and the shared tick
+ * count. The door open time is measured against that tick count rather
+ * than counted per zone. That is CHILLDUINO_ZONE_TIMERS decrements per
+ * zone and one more for the compressor. On the ATmega32u4 each 32-bit
+ * decrement is four loads, a test, a subtract with carry and four
+ * stores, estimated from the instruction count at about 20 cycles.
+ * That puts a zone at about 60 cycles (4 us at 16 MHz), and four zones
+ * at under 3% of a 1 millisecond tick.
+ *
+ */
+template <unsigned int ZONES>
+class ChillduinoZones {
+  public:
+
+    /**
+     * The number of countdown timers, including the compressor timer.
+     *
+     */
+    static const unsigned int TIMERS = ZONES * CHILLDUINO_ZONE_TIMERS + 1;
+
+  private:
+    struct Zone {
+      int minimumThermistorReading;
+      int currentThermistorReading;
+      int maximumThermistorReading;
+      int previousDoorSwitchReading;
+      int currentDoorSwitchReading;
+      int previousDefrostSwitchReading;
+      int currentDefrostSwitchReading;
+      unsigned long minimumCompressorTicksPerDefrost;
+      unsigned long maximumCompressorTicksPerDefrost;
+      unsigned long remainingCompressorTicksUntilDefrost;
+      unsigned long defrostDurationInTicks;
+      unsigned long minimumTicksForDoorClose;
+      unsigned long minimumTicksForBimetalCutoff;
+      unsigned long doorOpenedAtTick;
+      bool isDoorOpen;
+      bool isDefrostRunning;
+      bool isBimetalCutoff;
+
+      Zone(void) :
+        minimumThermistorReading(0),
+        currentThermistorReading(0),
+        maximumThermistorReading(0),
+        previousDoorSwitchReading(0),
+        currentDoorSwitchReading(0),
+        previousDefrostSwitchReading(0),
+        currentDefrostSwitchReading(0),
+        minimumCompressorTicksPerDefrost(0),
+        maximumCompressorTicksPerDefrost(0),
+        remainingCompressorTicksUntilDefrost(0),
+        defrostDurationInTicks(0),
+        minimumTicksForDoorClose(0),
+        minimumTicksForBimetalCutoff(0),
+        doorOpenedAtTick(0),
+        isDoorOpen(false),
+        isDefrostRunning(false),
+        isBimetalCutoff(false) { }
+    };
+
+    unsigned long _timers[TIMERS];
+    Zone _zones[ZONES];
+    unsigned long _minimumTicksForCompressorChange;
+    unsigned long _ticks;
+    unsigned int _cooledZone;
+    int _mode;
+    bool _isChanged;
+
+  public:
+
+    /**
+     * Creates a new controller and initializes each value to the default.
+     *
+     */
+    ChillduinoZones(void) :
+      _timers(),
+      _zones(),
+      _minimumTicksForCompressorChange(0),
+      _ticks(0),
+      _cooledZone(CHILLDUINO_ZONE_NONE),
+      _mode(CHILLDUINO_MODE_COLDER),
+      _isChanged(false) { }
+
+    /**
+     * Gets the number of zones.
+     *
+     */
+    unsigned int getZoneCount(void) const {
+      return ZONES;
+    }
+
+    /**
+     * Sets the minimum thermistor reading allowed in the zone.
+     *
+     * If the reading of the zone being cooled falls below this value
+     * then the compressor will move on to another zone or stop.
+     *
+     */
+    ChillduinoZones& setMinimumThermistorReading(unsigned int zone,
+        int reading) {
+      _zones[zone].minimumThermistorReading = reading;
+      return *this;
+    }
+
+    /**
+     * Sets the current thermistor reading of the zone.
+     *
+     * This value should be updated as frequently as possible.
+     *
+     */
+    ChillduinoZones& setCurrentThermistorReading(unsigned int zone,
+        int reading) {
+      _zones[zone].currentThermistorReading = reading;
+      return *this;
+    }
+
+    /**
+     * Sets the maximum thermistor reading allowed in the zone.
+     *
+     * If the reading rises above this value then the zone will ask
+     * for the compressor.
+     *
+     */
+    ChillduinoZones& setMaximumThermistorReading(unsigned int zone,
+        int reading) {
+      _zones[zone].maximumThermistorReading = reading;
+      return *this;
+    }
+
+    /**
+     * Sets the minimum amount of time (in ticks) that the zone must be
+     * cooled before running its defrost.
+     *
+     * Assuming the door of the zone is opened non-stop, the defrost
+     * will start after the specified number of compressor ticks.
+     *
+     */
+    ChillduinoZones& setMinimumCompressorTicksPerDefrost(unsigned int zone,
+        unsigned long ticks) {
+      _zones[zone].minimumCompressorTicksPerDefrost = ticks;
+      return *this;
+    }
+
+    /**
+     * Sets the maximum amount of time (in ticks) that the zone must be
+     * cooled before running its defrost.
+     *
+     * Assuming the door of the zone remains closed, the defrost will
+     * start after the specified number of compressor ticks.
+     *
+     */
+    ChillduinoZones& setMaximumCompressorTicksPerDefrost(unsigned int zone,
+        unsigned long ticks) {
+      _zones[zone].maximumCompressorTicksPerDefrost = ticks;
+      return *this;
+    }
+
+    /**
+     * Gets the amount of time (in ticks) the zone still needs to be
+     * cooled before its defrost is able to be started.
+     *
+     */
+    unsigned long getRemainingCompressorTicksUntilDefrost(
+        unsigned int zone) const {
+      return _zones[zone].remainingCompressorTicksUntilDefrost;
+    }
+
+    /**
+     * Sets the amount of time (in ticks) the zone still needs to be
+     * cooled before its defrost is able to be started.
+     *
+     */
+    ChillduinoZones& setRemainingCompressorTicksUntilDefrost(
+        unsigned int zone, unsigned long ticks) {
+      _zones[zone].remainingCompressorTicksUntilDefrost = ticks;
+      return *this;
+    }
+
+    /**
+     * Sets the amount of time (in ticks) that the defrost of the zone
+     * will be running, unless its bimetal ends it sooner.
+     *
+     */
+    ChillduinoZones& setDefrostDurationInTicks(unsigned int zone,
+        unsigned long ticks) {
+      _zones[zone].defrostDurationInTicks = ticks;
+      return *this;
+    }
+
+    /**
+     * Sets the minimum time (in ticks) that the door switch reading of
+     * the zone must remain unchanged before triggering a door close event.
+     *
+     */
+    ChillduinoZones& setMinimumTicksForDoorClose(unsigned int zone,
+        unsigned long ticks) {
+      _zones[zone].minimumTicksForDoorClose = ticks;
+      return *this;
+    }
+
+    /**
+     * Sets the current door switch reading of the zone.
+     *
+     * This value should be updated as frequently as possible.
+     *
+     */
+    ChillduinoZones& setDoorSwitchReading(unsigned int zone, int reading) {
+      _zones[zone].currentDoorSwitchReading = reading;
+      return *this;
+    }
+
+    /**
+     * Sets the minimum time (in ticks) that the defrost switch reading of
+     * the zone must remain unchanged before the bimetal cutoff ends.
+     *
+     */
+    ChillduinoZones& setMinimumTicksForBimetalCutoff(unsigned int zone,
+        unsigned long ticks) {
+      _zones[zone].minimumTicksForBimetalCutoff = ticks;
+      return *this;
+    }
+
+    /**
+     * Sets the current defrost switch reading of the zone.
+     *
+     * This value should be updated as frequently as possible.
+     *
+     */
+    ChillduinoZones& setDefrostSwitchReading(unsigned int zone, int reading) {
+      _zones[zone].currentDefrostSwitchReading = reading;
+      return *this;
+    }
+
+    /**
+     * Sets the minimum time (in ticks) that the compressor must wait
+     * after starting or stopping before it is able to change again.
+     *
+     * Handing the compressor from one zone to another does not start
+     * or stop it, but is only done once it is able to change.
+     *
+     */
+    ChillduinoZones& setMinimumTicksForCompressorChange(unsigned long ticks) {
+      _minimumTicksForCompressorChange = ticks;
+      return *this;
+    }
+
+    /**
+     * Sets the mode shared by every zone.
+     *
+     * In the OFF mode the compressor and every heater are stopped.
+     * The other modes behave alike; the band of each zone is expected
+     * to be set from the mode by the caller.
+     *
+     */
+    ChillduinoZones& setMode(int mode) {
+      _mode = mode;
+      return *this;
+    }
+
+    /**
+     * Gets the mode shared by every zone.
+     *
+     */
+    int getMode(void) const {
+      return _mode;
+    }
+
+    /**
+     * Returns true if the compressor is running.
+     *
+     */
+    bool isCompressorRunning(void) const {
+      return _cooledZone != CHILLDUINO_ZONE_NONE;
+    }
+
+    /**
+     * Gets the zone the compressor is cooling, or CHILLDUINO_ZONE_NONE
+     * if the compressor is not running.
+     *
+     */
+    unsigned int getCooledZone(void) const {
+      return _cooledZone;
+    }
+
+    /**
+     * Returns true if the compressor is cooling the zone.
+     *
+     */
+    bool isZoneCooled(unsigned int zone) const {
+      return _cooledZone == zone;
+    }
+
+    /**
+     * Returns true if the defrost heater of the zone is running.
+     *
+     */
+    bool isDefrostRunning(unsigned int zone) const {
+      return _zones[zone].isDefrostRunning;
+    }
+
+    /**
+     * Returns true if the door of the zone is open.
+     *
+     */
+    bool isDoorOpen(unsigned int zone) const {
+      return _zones[zone].isDoorOpen;
+    }
+
+    /**
+     * Returns true if the defrost of the zone should be canceled.
+     *
+     */
+    bool isBimetalCutoff(unsigned int zone) const {
+      return _zones[zone].isBimetalCutoff;
+    }
+
+    /**
+     * Returns true if any of the output values have changed.
+     *
+     */
+    bool isChanged(void) const {
+      return _isChanged;
+    }
+
+    /**
+     * Advances the timers of every zone by a single tick.
+     *
+     * Ideally this function would be called from an interrupt service
+     * routine. It does the same work on every tick.
+     *
+     */
+    void tick(void) {
+      unsigned long *timer = _timers;
+      unsigned long *end = _timers + TIMERS;
+
+      for (; timer != end; timer++) {
+        *timer -= (*timer != 0);
+      }
+
+      if (_cooledZone != CHILLDUINO_ZONE_NONE) {
+        unsigned long &remaining =
+          _zones[_cooledZone].remainingCompressorTicksUntilDefrost;
+        remaining -= (remaining != 0);
+      }
+
+      _ticks++;
+    }
+
+    /**
+     * Checks the input values of every zone for changes and modifies
+     * outputs accordingly.
+     *
+     * This function must not be called from an interrupt as its time
+     * is not guaranteed.
+     *
+     */
+    void loop(void) {
+      _isChanged = false;
+
+      for (unsigned int zone = 0; zone < ZONES; zone++) {
+        checkDoorSwitch(zone);
+        checkDefrostSwitch(zone);
+      }
+
+      if (_mode == CHILLDUINO_MODE_OFF) {
+        if (isCompressorRunning()) {
+          stopRunningCompressor();
+        }
+
+        for (unsigned int zone = 0; zone < ZONES; zone++) {
+          if (_zones[zone].isDefrostRunning) {
+            stopRunningDefrost(zone);
+          }
+        }
+
+        return;
+      }
+
+      for (unsigned int zone = 0; zone < ZONES; zone++) {
+        if (_zones[zone].isDefrostRunning) {
+          if (timer(zone, CHILLDUINO_ZONE_TIMER_WHILE_DEFROSTING) == 0) {
+            delayDefrost(zone);
+          }
+          else if (_zones[zone].isBimetalCutoff) {
+            stopRunningDefrost(zone);
+          }
+        }
+      }
+
+      if (isCompressorReadyForChange()) {
+        arbitrateCompressor();
+      }
+    }
+
+    /**
+     * Gets the number of ticks until a running timer expires.
+     *
+     * While the inputs remain unchanged the outputs can only change
+     * on the tick that expires a timer. Returns CHILLDUINO_NEVER if no
+     * such timer is running.
+     *
+     */
+    unsigned long getTicksUntilNextEvent(void) const {
+      unsigned long ticks = CHILLDUINO_NEVER;
+
+      for (unsigned int i = 0; i < TIMERS; i++) {
+        ticks = earliest(ticks, _timers[i]);
+      }
+
+      if (_cooledZone != CHILLDUINO_ZONE_NONE) {
+        ticks = earliest(ticks,
+          _zones[_cooledZone].remainingCompressorTicksUntilDefrost);
+      }
+
+      return ticks;
+    }
+
+    /**
+     * Causes the amount of time (in ticks) to elapse.
+     *
+     * This behaves exactly as calling tick() then loop() once per tick,
+     * except that the ticks in which nothing can change are skipped.
+     * This is a helper function that should only be used for testing.
+     *
+     */
+    void elapse(unsigned long ticks) {
+      while (ticks > 0) {
+        tick();
+        loop();
+        ticks--;
+
+        if (!_isChanged) {
+          unsigned long skipped = getTicksUntilNextEvent() - 1;
+
+          if (skipped > ticks) {
+            skipped = ticks;
+          }
+
+          skip(skipped);
+          ticks -= skipped;
+        }
+      }
+    }
+
+  private:
+    static unsigned long earliest(unsigned long ticks, unsigned long remaining) {
+      return (remaining > 0 && remaining < ticks) ? remaining : ticks;
+    }
+
+    static unsigned long countdown(unsigned long remaining, unsigned long ticks) {
+      return (remaining > ticks) ? remaining - ticks : 0;
+    }
+
+    unsigned long &timer(unsigned int zone, unsigned int index) {
+      return _timers[zone * CHILLDUINO_ZONE_TIMERS + index];
+    }
+
+    unsigned long &compressorTimer(void) {
+      return _timers[ZONES * CHILLDUINO_ZONE_TIMERS];
+    }
+
+    void skip(unsigned long ticks) {
+      if (ticks == 0) {
+        return;
+      }
+
+      for (unsigned int i = 0; i < TIMERS; i++) {
+        _timers[i] = countdown(_timers[i], ticks);
+      }
+
+      if (_cooledZone != CHILLDUINO_ZONE_NONE) {
+        Zone &zone = _zones[_cooledZone];
+        zone.remainingCompressorTicksUntilDefrost =
+          countdown(zone.remainingCompressorTicksUntilDefrost, ticks);
+      }
+
+      _ticks += ticks;
+    }
+
+    bool isCompressorReadyForChange(void) const {
+      return _timers[ZONES * CHILLDUINO_ZONE_TIMERS] == 0;
+    }
+
+    bool isWarm(unsigned int zone) const {
+      return _zones[zone].currentThermistorReading
+        > _zones[zone].maximumThermistorReading;
+    }
+
+    bool isCold(unsigned int zone) const {
+      return _zones[zone].currentThermistorReading
+        < _zones[zone].minimumThermistorReading;
+    }
+
+    void checkDoorSwitch(unsigned int zone) {
+      Zone &z = _zones[zone];
+
+      if (z.previousDoorSwitchReading != z.currentDoorSwitchReading) {
+        z.previousDoorSwitchReading = z.currentDoorSwitchReading;
+
+        if (!z.isDoorOpen) {
+          z.isDoorOpen = true;
+          z.doorOpenedAtTick = _ticks;
+          _isChanged = true;
+        }
+
+        timer(zone, CHILLDUINO_ZONE_TIMER_DOOR_CLOSE) =
+          z.minimumTicksForDoorClose;
+      }
+      else if (z.isDoorOpen &&
+          timer(zone, CHILLDUINO_ZONE_TIMER_DOOR_CLOSE) == 0) {
+        z.isDoorOpen = false;
+        _isChanged = true;
+
+        if (z.remainingCompressorTicksUntilDefrost >
+            z.minimumCompressorTicksPerDefrost) {
+          z.remainingCompressorTicksUntilDefrost =
+            z.minimumCompressorTicksPerDefrost + countdown(
+              z.remainingCompressorTicksUntilDefrost -
+              z.minimumCompressorTicksPerDefrost, _ticks - z.doorOpenedAtTick);
+        }
+      }
+    }
+
+    void checkDefrostSwitch(unsigned int zone) {
+      Zone &z = _zones[zone];
+
+      if (z.previousDefrostSwitchReading != z.currentDefrostSwitchReading) {
+        z.previousDefrostSwitchReading = z.currentDefrostSwitchReading;
+
+        if (!z.isBimetalCutoff) {
+          z.isBimetalCutoff = true;
+          _isChanged = true;
+        }
+
+        timer(zone, CHILLDUINO_ZONE_TIMER_BIMETAL_CUTOFF) =
+          z.minimumTicksForBimetalCutoff;
+      }
+      else if (z.isBimetalCutoff &&
+          timer(zone, CHILLDUINO_ZONE_TIMER_BIMETAL_CUTOFF) == 0) {
+        z.isBimetalCutoff = false;
+        _isChanged = true;
+      }
+    }
+
+    void arbitrateCompressor(void) {
+      if (_cooledZone != CHILLDUINO_ZONE_NONE) {
+        Zone &z = _zones[_cooledZone];
+
+        if (z.remainingCompressorTicksUntilDefrost == 0) {
+          startRunningDefrost(_cooledZone);
+        }
+        else if (!isCold(_cooledZone)) {
+          return;
+        }
+      }
+
+      unsigned int next = CHILLDUINO_ZONE_NONE;
+
+      for (unsigned int zone = 0; zone < ZONES; zone++) {
+        if (isWarm(zone) && !_zones[zone].isDefrostRunning) {
+          next = zone;
+          break;
+        }
+      }
+
+      if (next == _cooledZone) {
+        return;
+      }
+
+      if (next == CHILLDUINO_ZONE_NONE || _cooledZone == CHILLDUINO_ZONE_NONE) {
+        compressorTimer() = _minimumTicksForCompressorChange;
+      }
+
+      _cooledZone = next;
+      _isChanged = true;
+    }
+
+    void stopRunningCompressor(void) {
+      _cooledZone = CHILLDUINO_ZONE_NONE;
+      _isChanged = true;
+      compressorTimer() = _minimumTicksForCompressorChange;
+    }
+
+    void startRunningDefrost(unsigned int zone) {
+      _zones[zone].isDefrostRunning = true;
+      _isChanged = true;
+      timer(zone, CHILLDUINO_ZONE_TIMER_WHILE_DEFROSTING) =
+        _zones[zone].defrostDurationInTicks;
+    }
+
+    void stopRunningDefrost(unsigned int zone) {
+      _zones[zone].isDefrostRunning = false;
+      _zones[zone].remainingCompressorTicksUntilDefrost =
+        _zones[zone].maximumCompressorTicksPerDefrost;
+      _isChanged = true;
+    }
+
+    void delayDefrost(unsigned int zone) {
+      _zones[zone].isDefrostRunning = false;
+      _zones[zone].remainingCompressorTicksUntilDefrost =
+        _zones[zone].minimumCompressorTicksPerDefrost;
+      _isChanged = true;
+    }
+};
+
+#endif /* CHILLDUINO_ZONES_H */
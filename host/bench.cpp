@@ -0,0 +1,731 @@
+/**
+ * Copyright (c) 2015 FirstBuild
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/**
+ * Benchmarks for the host side chillduino simulation.
+ *
+ * Each benchmark prints what it measured and how long it took.
+ *
+ */
+
+#define CHILLDUINO_STATISTICS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <chillduino_zones.h>
+#include <host/chillduino_anomalies.h>
+#include <host/chillduino_building.h>
+#include <host/chillduino_columns.h>
+#include <host/chillduino_fleet.h>
+#include <host/chillduino_scenario.h>
+#include <host/chillduino_simulator.h>
+
+#define TICKS_PER_SECOND   ((unsigned long) 1000)
+#define TICKS_PER_MINUTE   (60 * TICKS_PER_SECOND)
+#define TICKS_PER_HOUR     (60 * TICKS_PER_MINUTE)
+#define TICKS_PER_DAY      (24 * TICKS_PER_HOUR)
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static Chillduino createChillduino(void) {
+  return Chillduino()
+    .setMode(CHILLDUINO_MODE_COLDER)
+    .setMinimumFreshFoodThermistorReading(215)
+    .setMaximumFreshFoodThermistorReading(345)
+    .setMinimumCompressorTicksPerDefrost(12 * TICKS_PER_HOUR)
+    .setMaximumCompressorTicksPerDefrost(96 * TICKS_PER_HOUR)
+    .setRemainingCompressorTicksUntilDefrost(96 * TICKS_PER_HOUR)
+    .setDefrostDurationInTicks(30 * TICKS_PER_MINUTE)
+    .setMinimumTicksForCompressorChange(10 * TICKS_PER_MINUTE)
+    .setMinimumTicksForDoorClose(100)
+    .setMinimumTicksForHeldModeSwitch(3 * TICKS_PER_SECOND)
+    .setMinimumTicksForForceDefrost(5 * TICKS_PER_SECOND)
+    .setMinimumTicksForCloseBeforeForceDefrost(5 * TICKS_PER_SECOND)
+    .setMinimumOpensForForceDefrost(3)
+    .setMinimumTicksForBimetalCutoff(100);
+}
+
+static ChillduinoPlant createPlant(void) {
+  return ChillduinoPlant(380, 150, 500)
+    .setWarmingTicksPerCount(20 * TICKS_PER_SECOND)
+    .setCoolingTicksPerCount(7 * TICKS_PER_SECOND)
+    .setDefrostingTicksPerCount(4 * TICKS_PER_SECOND);
+}
+
+static void printTotals(const char *name, const ChillduinoTotals &totals,
+    double seconds) {
+  printf("%-28s %9.3f ms  compressor %5.1f%%  starts %6lu  defrosts %4lu\n",
+    name, seconds * 1e3,
+    100.0 * totals.compressorTicks / totals.ticks,
+    totals.compressorStarts, totals.defrosts);
+}
+
+static void benchmarkYearOfSteadyState(void) {
+  ChillduinoSimulator skipping(createChillduino(), createPlant());
+  ChillduinoSimulator extrapolating(createChillduino(), createPlant());
+
+  extrapolating.setCycleDetectionEnabled(true);
+
+  double started = now();
+  skipping.elapse(365 * TICKS_PER_DAY);
+  double skipped = now() - started;
+
+  started = now();
+  extrapolating.elapse(365 * TICKS_PER_DAY);
+  double extrapolated = now() - started;
+
+  printTotals("year, event skipping", skipping.getTotals(), skipped);
+  printTotals("year, cycle extrapolation", extrapolating.getTotals(),
+    extrapolated);
+  printf("%-28s %lu periods\n", "", extrapolating.getExtrapolatedPeriods());
+}
+
+static void benchmarkDayOfTicking(void) {
+  Chillduino chillduino = createChillduino();
+  ChillduinoPlant plant = createPlant();
+  ChillduinoTotals totals = ChillduinoTotals();
+
+  double started = now();
+
+  for (unsigned long t = 0; t < TICKS_PER_DAY; t++) {
+    bool isCompressorRunning = chillduino.isCompressorRunning();
+    bool isDefrostRunning = chillduino.isDefrostRunning();
+
+    plant.setRunning(isCompressorRunning, isDefrostRunning);
+    plant.elapse(1);
+    chillduino.setCurrentFreshFoodThermistorReading(plant.getReading());
+    chillduino.tick();
+    chillduino.loop();
+
+    totals.ticks++;
+    totals.compressorTicks += isCompressorRunning;
+    totals.compressorStarts +=
+      !isCompressorRunning && chillduino.isCompressorRunning();
+    totals.defrosts += !isDefrostRunning && chillduino.isDefrostRunning();
+  }
+
+  printTotals("day, ticking every tick", totals, now() - started);
+}
+
+static void benchmarkDayOfSlowLoop(void) {
+  Chillduino chillduino = createChillduino();
+  ChillduinoPlant plant = createPlant();
+  ChillduinoTotals totals = ChillduinoTotals();
+  const unsigned long period = 50;
+
+  double started = now();
+
+  for (unsigned long t = 0; t < TICKS_PER_DAY; t += period) {
+    bool isCompressorRunning = chillduino.isCompressorRunning();
+    bool isDefrostRunning = chillduino.isDefrostRunning();
+
+    plant.setRunning(isCompressorRunning, isDefrostRunning);
+    plant.elapse(period);
+    chillduino.setCurrentFreshFoodThermistorReading(plant.getReading());
+    chillduino.loop(period);
+
+    totals.ticks += period;
+    totals.compressorTicks += isCompressorRunning * period;
+    totals.compressorStarts +=
+      !isCompressorRunning && chillduino.isCompressorRunning();
+    totals.defrosts += !isDefrostRunning && chillduino.isDefrostRunning();
+  }
+
+  printTotals("day, loop every 50 ticks", totals, now() - started);
+}
+
+static void addFleetUnits(ChillduinoFleet &fleet, ChillduinoInput *inputs,
+    unsigned int units, unsigned int count, unsigned long duration) {
+  unsigned long random = 1;
+
+  for (unsigned int u = 0; u < units; u++) {
+    ChillduinoInput *input = inputs + u * count;
+    unsigned long time = 0;
+    unsigned long doorTime = 0;
+    unsigned int n = 0;
+
+    while (n + 2 <= count) {
+      random = random * 1103515245 + 12345;
+      unsigned long r = (random >> 8) & 0xFFFFFF;
+
+      time += TICKS_PER_MINUTE + r % (9 * TICKS_PER_MINUTE);
+
+      if (time >= duration) {
+        break;
+      }
+
+      if (doorTime + 2 * TICKS_PER_HOUR < time && (r & 0xF) == 0) {
+        doorTime = time;
+        input[n].time = time;
+        input[n].type = CHILLDUINO_INPUT_DOOR_SWITCH;
+        input[n++].reading = 1;
+        time += 10 * TICKS_PER_SECOND + (r >> 4) % TICKS_PER_MINUTE;
+        input[n].time = time;
+        input[n].type = CHILLDUINO_INPUT_DOOR_SWITCH;
+        input[n++].reading = 0;
+      }
+      else {
+        input[n].time = time;
+        input[n].type = CHILLDUINO_INPUT_THERMISTOR;
+        input[n++].reading = 200 + (r >> 8) % 160;
+      }
+    }
+
+    fleet.add(createChillduino()
+      .setMinimumTicksForCompressorChange((5 + u % 11) * TICKS_PER_MINUTE)
+      .setMaximumFreshFoodThermistorReading(330 + u % 31), input, n);
+  }
+}
+
+static void benchmarkFleetOfDiscreteEvents(void) {
+  const unsigned int units = 100000;
+  const unsigned int count = 128;
+  const unsigned long duration = 6 * TICKS_PER_HOUR;
+  ChillduinoInput *inputs = new ChillduinoInput[units * count];
+  ChillduinoFleet fleet(units);
+
+  addFleetUnits(fleet, inputs, units, count, duration);
+
+  double started = now();
+  fleet.elapse(duration);
+  double seconds = now() - started;
+
+  printf("%-28s %9.3f ms  %u units  %lu events  %.1f M events/s\n",
+    "6 hours, discrete events", seconds * 1e3, units, fleet.getEvents(),
+    fleet.getEvents() / seconds / 1e6);
+  printf("%-28s %lu starts  peak %lu compressors\n", "",
+    fleet.getCompressorStarts(), fleet.getPeakRunningCompressors());
+
+  delete[] inputs;
+}
+
+class DoorTrafficScenario : public ChillduinoScenario {
+  private:
+    unsigned long _random;
+    int _round;
+
+    DoorTrafficScenario(const DoorTrafficScenario &);
+    DoorTrafficScenario &operator=(const DoorTrafficScenario &);
+
+    unsigned long next(unsigned long limit) {
+      _random = _random * 1103515245 + 12345;
+      return ((_random >> 8) & 0xFFFFFF) % limit;
+    }
+
+  protected:
+    bool run(void) {
+      CHILLDUINO_SCENARIO_BEGIN();
+
+      for (_round = 0; _round < 24; _round++) {
+        getChillduino().setCurrentFreshFoodThermistorReading(360 + next(20));
+        CHILLDUINO_UNTIL(getChillduino().isCompressorRunning());
+        CHILLDUINO_AFTER(next(TICKS_PER_HOUR));
+        getChillduino().setDoorSwitchReading(1);
+        CHILLDUINO_AFTER(TICKS_PER_SECOND + next(TICKS_PER_MINUTE));
+        getChillduino().setDoorSwitchReading(0);
+        getChillduino().setCurrentFreshFoodThermistorReading(200);
+        CHILLDUINO_UNTIL(!getChillduino().isCompressorRunning());
+      }
+
+      CHILLDUINO_SCENARIO_END();
+    }
+
+  public:
+    explicit DoorTrafficScenario(unsigned long seed) :
+      ChillduinoScenario(createChillduino()),
+      _random(seed),
+      _round(0) { }
+};
+
+static void benchmarkScenarioCampaign(void) {
+  const unsigned int count = 10000;
+  DoorTrafficScenario **scenarios = new DoorTrafficScenario *[count];
+  ChillduinoScenarioRunner runner(count);
+
+  for (unsigned int i = 0; i < count; i++) {
+    scenarios[i] = new DoorTrafficScenario(i + 1);
+    runner.add(scenarios[i]);
+  }
+
+  double started = now();
+  runner.elapse(7 * TICKS_PER_DAY);
+  double seconds = now() - started;
+
+  printf("%-28s %9.3f ms  %u scenarios  %u finished  %lu resumes\n",
+    "week, scenario campaign", seconds * 1e3, count, runner.getFinished(),
+    runner.getResumes());
+
+  for (unsigned int i = 0; i < count; i++) {
+    delete scenarios[i];
+  }
+
+  delete[] scenarios;
+}
+
+static void benchmarkColumnsOfFleetMetrics(void) {
+  const char *names[] = {
+    "minute", "unit", "compressor", "defrost", "door", "untilDefrost"
+  };
+  const unsigned int columns = sizeof(names) / sizeof(names[0]);
+  const unsigned int units = 10000;
+  const unsigned int count = 128;
+  const unsigned int minutes = 6 * 60;
+  const unsigned long rows = (unsigned long) units * minutes;
+  ChillduinoInput *inputs = new ChillduinoInput[units * count];
+  uint32_t *values = new uint32_t[rows * columns];
+  ChillduinoFleet fleet(units);
+  char path[] = "/tmp/chillduino-bench-XXXXXX";
+
+  addFleetUnits(fleet, inputs, units, count, minutes * TICKS_PER_MINUTE);
+
+  for (unsigned int m = 0; m < minutes; m++) {
+    fleet.elapse(TICKS_PER_MINUTE);
+
+    for (unsigned int u = 0; u < units; u++) {
+      Chillduino &chillduino = fleet.getChillduino(u);
+      uint32_t *row = values + ((unsigned long) m * units + u) * columns;
+
+      row[0] = m;
+      row[1] = u;
+      row[2] = chillduino.isCompressorRunning();
+      row[3] = chillduino.isDefrostRunning();
+      row[4] = chillduino.isDoorOpen();
+      row[5] = chillduino.getRemainingCompressorTicksUntilDefrost()
+        / TICKS_PER_SECOND;
+    }
+  }
+
+  FILE *text = tmpfile();
+  double started = now();
+
+  for (unsigned long r = 0; r < rows; r++) {
+    const uint32_t *row = values + r * columns;
+    fprintf(text, "%u,%u,%u,%u,%u,%u\n",
+      row[0], row[1], row[2], row[3], row[4], row[5]);
+  }
+
+  fflush(text);
+  double printed = now() - started;
+  long textBytes = ftell(text);
+  fclose(text);
+
+  int fd = mkstemp(path);
+  unlink(path);
+
+  started = now();
+  ChillduinoColumnWriter *writer =
+    new ChillduinoColumnWriter(fd, names, columns, 65536);
+
+  for (unsigned long r = 0; r < rows; r++) {
+    writer->append(values + r * columns);
+  }
+
+  writer->close();
+  double written = now() - started;
+  unsigned long columnBytes = writer->getBytes();
+  delete writer;
+
+  ChillduinoColumnReader reader(fd);
+  long column = reader.findColumn("compressor");
+
+  started = now();
+  unsigned long running = reader.sum(column);
+  double scanned = now() - started;
+
+  printf("%-28s %9.3f ms  %lu rows  %.1f bytes/row\n", "metrics, text",
+    printed * 1e3, rows, (double) textBytes / rows);
+  printf("%-28s %9.3f ms  %lu rows  %.2f bytes/row\n", "metrics, columns",
+    written * 1e3, rows, (double) columnBytes / rows);
+  printf("%-28s %9.3f ms  %lu running  %.1f GB/s of values\n",
+    "metrics, column scan", scanned * 1e3, running,
+    rows * sizeof(uint32_t) / scanned / 1e9);
+
+  close(fd);
+  delete[] values;
+  delete[] inputs;
+}
+
+static void simulateYearOfDefrosts(const char *name,
+    const Chillduino &chillduino, unsigned long compressorTicksPerDefrostTick) {
+  ChillduinoPlant plant = createPlant()
+    .setCompressorTicksPerDefrostTick(compressorTicksPerDefrostTick)
+    .setDefrostWarmupTicks(8 * TICKS_PER_MINUTE)
+    .setBimetalToggleTicks(50);
+  ChillduinoSimulator simulator(Chillduino(chillduino)
+    .setStatisticsWindowInTicks(TICKS_PER_HOUR), plant);
+
+  double started = now();
+  simulator.elapse(365 * TICKS_PER_DAY);
+  double seconds = now() - started;
+
+  const ChillduinoTotals &totals = simulator.getTotals();
+  ChillduinoStatistics statistics;
+
+  simulator.getChillduino().getStatistics(statistics);
+
+  printf("%-28s %9.3f ms  defrosts %4lu  timed out %4lu  heater %6.1f h"
+    "  frost left %5.1f h\n", name, seconds * 1e3, totals.defrosts,
+    statistics.getTimedOutDefrosts(),
+    (double) totals.heaterTicks / TICKS_PER_HOUR,
+    (double) simulator.getPlant().getFrost()
+      / compressorTicksPerDefrostTick / TICKS_PER_HOUR);
+}
+
+static void benchmarkYearOfAdaptiveDefrosts(void) {
+  static const struct {
+    const char *name;
+    unsigned long compressorTicksPerDefrostTick;
+  } loads[] = {
+    { "light", 1152 },
+    { "typical", 288 },
+    { "heavy", 96 }
+  };
+
+  Chillduino fixed = createChillduino();
+  Chillduino adaptive = createChillduino()
+    .setMaximumCompressorTicksPerDefrost(240 * TICKS_PER_HOUR)
+    .setTargetDefrostDurationInTicks(25 * TICKS_PER_MINUTE)
+    .setLearnedCompressorTicksPerDefrost(96 * TICKS_PER_HOUR);
+  char name[32];
+
+  for (unsigned int i = 0; i < sizeof(loads) / sizeof(loads[0]); i++) {
+    snprintf(name, sizeof(name), "year, %s frost, fixed", loads[i].name);
+    simulateYearOfDefrosts(name, fixed, loads[i].compressorTicksPerDefrostTick);
+    snprintf(name, sizeof(name), "year, %s frost, adaptive", loads[i].name);
+    simulateYearOfDefrosts(name, adaptive,
+      loads[i].compressorTicksPerDefrostTick);
+  }
+}
+
+template <unsigned int ZONES>
+static void benchmarkZoneTicks(void) {
+  ChillduinoZones<ZONES> zones;
+  char name[32];
+
+  for (unsigned int zone = 0; zone < ZONES; zone++) {
+    zones.setMinimumTicksForDoorClose(zone, TICKS_PER_DAY)
+      .setDoorSwitchReading(zone, 1);
+  }
+
+  zones.loop();
+
+  double started = now();
+
+  for (unsigned long t = 0; t < 4 * TICKS_PER_HOUR; t++) {
+    zones.tick();
+  }
+
+  double seconds = now() - started;
+
+  snprintf(name, sizeof(name), "zone ticks, %u zone%s", ZONES,
+    ZONES == 1 ? "" : "s");
+  printf("%-28s %9.3f ms  %5.2f ns/tick  %5.2f ns/zone  next %lu\n",
+    name, seconds * 1e3, seconds * 1e9 / (4 * TICKS_PER_HOUR),
+    seconds * 1e9 / (4 * TICKS_PER_HOUR) / ZONES,
+    zones.getTicksUntilNextEvent());
+}
+
+static void simulateBuildingAfterPowerCut(const char *name,
+    bool isStaggered) {
+  ChillduinoBuilding building(200, TICKS_PER_SECOND);
+  unsigned long random = 2015;
+
+  for (unsigned int i = 0; i < 200; i++) {
+    random = random * 1103515245 + 12345;
+    unsigned long r = (random >> 8) & 0xFFFFFF;
+    Chillduino chillduino = createChillduino();
+
+    // the random bits stand in for the unit's uuid
+    if (isStaggered) {
+      chillduino.setStartDelayInTicks(r % (2 * TICKS_PER_MINUTE))
+        .setShedMarginTemperature(20);
+    }
+
+    building.add(chillduino, ChillduinoPlant(350 + (r >> 4) % 100, 150, 500)
+      .setWarmingTicksPerCount((15 + (r >> 12) % 10) * TICKS_PER_SECOND)
+      .setCoolingTicksPerCount(7 * TICKS_PER_SECOND)
+      .setDefrostingTicksPerCount(4 * TICKS_PER_SECOND));
+  }
+
+  double started = now();
+
+  building.elapse(TICKS_PER_MINUTE);
+  unsigned long restoredStarts = building.getPeakCompressorStarts();
+  building.elapse(3 * TICKS_PER_HOUR - TICKS_PER_MINUTE);
+  unsigned long running = building.getRunningCompressors();
+
+  // a one hour grid shed, which a unit without the layer ignores
+  building.setShedding(true);
+  building.elapse(15 * TICKS_PER_MINUTE);
+  unsigned long shedRunning = building.getRunningCompressors();
+  building.elapse(45 * TICKS_PER_MINUTE);
+  building.setShedding(false);
+  building.elapse(2 * TICKS_PER_HOUR);
+
+  double seconds = now() - started;
+
+  printf("%-28s %9.3f ms  starts/s %3lu  peak %3lu  shed %3lu -> %3lu"
+    "  over band %5.2f C avg %4.1f C peak\n", name, seconds * 1e3,
+    restoredStarts, building.getPeakRunningCompressors(), running,
+    shedRunning, building.getOvershoot() / 10.0 / 200
+      / (6 * TICKS_PER_HOUR / TICKS_PER_SECOND),
+    building.getPeakOvershoot() / 10.0);
+}
+
+static void simulateDayOfCoasting(const char *name,
+    const Chillduino &chillduino) {
+  ChillduinoSimulator simulator(Chillduino(chillduino)
+    .setRemainingCompressorTicksUntilDefrost(96 * TICKS_PER_HOUR),
+    createPlant().setCoastTicks(3 * TICKS_PER_MINUTE));
+  unsigned long overshoot = 0;
+  int lowest = CHILLDUINO_THERMISTOR_MAXIMUM_READING;
+
+  // the first hour pulls the plant down and teaches the coast
+  simulator.elapse(TICKS_PER_HOUR);
+
+  ChillduinoTotals before = simulator.getTotals();
+  double started = now();
+
+  for (unsigned long t = 0; t < TICKS_PER_DAY; t += TICKS_PER_SECOND) {
+    simulator.elapse(TICKS_PER_SECOND);
+
+    int reading = simulator.getPlant().getReading();
+
+    if (reading < 215) {
+      overshoot += 215 - reading;
+    }
+
+    if (reading < lowest) {
+      lowest = reading;
+    }
+  }
+
+  double seconds = now() - started;
+  const ChillduinoTotals &totals = simulator.getTotals();
+
+  printf("%-28s %9.3f ms  compressor %5.1f%%  starts %3lu  lowest %3d"
+    "  below band %6.1f count-h\n", name, seconds * 1e3,
+    100.0 * (totals.compressorTicks - before.compressorTicks)
+      / (totals.ticks - before.ticks),
+    totals.compressorStarts - before.compressorStarts, lowest,
+    overshoot / 3600.0);
+}
+
+static void benchmarkDayOfPredictiveCutoff(void) {
+  simulateDayOfCoasting("day, hysteresis cutoff", createChillduino());
+  simulateDayOfCoasting("day, predictive cutoff", createChillduino()
+    .setSlopeSampleTicks(20 * TICKS_PER_SECOND));
+}
+
+static void benchmarkBuildingAfterPowerCut(void) {
+  simulateBuildingAfterPowerCut("building, together", false);
+  simulateBuildingAfterPowerCut("building, staggered", true);
+}
+
+// one unit in every FAULT_PERIOD has each fault injected
+#define FAULT_PERIOD          64
+#define FAULT_WEAK_COMPRESSOR 1
+#define FAULT_STUCK_DOOR      2
+#define FAULT_HEAVY_FROST     3
+
+static void recordFleetTelemetry(int32_t *readings, int32_t *states,
+    unsigned int units, unsigned int samples) {
+  ChillduinoSimulator **simulators = new ChillduinoSimulator *[units];
+  unsigned long *cutoffs = new unsigned long[units];
+
+  for (unsigned int u = 0; u < units; u++) {
+    unsigned int fault = u % FAULT_PERIOD;
+    int minimumReading = (fault == FAULT_WEAK_COMPRESSOR) ? 360 : 150;
+    ChillduinoPlant plant = ChillduinoPlant(380, minimumReading, 500)
+      .setWarmingTicksPerCount(20 * TICKS_PER_SECOND)
+      .setCoolingTicksPerCount(7 * TICKS_PER_SECOND)
+      .setDefrostingTicksPerCount(4 * TICKS_PER_SECOND)
+      .setCompressorTicksPerDefrostTick(fault == FAULT_HEAVY_FROST ? 4 : 288)
+      .setDefrostWarmupTicks(8 * TICKS_PER_MINUTE)
+      .setBimetalToggleTicks(50);
+
+    simulators[u] = new ChillduinoSimulator(createChillduino()
+      .setStatisticsWindowInTicks(TICKS_PER_HOUR)
+      .setMinimumCompressorTicksPerDefrost(4 * TICKS_PER_HOUR)
+      .setMaximumCompressorTicksPerDefrost(4 * TICKS_PER_HOUR)
+      .setRemainingCompressorTicksUntilDefrost((u % 16 + 1) * 15
+        * TICKS_PER_MINUTE), plant);
+    cutoffs[u] = 0;
+  }
+
+  for (unsigned int s = 0; s < samples; s++) {
+    for (unsigned int u = 0; u < units; u++) {
+      ChillduinoSimulator &simulator = *simulators[u];
+      simulator.elapse(TICKS_PER_MINUTE);
+
+      Chillduino &chillduino = simulator.getChillduino();
+      ChillduinoStatistics statistics;
+
+      chillduino.getStatistics(statistics);
+      unsigned long bimetal = statistics.getBimetalDefrosts();
+      unsigned long i = (unsigned long) s * units + u;
+
+      // the bimetal pulse is over long before the next sample, so it is
+      // taken from the count of defrosts it cut off
+      readings[i] = simulator.getPlant().getReading();
+      states[i] = (chillduino.isCompressorRunning()
+          ? CHILLDUINO_TELEMETRY_COMPRESSOR : 0)
+        | (chillduino.isDefrostRunning() ? CHILLDUINO_TELEMETRY_DEFROST : 0)
+        | (chillduino.isDoorOpen() ? CHILLDUINO_TELEMETRY_DOOR : 0)
+        | (bimetal != cutoffs[u] ? CHILLDUINO_TELEMETRY_BIMETAL : 0);
+      cutoffs[u] = bimetal;
+
+      // the door switch would have to keep toggling to read as open, so
+      // a stuck door is injected into the telemetry after half a day
+      if (u % FAULT_PERIOD == FAULT_STUCK_DOOR && s >= 12 * 60) {
+        states[i] |= CHILLDUINO_TELEMETRY_DOOR;
+      }
+    }
+  }
+
+  for (unsigned int u = 0; u < units; u++) {
+    delete simulators[u];
+  }
+
+  delete[] simulators;
+  delete[] cutoffs;
+}
+
+static void detectFleetAnomalies(const char *name, bool isVectorized,
+    const int32_t *readings, const int32_t *states, unsigned int units,
+    unsigned int samples) {
+  ChillduinoAnomalyDetector detector(units, 215);
+  int32_t *seen = new int32_t[units];
+  unsigned int flagged[3] = { 0, 0, 0 };
+  unsigned int wrong = 0;
+  double sampling = 0;
+
+  detector
+    .setCompressorRunLimit(2 * 60)
+    .setDoorOpenLimit(30)
+    .setDefrostTimeoutLimit(2)
+    .setVectorized(isVectorized);
+
+  memset(seen, 0, units * sizeof(int32_t));
+  double started = now();
+
+  for (unsigned int s = 0; s < samples; s++) {
+    const int32_t *reading = readings + (unsigned long) s * units;
+    const int32_t *state = states + (unsigned long) s * units;
+
+    // each change of state arrives as a frame, as the sketch sends them
+    for (unsigned int u = 0; u < units; u++) {
+      int32_t previous = s > 0 ? (state - units)[u] : 0;
+      int32_t changed = state[u] ^ previous;
+
+      seen[u] |= detector.getAnomalies(u);
+      detector.setReading(u, reading[u]);
+
+      for (int32_t bit = 1; changed != 0; bit <<= 1) {
+        if (changed & bit) {
+          detector.setState(u, bit, state[u] & bit);
+          changed &= ~bit;
+        }
+      }
+
+      if (state[u] & CHILLDUINO_TELEMETRY_BIMETAL) {
+        detector.setState(u, CHILLDUINO_TELEMETRY_BIMETAL, false);
+      }
+    }
+
+    double sampled = now();
+    detector.sample();
+    sampling += now() - sampled;
+  }
+
+  double seconds = now() - started;
+
+  for (unsigned int u = 0; u < units; u++) {
+    int32_t anomalies = seen[u] | detector.getAnomalies(u);
+    unsigned int fault = u % FAULT_PERIOD;
+
+    flagged[0] += (anomalies & CHILLDUINO_ANOMALY_COMPRESSOR_STUCK) != 0;
+    flagged[1] += (anomalies & CHILLDUINO_ANOMALY_DOOR_STUCK) != 0;
+    flagged[2] += (anomalies & CHILLDUINO_ANOMALY_DEFROST_FAILING) != 0;
+    wrong += anomalies != (fault == FAULT_WEAK_COMPRESSOR
+        ? CHILLDUINO_ANOMALY_COMPRESSOR_STUCK
+        : fault == FAULT_STUCK_DOOR ? CHILLDUINO_ANOMALY_DOOR_STUCK
+        : fault == FAULT_HEAVY_FROST ? CHILLDUINO_ANOMALY_DEFROST_FAILING
+        : 0);
+  }
+
+  double total = (double) units * samples;
+
+  printf("%-28s %9.3f ms  %6.1f M samples/s  scoring %7.1f M samples/s"
+    "  flagged %u/%u/%u  wrong %u\n", name, seconds * 1e3,
+    total / seconds / 1e6, total / sampling / 1e6,
+    flagged[0], flagged[1], flagged[2], wrong);
+
+  delete[] seen;
+}
+
+static void benchmarkFleetAnomalies(void) {
+  const unsigned int units = 1024;
+  const unsigned int samples = 3 * 24 * 60;
+  int32_t *readings = new int32_t[(unsigned long) units * samples];
+  int32_t *states = new int32_t[(unsigned long) units * samples];
+
+  double started = now();
+  recordFleetTelemetry(readings, states, units, samples);
+
+  printf("%-28s %9.3f ms  %u units  %u samples each\n",
+    "fleet telemetry, recorded", (now() - started) * 1e3, units, samples);
+
+  detectFleetAnomalies("fleet anomalies, scalar", false, readings, states,
+    units, samples);
+  detectFleetAnomalies("fleet anomalies, sse2", true, readings, states,
+    units, samples);
+
+  delete[] readings;
+  delete[] states;
+}
+
+int main(void) {
+  benchmarkDayOfTicking();
+  benchmarkDayOfSlowLoop();
+  benchmarkYearOfSteadyState();
+  benchmarkFleetOfDiscreteEvents();
+  benchmarkScenarioCampaign();
+  benchmarkColumnsOfFleetMetrics();
+  benchmarkZoneTicks<1>();
+  benchmarkZoneTicks<2>();
+  benchmarkZoneTicks<4>();
+  benchmarkZoneTicks<8>();
+  benchmarkYearOfAdaptiveDefrosts();
+  benchmarkBuildingAfterPowerCut();
+  benchmarkDayOfPredictiveCutoff();
+  benchmarkFleetAnomalies();
+
+  return 0;
+}
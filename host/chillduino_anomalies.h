@@ -0,0 +1,502 @@
+/**
+ * Copyright (c) 2015 FirstBuild
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef CHILLDUINO_ANOMALIES_H
+#define CHILLDUINO_ANOMALIES_H
+
+#include <stdint.h>
+#include <string.h>
+#include <chillduino_series.h>
+#include <host/chillduino_devices.h>
+#include <host/chillhub_frame.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/**
+ * The relay and switch states reported by a device, one bit each.
+ *
+ */
+#define CHILLDUINO_TELEMETRY_COMPRESSOR 1
+#define CHILLDUINO_TELEMETRY_DEFROST    2
+#define CHILLDUINO_TELEMETRY_DOOR       4
+#define CHILLDUINO_TELEMETRY_BIMETAL    8
+
+/**
+ * The anomalies a device can be flagged for, one bit each.
+ *
+ * A stuck compressor has run for too many samples in a row without
+ * pulling the thermistor below the cold end of the band. A stuck door
+ * has been open for too many samples in a row. Failing defrosts have
+ * timed out too many times in a row instead of reaching bimetal cutoff.
+ *
+ */
+#define CHILLDUINO_ANOMALY_COMPRESSOR_STUCK 1
+#define CHILLDUINO_ANOMALY_DOOR_STUCK       2
+#define CHILLDUINO_ANOMALY_DEFROST_FAILING  4
+
+/**
+ * Streams the telemetry of many devices into rolling statistics and
+ * flags the devices that look faulty.
+ *
+ * Frames only record the latest reading and states of their device.
+ * States that are set between samples are latched, so a bimetal cutoff
+ * that lasts a fraction of a second is still seen. Once per sample
+ * period sample() advances every device at once. Each statistic is
+ * kept in its own array of 32-bit values indexed by device, so a pass
+ * handles four devices per SSE2 instruction. The scalar pass used
+ * without SSE2 gives exactly the same results.
+ *
+ * The thermistor average is an exponentially weighted moving average
+ * stored in sixteenths of a count, with each sample weighted by 1/8,
+ * as in a ChillduinoDevice. The compressor duty cycle is a moving
+ * average in 1/65536ths, with each sample weighted by 1/64. Device
+ * indexes are those of the ChillduinoDeviceTable the frames are
+ * applied to.
+ *
+ */
+class ChillduinoAnomalyDetector {
+  private:
+    unsigned long _capacity;
+    int32_t *_columns;
+    int32_t *_readings;
+    int32_t *_states;
+    int32_t *_latches;
+    int32_t *_previousStates;
+    int32_t *_coldReadings;
+    int32_t *_averages;
+    int32_t *_duties;
+    int32_t *_compressorRuns;
+    int32_t *_lowestReadings;
+    int32_t *_doorRuns;
+    int32_t *_defrostCutoffs;
+    int32_t *_defrostTimeouts;
+    int32_t *_anomalies;
+    int32_t _compressorRunLimit;
+    int32_t _doorOpenLimit;
+    int32_t _defrostTimeoutLimit;
+    unsigned long _samples;
+    bool _isVectorized;
+
+    ChillduinoAnomalyDetector(const ChillduinoAnomalyDetector &);
+    ChillduinoAnomalyDetector &operator=(const ChillduinoAnomalyDetector &);
+
+    static const unsigned int COLUMNS = 13;
+    static const int32_t HIGHEST = 0x7FFFFFFF;
+
+    void sampleScalar(unsigned long start) {
+      for (unsigned long i = start; i < _capacity; i++) {
+        int32_t reading = _readings[i];
+        int32_t states = _states[i];
+        int32_t previous = _previousStates[i];
+        int32_t seen = states | _latches[i];
+        int32_t compressor = states & CHILLDUINO_TELEMETRY_COMPRESSOR;
+        int32_t isCompressor = -compressor;
+        int32_t isDoor = -((states & CHILLDUINO_TELEMETRY_DOOR) >> 2);
+        int32_t isDefrost = -((states & CHILLDUINO_TELEMETRY_DEFROST) >> 1);
+        int32_t wasDefrost =
+          -((previous & CHILLDUINO_TELEMETRY_DEFROST) >> 1);
+        int32_t isBimetal = -((seen & CHILLDUINO_TELEMETRY_BIMETAL) >> 3);
+        int32_t isEnded = wasDefrost & ~isDefrost;
+
+        _latches[i] = 0;
+        _previousStates[i] = states;
+
+        _averages[i] += ((reading << 4) - _averages[i]) >> 3;
+        _duties[i] += ((compressor << 16) - _duties[i]) >> 6;
+
+        int32_t lowest = _lowestReadings[i];
+        lowest = (reading < lowest) ? reading : lowest;
+        _lowestReadings[i] = (lowest & isCompressor)
+          | (HIGHEST & ~isCompressor);
+        _compressorRuns[i] = (_compressorRuns[i] + 1) & isCompressor;
+        _doorRuns[i] = (_doorRuns[i] + 1) & isDoor;
+
+        int32_t cutoff = _defrostCutoffs[i]
+          | (isBimetal & (isDefrost | wasDefrost));
+        int32_t timeouts = (_defrostTimeouts[i] + 1) & ~cutoff;
+        _defrostTimeouts[i] = (timeouts & isEnded)
+          | (_defrostTimeouts[i] & ~isEnded);
+        _defrostCutoffs[i] = cutoff & ~isEnded;
+
+        _anomalies[i] = (_compressorRuns[i] >= _compressorRunLimit
+            && _lowestReadings[i] >= _coldReadings[i]
+            ? CHILLDUINO_ANOMALY_COMPRESSOR_STUCK : 0)
+          | (_doorRuns[i] >= _doorOpenLimit
+            ? CHILLDUINO_ANOMALY_DOOR_STUCK : 0)
+          | (_defrostTimeouts[i] >= _defrostTimeoutLimit
+            ? CHILLDUINO_ANOMALY_DEFROST_FAILING : 0);
+      }
+    }
+
+#ifdef __SSE2__
+    static __m128i isSet(__m128i states, int32_t state) {
+      __m128i mask = _mm_set1_epi32(state);
+      return _mm_cmpeq_epi32(_mm_and_si128(states, mask), mask);
+    }
+
+    static __m128i select(__m128i mask, __m128i a, __m128i b) {
+      return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+    }
+
+    static __m128i load(const int32_t *column, unsigned long i) {
+      return _mm_loadu_si128((const __m128i *) (column + i));
+    }
+
+    static void store(int32_t *column, unsigned long i, __m128i value) {
+      _mm_storeu_si128((__m128i *) (column + i), value);
+    }
+
+    unsigned long sampleVector(void) {
+      const __m128i one = _mm_set1_epi32(1);
+      const __m128i highest = _mm_set1_epi32(HIGHEST);
+      const __m128i compressorRunLimit = _mm_set1_epi32(_compressorRunLimit);
+      const __m128i doorOpenLimit = _mm_set1_epi32(_doorOpenLimit);
+      const __m128i defrostTimeoutLimit = _mm_set1_epi32(_defrostTimeoutLimit);
+      const __m128i compressorStuck =
+        _mm_set1_epi32(CHILLDUINO_ANOMALY_COMPRESSOR_STUCK);
+      const __m128i doorStuck = _mm_set1_epi32(CHILLDUINO_ANOMALY_DOOR_STUCK);
+      const __m128i defrostFailing =
+        _mm_set1_epi32(CHILLDUINO_ANOMALY_DEFROST_FAILING);
+      unsigned long i = 0;
+
+      for (; i + 4 <= _capacity; i += 4) {
+        __m128i reading = load(_readings, i);
+        __m128i states = load(_states, i);
+        __m128i previous = load(_previousStates, i);
+        __m128i seen = _mm_or_si128(states, load(_latches, i));
+        __m128i isCompressor = isSet(states, CHILLDUINO_TELEMETRY_COMPRESSOR);
+        __m128i isDoor = isSet(states, CHILLDUINO_TELEMETRY_DOOR);
+        __m128i isDefrost = isSet(states, CHILLDUINO_TELEMETRY_DEFROST);
+        __m128i wasDefrost = isSet(previous, CHILLDUINO_TELEMETRY_DEFROST);
+        __m128i isBimetal = isSet(seen, CHILLDUINO_TELEMETRY_BIMETAL);
+        __m128i isEnded = _mm_andnot_si128(isDefrost, wasDefrost);
+
+        store(_latches, i, _mm_setzero_si128());
+        store(_previousStates, i, states);
+
+        __m128i average = load(_averages, i);
+        average = _mm_add_epi32(average, _mm_srai_epi32(
+          _mm_sub_epi32(_mm_slli_epi32(reading, 4), average), 3));
+        store(_averages, i, average);
+
+        __m128i duty = load(_duties, i);
+        duty = _mm_add_epi32(duty, _mm_srai_epi32(_mm_sub_epi32(
+          _mm_slli_epi32(_mm_and_si128(isCompressor, one), 16), duty), 6));
+        store(_duties, i, duty);
+
+        __m128i lowest = load(_lowestReadings, i);
+        lowest = select(_mm_cmplt_epi32(reading, lowest), reading, lowest);
+        lowest = select(isCompressor, lowest, highest);
+        store(_lowestReadings, i, lowest);
+
+        __m128i compressorRun = _mm_and_si128(
+          _mm_add_epi32(load(_compressorRuns, i), one), isCompressor);
+        store(_compressorRuns, i, compressorRun);
+
+        __m128i doorRun = _mm_and_si128(
+          _mm_add_epi32(load(_doorRuns, i), one), isDoor);
+        store(_doorRuns, i, doorRun);
+
+        __m128i cutoff = _mm_or_si128(load(_defrostCutoffs, i),
+          _mm_and_si128(isBimetal, _mm_or_si128(isDefrost, wasDefrost)));
+        __m128i timeouts = load(_defrostTimeouts, i);
+        timeouts = select(isEnded, _mm_andnot_si128(cutoff,
+          _mm_add_epi32(timeouts, one)), timeouts);
+        store(_defrostTimeouts, i, timeouts);
+        store(_defrostCutoffs, i, _mm_andnot_si128(isEnded, cutoff));
+
+        __m128i anomalies = _mm_andnot_si128(
+          _mm_cmplt_epi32(lowest, load(_coldReadings, i)),
+          _mm_andnot_si128(_mm_cmplt_epi32(compressorRun, compressorRunLimit),
+            compressorStuck));
+        anomalies = _mm_or_si128(anomalies, _mm_andnot_si128(
+          _mm_cmplt_epi32(doorRun, doorOpenLimit), doorStuck));
+        anomalies = _mm_or_si128(anomalies, _mm_andnot_si128(
+          _mm_cmplt_epi32(timeouts, defrostTimeoutLimit), defrostFailing));
+        store(_anomalies, i, anomalies);
+      }
+
+      return i;
+    }
+#endif
+
+  public:
+
+    /**
+     * Creates a detector for the given number of devices, all with the
+     * same cold end of the band.
+     *
+     * Every limit starts out so high that nothing is flagged.
+     *
+     */
+    ChillduinoAnomalyDetector(unsigned long capacity, int coldReading) :
+      _capacity(capacity),
+      _columns(new int32_t[COLUMNS * capacity]),
+      _readings(_columns),
+      _states(_readings + capacity),
+      _latches(_states + capacity),
+      _previousStates(_latches + capacity),
+      _coldReadings(_previousStates + capacity),
+      _averages(_coldReadings + capacity),
+      _duties(_averages + capacity),
+      _compressorRuns(_duties + capacity),
+      _lowestReadings(_compressorRuns + capacity),
+      _doorRuns(_lowestReadings + capacity),
+      _defrostCutoffs(_doorRuns + capacity),
+      _defrostTimeouts(_defrostCutoffs + capacity),
+      _anomalies(_defrostTimeouts + capacity),
+      _compressorRunLimit(HIGHEST),
+      _doorOpenLimit(HIGHEST),
+      _defrostTimeoutLimit(HIGHEST),
+      _samples(0),
+#ifdef __SSE2__
+      _isVectorized(true) {
+#else
+      _isVectorized(false) {
+#endif
+      memset(_columns, 0, COLUMNS * capacity * sizeof(int32_t));
+
+      for (unsigned long i = 0; i < capacity; i++) {
+        _coldReadings[i] = coldReading;
+        _lowestReadings[i] = HIGHEST;
+      }
+    }
+
+    ~ChillduinoAnomalyDetector(void) {
+      delete[] _columns;
+    }
+
+    /**
+     * Sets the samples in a row a compressor may run without pulling
+     * the thermistor below the cold end of the band.
+     *
+     */
+    ChillduinoAnomalyDetector& setCompressorRunLimit(int32_t samples) {
+      _compressorRunLimit = samples;
+      return *this;
+    }
+
+    /**
+     * Sets the samples in a row a door may be open.
+     *
+     */
+    ChillduinoAnomalyDetector& setDoorOpenLimit(int32_t samples) {
+      _doorOpenLimit = samples;
+      return *this;
+    }
+
+    /**
+     * Sets the defrosts in a row that may time out.
+     *
+     */
+    ChillduinoAnomalyDetector& setDefrostTimeoutLimit(int32_t defrosts) {
+      _defrostTimeoutLimit = defrosts;
+      return *this;
+    }
+
+    /**
+     * Sets the reading below which a device is colder than its band.
+     *
+     */
+    ChillduinoAnomalyDetector& setColdReading(unsigned long device,
+        int reading) {
+      _coldReadings[device] = reading;
+      return *this;
+    }
+
+    /**
+     * Selects the SSE2 pass or the scalar one.
+     *
+     * Both give the same results. Without SSE2 the scalar pass is
+     * always used.
+     *
+     */
+    ChillduinoAnomalyDetector& setVectorized(bool isVectorized) {
+#ifdef __SSE2__
+      _isVectorized = isVectorized;
+#else
+      (void) isVectorized;
+#endif
+      return *this;
+    }
+
+    /**
+     * Records the latest thermistor reading of a device.
+     *
+     * The first reading also starts the thermistor average.
+     *
+     */
+    void setReading(unsigned long device, int reading) {
+      if (_averages[device] == 0) {
+        _averages[device] = reading << 4;
+      }
+
+      _readings[device] = reading;
+    }
+
+    /**
+     * Records the latest value of one of the states of a device.
+     *
+     */
+    void setState(unsigned long device, int32_t state, bool isSet) {
+      if (isSet) {
+        _states[device] |= state;
+        _latches[device] |= state;
+      }
+      else {
+        _states[device] &= ~state;
+      }
+    }
+
+    /**
+     * Applies a frame received from the device at the index.
+     *
+     */
+    void update(long device, const ChillhubFrame &frame) {
+      unsigned int value = chillhubReadU16(frame);
+
+      switch (frame.type) {
+        case CHILLDUINO_THERMISTOR_ID:
+          setReading(device, value);
+          break;
+
+        case CHILLDUINO_COMPRESSOR_ID:
+          setState(device, CHILLDUINO_TELEMETRY_COMPRESSOR, value);
+          break;
+
+        case CHILLDUINO_DEFROST_ID:
+          setState(device, CHILLDUINO_TELEMETRY_DEFROST, value);
+          break;
+
+        case CHILLDUINO_DOOR_ID:
+          setState(device, CHILLDUINO_TELEMETRY_DOOR, value);
+          break;
+
+        case CHILLDUINO_BIMETAL_ID:
+          setState(device, CHILLDUINO_TELEMETRY_BIMETAL, value);
+          break;
+
+        case CHILLDUINO_SERIES_ID:
+          // only the latest reading of the series is sampled
+          if (frame.dataType == CHILLHUB_ARRAY_DATA_TYPE && frame.length >= 2) {
+            ChillduinoSeriesDecoder decoder(frame.payload + 2,
+              frame.length - 2);
+            int sample;
+
+            while (decoder.next(sample)) {
+              setReading(device, sample);
+            }
+          }
+          break;
+
+        default:
+          break;
+      }
+    }
+
+    /**
+     * Advances the statistics of every device by one sample and
+     * flags the devices that look faulty.
+     *
+     */
+    void sample(void) {
+      unsigned long start = 0;
+
+#ifdef __SSE2__
+      if (_isVectorized) {
+        start = sampleVector();
+      }
+#endif
+
+      sampleScalar(start);
+      _samples++;
+    }
+
+    /**
+     * Gets the number of devices.
+     *
+     */
+    unsigned long getCapacity(void) const {
+      return _capacity;
+    }
+
+    /**
+     * Gets the number of samples taken.
+     *
+     */
+    unsigned long getSamples(void) const {
+      return _samples;
+    }
+
+    /**
+     * Gets the anomalies a device is flagged for.
+     *
+     */
+    int32_t getAnomalies(unsigned long device) const {
+      return _anomalies[device];
+    }
+
+    /**
+     * Gets the thermistor average of a device, in sixteenths of a count.
+     *
+     */
+    int32_t getThermistorAverage(unsigned long device) const {
+      return _averages[device];
+    }
+
+    /**
+     * Gets the compressor duty cycle of a device, in 1/65536ths.
+     *
+     */
+    int32_t getCompressorDutyCycle(unsigned long device) const {
+      return _duties[device];
+    }
+
+    /**
+     * Gets the samples in a row the compressor of a device has run.
+     *
+     */
+    int32_t getCompressorRunSamples(unsigned long device) const {
+      return _compressorRuns[device];
+    }
+
+    /**
+     * Gets the samples in a row the door of a device has been open.
+     *
+     */
+    int32_t getDoorOpenSamples(unsigned long device) const {
+      return _doorRuns[device];
+    }
+
+    /**
+     * Gets the defrosts in a row of a device that timed out.
+     *
+     */
+    int32_t getDefrostTimeouts(unsigned long device) const {
+      return _defrostTimeouts[device];
+    }
+};
+
+#endif /* CHILLDUINO_ANOMALIES_H */
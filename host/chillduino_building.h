@@ -0,0 +1,223 @@
+/**
+ * Copyright (c) 2015 FirstBuild
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef CHILLDUINO_BUILDING_H
+#define CHILLDUINO_BUILDING_H
+
+#include <chillduino.h>
+#include <host/chillduino_simulator.h>
+
+/**
+ * Simulates the units of a building on a shared clock.
+ *
+ * Each unit is a ChillduinoSimulator controlling its own plant. Every
+ * step the units elapse in turn, then the building samples how many
+ * compressors are running, how many started during the step and how
+ * far each unit is above its band. Within a step each unit still jumps
+ * from event to event, so the step only sets the resolution of the
+ * samples. A step of one second resolves the compressor inrush, which
+ * lasts well under a second.
+ *
+ */
+class ChillduinoBuilding {
+  private:
+    ChillduinoSimulator **_units;
+    unsigned int _capacity;
+    unsigned int _count;
+    unsigned long _step;
+    unsigned long _time;
+    unsigned long _runningCompressors;
+    unsigned long _peakRunningCompressors;
+    unsigned long _peakCompressorStarts;
+    unsigned long _overshoot;
+    int _peakOvershoot;
+
+    ChillduinoBuilding(const ChillduinoBuilding &);
+    ChillduinoBuilding &operator=(const ChillduinoBuilding &);
+
+    void sample(unsigned long starts) {
+      _runningCompressors = 0;
+
+      for (unsigned int i = 0; i < _count; i++) {
+        Chillduino &chillduino = _units[i]->getChillduino();
+        int overshoot = chillduino.getFreshFoodTemperature()
+          - chillduino.getMaximumFreshFoodTemperature();
+
+        if (chillduino.isCompressorRunning()) {
+          _runningCompressors++;
+        }
+
+        if (overshoot > 0) {
+          _overshoot += overshoot;
+        }
+
+        if (overshoot > _peakOvershoot) {
+          _peakOvershoot = overshoot;
+        }
+      }
+
+      if (_runningCompressors > _peakRunningCompressors) {
+        _peakRunningCompressors = _runningCompressors;
+      }
+
+      if (starts > _peakCompressorStarts) {
+        _peakCompressorStarts = starts;
+      }
+    }
+
+  public:
+
+    /**
+     * Creates an empty building able to hold the given number of units,
+     * sampled once per step (in ticks).
+     *
+     */
+    ChillduinoBuilding(unsigned int capacity, unsigned long step) :
+      _units(new ChillduinoSimulator *[capacity]),
+      _capacity(capacity),
+      _count(0),
+      _step(step),
+      _time(0),
+      _runningCompressors(0),
+      _peakRunningCompressors(0),
+      _peakCompressorStarts(0),
+      _overshoot(0),
+      _peakOvershoot(0) { }
+
+    ~ChillduinoBuilding(void) {
+      for (unsigned int i = 0; i < _count; i++) {
+        delete _units[i];
+      }
+
+      delete[] _units;
+    }
+
+    /**
+     * Adds a unit controlling its plant.
+     *
+     * Returns false if the building is full.
+     *
+     */
+    bool add(const Chillduino &chillduino, const ChillduinoPlant &plant) {
+      if (_count == _capacity) {
+        return false;
+      }
+
+      _units[_count++] = new ChillduinoSimulator(chillduino, plant);
+      return true;
+    }
+
+    /**
+     * Gets the simulation of a unit.
+     *
+     */
+    ChillduinoSimulator &getUnit(unsigned int index) {
+      return *_units[index];
+    }
+
+    /**
+     * Starts or ends a grid shed in every unit.
+     *
+     */
+    void setShedding(bool isShedding) {
+      for (unsigned int i = 0; i < _count; i++) {
+        _units[i]->getChillduino().setShedding(isShedding);
+      }
+    }
+
+    /**
+     * Gets the current time (in ticks).
+     *
+     */
+    unsigned long getTime(void) const {
+      return _time;
+    }
+
+    /**
+     * Gets the number of compressors running at the last sample.
+     *
+     */
+    unsigned long getRunningCompressors(void) const {
+      return _runningCompressors;
+    }
+
+    /**
+     * Gets the largest number of compressors running at one sample.
+     *
+     */
+    unsigned long getPeakRunningCompressors(void) const {
+      return _peakRunningCompressors;
+    }
+
+    /**
+     * Gets the largest number of compressors that started within one
+     * step.
+     *
+     */
+    unsigned long getPeakCompressorStarts(void) const {
+      return _peakCompressorStarts;
+    }
+
+    /**
+     * Gets how far (in tenths of a degree) the units were above their
+     * bands, summed over every unit and sample.
+     *
+     */
+    unsigned long getOvershoot(void) const {
+      return _overshoot;
+    }
+
+    /**
+     * Gets how far (in tenths of a degree) any unit was above its band
+     * at any sample.
+     *
+     */
+    int getPeakOvershoot(void) const {
+      return _peakOvershoot;
+    }
+
+    /**
+     * Causes the amount of time (in ticks) to elapse for every unit,
+     * rounded up to whole steps.
+     *
+     */
+    void elapse(unsigned long ticks) {
+      unsigned long end = _time + ticks;
+
+      while (_time < end) {
+        unsigned long starts = 0;
+
+        for (unsigned int i = 0; i < _count; i++) {
+          unsigned long before = _units[i]->getTotals().compressorStarts;
+
+          _units[i]->elapse(_step);
+          starts += _units[i]->getTotals().compressorStarts - before;
+        }
+
+        _time += _step;
+        sample(starts);
+      }
+    }
+};
+
+#endif /* CHILLDUINO_BUILDING_H */
@@ -0,0 +1,816 @@
+/**
+ * Copyright (c) 2015 FirstBuild
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef CHILLDUINO_COLUMNS_H
+#define CHILLDUINO_COLUMNS_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * The bytes that start every column file.
+ *
+ */
+#define CHILLDUINO_COLUMNS_MAGIC "CHCL"
+
+/**
+ * The version of the column file layout.
+ *
+ */
+#define CHILLDUINO_COLUMNS_VERSION 1
+
+/**
+ * The number of bytes reserved for each column name, including the
+ * terminating zero.
+ *
+ */
+#define CHILLDUINO_COLUMNS_NAME_SIZE 24
+
+/**
+ * The column block encodings.
+ *
+ * A raw block is an array of 32-bit values. A run length block is an
+ * array of 32-bit value and count pairs. A delta block holds the
+ * zigzag encoded difference from the previous value as 7-bit groups,
+ * starting from zero, as in a ChillduinoSeries. A packed block holds a
+ * 32-bit base and bit width followed by 64-bit words, holding the
+ * difference of every value from the base in that many bits, lowest
+ * bits first, so a boolean costs a single bit.
+ *
+ */
+#define CHILLDUINO_COLUMNS_RAW    0
+#define CHILLDUINO_COLUMNS_RLE    1
+#define CHILLDUINO_COLUMNS_DELTA  2
+#define CHILLDUINO_COLUMNS_PACKED 3
+
+/**
+ * The file header, followed by the column names and then the chunks.
+ *
+ * Each chunk starts with a ChillduinoColumnsChunk, followed by one
+ * ChillduinoColumnsBlock per column and then the blocks themselves.
+ * Chunks and blocks start on 8-byte boundaries so that a mapped raw
+ * block can be read in place. Values are in host byte order.
+ *
+ */
+struct ChillduinoColumnsHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t columns;
+  uint32_t rowsPerChunk;
+};
+
+struct ChillduinoColumnsChunk {
+  uint32_t size;
+  uint32_t rows;
+};
+
+struct ChillduinoColumnsBlock {
+  uint32_t encoding;
+  uint32_t offset;
+  uint32_t length;
+  uint32_t reserved;
+};
+
+inline uint32_t chillduinoColumnsAlign(uint32_t length) {
+  return (length + 7) & ~(uint32_t) 7;
+}
+
+inline uint32_t chillduinoColumnsPackedLength(uint32_t rows, uint32_t width) {
+  return 2 * sizeof(uint32_t)
+    + (uint32_t) (((uint64_t) rows * width + 63) / 64) * sizeof(uint64_t);
+}
+
+/**
+ * Writes rows of 32-bit values to a column file.
+ *
+ * Rows are gathered into column major chunks in one of two buffers.
+ * When a buffer fills it is handed to a background thread, which picks
+ * the smallest encoding for every column and writes the chunk, while
+ * rows go on being appended to the other buffer. Appending only waits
+ * if the background thread is still writing the previous chunk.
+ *
+ */
+class ChillduinoColumnWriter {
+  private:
+    int _fd;
+    uint32_t _columns;
+    uint32_t _rowsPerChunk;
+    uint32_t *_buffers[2];
+    uint32_t _rows[2];
+    unsigned char *_chunk;
+    unsigned int _current;
+    int _pending;
+    bool _isStarted;
+    bool _isClosing;
+    bool _isFailed;
+    unsigned long _bytes;
+    pthread_t _thread;
+    mutable pthread_mutex_t _mutex;
+    pthread_cond_t _condition;
+
+    ChillduinoColumnWriter(const ChillduinoColumnWriter &);
+    ChillduinoColumnWriter &operator=(const ChillduinoColumnWriter &);
+
+    static uint32_t encodeRuns(const uint32_t *values, uint32_t rows,
+        unsigned char *block) {
+      uint32_t *runs = (uint32_t *) block;
+      uint32_t length = 0;
+
+      for (uint32_t i = 0; i < rows; ) {
+        uint32_t start = i;
+
+        while (i < rows && values[i] == values[start]) {
+          i++;
+        }
+
+        runs[length++] = values[start];
+        runs[length++] = i - start;
+      }
+
+      return length * sizeof(uint32_t);
+    }
+
+    static uint32_t encodeDeltas(const uint32_t *values, uint32_t rows,
+        unsigned char *block) {
+      uint32_t previous = 0;
+      uint32_t length = 0;
+
+      for (uint32_t i = 0; i < rows; i++) {
+        int32_t delta = (int32_t) (values[i] - previous);
+        uint32_t value = (delta < 0)
+          ? (((uint32_t) -(delta + 1)) << 1) | 1
+          : ((uint32_t) delta) << 1;
+
+        while (value >= 0x80) {
+          block[length++] = (unsigned char) (value | 0x80);
+          value >>= 7;
+        }
+
+        block[length++] = (unsigned char) value;
+        previous = values[i];
+      }
+
+      return length;
+    }
+
+    static uint32_t encodePacked(const uint32_t *values, uint32_t rows,
+        uint32_t base, uint32_t width, unsigned char *block) {
+      uint32_t *header = (uint32_t *) block;
+      uint64_t *words = (uint64_t *) (header + 2);
+      uint32_t length = chillduinoColumnsPackedLength(rows, width);
+
+      header[0] = base;
+      header[1] = width;
+      memset(words, 0, length - 2 * sizeof(uint32_t));
+
+      for (uint32_t i = 0; width > 0 && i < rows; i++) {
+        uint64_t bit = (uint64_t) i * width;
+        uint64_t value = values[i] - base;
+        unsigned int offset = bit & 63;
+
+        words[bit >> 6] |= value << offset;
+
+        if (offset + width > 64) {
+          words[(bit >> 6) + 1] |= value >> (64 - offset);
+        }
+      }
+
+      return length;
+    }
+
+    static uint32_t countRuns(const uint32_t *values, uint32_t rows) {
+      uint32_t runs = (rows > 0) ? 1 : 0;
+
+      for (uint32_t i = 1; i < rows; i++) {
+        runs += values[i] != values[i - 1];
+      }
+
+      return runs;
+    }
+
+    uint32_t encode(const uint32_t *values, uint32_t rows,
+        ChillduinoColumnsBlock &block, unsigned char *data) {
+      uint32_t minimum = (rows > 0) ? values[0] : 0;
+      uint32_t maximum = minimum;
+      uint32_t width = 0;
+
+      for (uint32_t i = 1; i < rows; i++) {
+        minimum = (values[i] < minimum) ? values[i] : minimum;
+        maximum = (values[i] > maximum) ? values[i] : maximum;
+      }
+
+      while (width < 32 && ((maximum - minimum) >> width) != 0) {
+        width++;
+      }
+
+      uint32_t raw = rows * sizeof(uint32_t);
+      uint32_t runs = countRuns(values, rows) * 2 * sizeof(uint32_t);
+      uint32_t packed = chillduinoColumnsPackedLength(rows, width);
+      uint32_t deltas = encodeDeltas(values, rows, data);
+
+      if (runs <= packed && runs <= deltas && runs <= raw) {
+        block.encoding = CHILLDUINO_COLUMNS_RLE;
+        return encodeRuns(values, rows, data);
+      }
+
+      if (packed <= deltas && packed <= raw) {
+        block.encoding = CHILLDUINO_COLUMNS_PACKED;
+        return encodePacked(values, rows, minimum, width, data);
+      }
+
+      if (deltas < raw) {
+        block.encoding = CHILLDUINO_COLUMNS_DELTA;
+        return deltas;
+      }
+
+      block.encoding = CHILLDUINO_COLUMNS_RAW;
+      memcpy(data, values, raw);
+      return raw;
+    }
+
+    bool writeChunk(unsigned int buffer, unsigned long &bytes) {
+      const uint32_t *values = _buffers[buffer];
+      uint32_t rows = _rows[buffer];
+      ChillduinoColumnsChunk *chunk = (ChillduinoColumnsChunk *) _chunk;
+      ChillduinoColumnsBlock *blocks = (ChillduinoColumnsBlock *) (chunk + 1);
+      uint32_t offset = sizeof(ChillduinoColumnsChunk)
+        + _columns * sizeof(ChillduinoColumnsBlock);
+
+      for (uint32_t c = 0; c < _columns; c++) {
+        blocks[c].offset = offset;
+        blocks[c].reserved = 0;
+        blocks[c].length = encode(values + c * _rowsPerChunk, rows,
+          blocks[c], _chunk + offset);
+        memset(_chunk + offset + blocks[c].length, 0,
+          chillduinoColumnsAlign(blocks[c].length) - blocks[c].length);
+        offset += chillduinoColumnsAlign(blocks[c].length);
+      }
+
+      chunk->size = offset;
+      chunk->rows = rows;
+
+      return writeAll(_chunk, offset, bytes);
+    }
+
+    bool writeAll(const void *data, unsigned long length,
+        unsigned long &total) {
+      const unsigned char *bytes = (const unsigned char *) data;
+
+      while (length > 0) {
+        ssize_t written = write(_fd, bytes, length);
+
+        if (written <= 0) {
+          return false;
+        }
+
+        bytes += written;
+        length -= written;
+        total += written;
+      }
+
+      return true;
+    }
+
+    static void *run(void *argument) {
+      ChillduinoColumnWriter &writer = *(ChillduinoColumnWriter *) argument;
+
+      pthread_mutex_lock(&writer._mutex);
+
+      for (;;) {
+        while (writer._pending < 0 && !writer._isClosing) {
+          pthread_cond_wait(&writer._condition, &writer._mutex);
+        }
+
+        if (writer._pending < 0) {
+          break;
+        }
+
+        unsigned int buffer = writer._pending;
+        unsigned long bytes = 0;
+        pthread_mutex_unlock(&writer._mutex);
+        bool isWritten = writer.writeChunk(buffer, bytes);
+        pthread_mutex_lock(&writer._mutex);
+
+        // the counts are only changed under the lock, so they can be
+        // read while the next chunk is being written
+        writer._bytes += bytes;
+        writer._isFailed = writer._isFailed || !isWritten;
+        writer._pending = -1;
+        pthread_cond_broadcast(&writer._condition);
+      }
+
+      pthread_mutex_unlock(&writer._mutex);
+      return 0;
+    }
+
+    void submit(void) {
+      pthread_mutex_lock(&_mutex);
+
+      while (_pending >= 0) {
+        pthread_cond_wait(&_condition, &_mutex);
+      }
+
+      _pending = _current;
+      pthread_cond_broadcast(&_condition);
+      pthread_mutex_unlock(&_mutex);
+
+      _current ^= 1;
+      _rows[_current] = 0;
+    }
+
+  public:
+
+    /**
+     * Starts a column file on the open file descriptor.
+     *
+     * The names must be shorter than CHILLDUINO_COLUMNS_NAME_SIZE. The
+     * file descriptor is not closed by the writer.
+     *
+     */
+    ChillduinoColumnWriter(int fd, const char *const *names,
+        uint32_t columns, uint32_t rowsPerChunk) :
+      _fd(fd),
+      _columns(columns),
+      _rowsPerChunk(rowsPerChunk),
+      _buffers(),
+      _rows(),
+      _chunk(0),
+      _current(0),
+      _pending(-1),
+      _isStarted(false),
+      _isClosing(false),
+      _isFailed(false),
+      _bytes(0),
+      _thread(),
+      _mutex(),
+      _condition() {
+      ChillduinoColumnsHeader header;
+      char name[CHILLDUINO_COLUMNS_NAME_SIZE];
+
+      _buffers[0] = new uint32_t[columns * rowsPerChunk];
+      _buffers[1] = new uint32_t[columns * rowsPerChunk];
+      _chunk = new unsigned char[sizeof(ChillduinoColumnsChunk)
+        + columns * (sizeof(ChillduinoColumnsBlock)
+          + chillduinoColumnsAlign(5 * rowsPerChunk + 16))];
+
+      memcpy(header.magic, CHILLDUINO_COLUMNS_MAGIC, sizeof(header.magic));
+      header.version = CHILLDUINO_COLUMNS_VERSION;
+      header.columns = columns;
+      header.rowsPerChunk = rowsPerChunk;
+      _isFailed = !writeAll(&header, sizeof(header), _bytes);
+
+      for (uint32_t c = 0; c < columns; c++) {
+        memset(name, 0, sizeof(name));
+        strncpy(name, names[c], sizeof(name) - 1);
+        _isFailed = _isFailed || !writeAll(name, sizeof(name), _bytes);
+      }
+
+      pthread_mutex_init(&_mutex, 0);
+      pthread_cond_init(&_condition, 0);
+      _isStarted = pthread_create(&_thread, 0, run, this) == 0;
+      _isFailed = _isFailed || !_isStarted;
+    }
+
+    ~ChillduinoColumnWriter(void) {
+      close();
+      pthread_cond_destroy(&_condition);
+      pthread_mutex_destroy(&_mutex);
+      delete[] _buffers[0];
+      delete[] _buffers[1];
+      delete[] _chunk;
+    }
+
+    /**
+     * Appends a row holding one value for every column.
+     *
+     */
+    void append(const uint32_t *row) {
+      uint32_t *values = _buffers[_current] + _rows[_current];
+
+      for (uint32_t c = 0; c < _columns; c++) {
+        values[c * _rowsPerChunk] = row[c];
+      }
+
+      if (++_rows[_current] == _rowsPerChunk) {
+        submit();
+      }
+    }
+
+    /**
+     * Writes any remaining rows and waits for the background thread.
+     *
+     * Returns false if anything could not be written.
+     *
+     */
+    bool close(void) {
+      if (!_isStarted) {
+        return !_isFailed;
+      }
+
+      if (_rows[_current] > 0) {
+        submit();
+      }
+
+      pthread_mutex_lock(&_mutex);
+      _isClosing = true;
+      pthread_cond_broadcast(&_condition);
+      pthread_mutex_unlock(&_mutex);
+
+      pthread_join(_thread, 0);
+      _isStarted = false;
+      return !_isFailed;
+    }
+
+    /**
+     * Gets the number of bytes written so far, which lags the rows
+     * appended until close() returns.
+     *
+     */
+    unsigned long getBytes(void) const {
+      unsigned long bytes;
+
+      if (!_isStarted) {
+        return _bytes;
+      }
+
+      pthread_mutex_lock(&_mutex);
+      bytes = _bytes;
+      pthread_mutex_unlock(&_mutex);
+
+      return bytes;
+    }
+};
+
+/**
+ * Reads a column file by mapping it into memory.
+ *
+ * Opening only walks the chunk headers. Raw blocks can be used in
+ * place, and the other encodings are decoded one chunk of one column
+ * at a time, so a scan touches only the columns it asks for.
+ *
+ */
+class ChillduinoColumnReader {
+  private:
+    const unsigned char *_data;
+    unsigned long _size;
+    const ChillduinoColumnsHeader *_header;
+    const unsigned char **_chunks;
+    unsigned long _chunkCount;
+    unsigned long _rows;
+
+    ChillduinoColumnReader(const ChillduinoColumnReader &);
+    ChillduinoColumnReader &operator=(const ChillduinoColumnReader &);
+
+    const ChillduinoColumnsChunk &getChunk(unsigned long chunk) const {
+      return *(const ChillduinoColumnsChunk *) _chunks[chunk];
+    }
+
+    const ChillduinoColumnsBlock &getBlock(unsigned long chunk,
+        uint32_t column) const {
+      return ((const ChillduinoColumnsBlock *) (&getChunk(chunk) + 1))[column];
+    }
+
+    const unsigned char *getBlockData(unsigned long chunk,
+        uint32_t column) const {
+      return _chunks[chunk] + getBlock(chunk, column).offset;
+    }
+
+    bool isValidChunk(unsigned long offset) const {
+      unsigned long blocks = sizeof(ChillduinoColumnsChunk)
+        + _header->columns * sizeof(ChillduinoColumnsBlock);
+
+      if (offset + blocks > _size) {
+        return false;
+      }
+
+      const ChillduinoColumnsChunk *chunk =
+        (const ChillduinoColumnsChunk *) (_data + offset);
+      const ChillduinoColumnsBlock *block =
+        (const ChillduinoColumnsBlock *) (chunk + 1);
+
+      if (chunk->size < blocks || offset + chunk->size > _size ||
+          chunk->size % 8 != 0 || chunk->rows > _header->rowsPerChunk) {
+        return false;
+      }
+
+      for (uint32_t c = 0; c < _header->columns; c++) {
+        if (block[c].offset < blocks || block[c].offset % 8 != 0 ||
+            block[c].length > chunk->size - block[c].offset ||
+            block[c].encoding > CHILLDUINO_COLUMNS_PACKED ||
+            (block[c].encoding == CHILLDUINO_COLUMNS_RAW &&
+              block[c].length != chunk->rows * sizeof(uint32_t)) ||
+            (block[c].encoding == CHILLDUINO_COLUMNS_RLE &&
+              block[c].length % (2 * sizeof(uint32_t)) != 0)) {
+          return false;
+        }
+
+        if (block[c].encoding == CHILLDUINO_COLUMNS_PACKED) {
+          const uint32_t *header =
+            (const uint32_t *) ((const unsigned char *) chunk + block[c].offset);
+
+          if (block[c].length < 2 * sizeof(uint32_t) || header[1] > 32 ||
+              block[c].length !=
+                chillduinoColumnsPackedLength(chunk->rows, header[1])) {
+            return false;
+          }
+        }
+      }
+
+      return true;
+    }
+
+    bool map(int fd) {
+      struct stat status;
+
+      if (fstat(fd, &status) != 0 ||
+          (unsigned long) status.st_size < sizeof(ChillduinoColumnsHeader)) {
+        return false;
+      }
+
+      void *data = mmap(0, status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+      if (data == MAP_FAILED) {
+        return false;
+      }
+
+      _data = (const unsigned char *) data;
+      _size = status.st_size;
+      _header = (const ChillduinoColumnsHeader *) _data;
+
+      if (memcmp(_header->magic, CHILLDUINO_COLUMNS_MAGIC, 4) != 0 ||
+          _header->version != CHILLDUINO_COLUMNS_VERSION ||
+          _header->columns == 0 ||
+          sizeof(ChillduinoColumnsHeader) + (unsigned long) _header->columns
+            * CHILLDUINO_COLUMNS_NAME_SIZE > _size) {
+        return false;
+      }
+
+      unsigned long first = chillduinoColumnsAlign(
+        sizeof(ChillduinoColumnsHeader)
+        + _header->columns * CHILLDUINO_COLUMNS_NAME_SIZE);
+      unsigned long offset;
+
+      for (offset = first; offset < _size && isValidChunk(offset);
+          offset += ((const ChillduinoColumnsChunk *) (_data + offset))->size) {
+        _chunkCount++;
+      }
+
+      if (offset != _size) {
+        return false;
+      }
+
+      _chunks = new const unsigned char *[_chunkCount + 1];
+      _chunkCount = 0;
+
+      for (offset = first; offset < _size;
+          offset += getChunk(_chunkCount++).size) {
+        _chunks[_chunkCount] = _data + offset;
+        _rows += ((const ChillduinoColumnsChunk *) (_data + offset))->rows;
+      }
+
+      return true;
+    }
+
+  public:
+
+    /**
+     * Maps the column file open on the file descriptor.
+     *
+     * The file descriptor may be closed once the reader is created.
+     *
+     */
+    explicit ChillduinoColumnReader(int fd) :
+      _data(0),
+      _size(0),
+      _header(0),
+      _chunks(0),
+      _chunkCount(0),
+      _rows(0) {
+      if (!map(fd)) {
+        if (_data != 0) {
+          munmap((void *) _data, _size);
+        }
+
+        _data = 0;
+        _header = 0;
+        _chunkCount = 0;
+        _rows = 0;
+      }
+    }
+
+    ~ChillduinoColumnReader(void) {
+      if (_data != 0) {
+        munmap((void *) _data, _size);
+      }
+
+      delete[] _chunks;
+    }
+
+    /**
+     * Returns true if the file was mapped and is a valid column file.
+     *
+     */
+    bool isOpen(void) const {
+      return _header != 0;
+    }
+
+    uint32_t getColumns(void) const {
+      return _header->columns;
+    }
+
+    const char *getName(uint32_t column) const {
+      return (const char *) (_header + 1) + column * CHILLDUINO_COLUMNS_NAME_SIZE;
+    }
+
+    /**
+     * Finds the column with the name.
+     *
+     * Returns -1 if there is no such column.
+     *
+     */
+    long findColumn(const char *name) const {
+      for (uint32_t c = 0; c < getColumns(); c++) {
+        if (strncmp(getName(c), name, CHILLDUINO_COLUMNS_NAME_SIZE) == 0) {
+          return c;
+        }
+      }
+
+      return -1;
+    }
+
+    unsigned long getRows(void) const {
+      return _rows;
+    }
+
+    unsigned long getChunks(void) const {
+      return _chunkCount;
+    }
+
+    uint32_t getChunkRows(unsigned long chunk) const {
+      return getChunk(chunk).rows;
+    }
+
+    uint32_t getEncoding(unsigned long chunk, uint32_t column) const {
+      return getBlock(chunk, column).encoding;
+    }
+
+    /**
+     * Gets the values of a raw block in place.
+     *
+     * Returns 0 if the block has another encoding.
+     *
+     */
+    const uint32_t *getRawValues(unsigned long chunk, uint32_t column) const {
+      return (getEncoding(chunk, column) == CHILLDUINO_COLUMNS_RAW)
+        ? (const uint32_t *) getBlockData(chunk, column) : 0;
+    }
+
+    /**
+     * Decodes the values of one column of a chunk.
+     *
+     * The values must hold getChunkRows() values. Returns the number of
+     * values decoded, which is less than the number of rows only if the
+     * block is corrupt.
+     *
+     */
+    uint32_t decode(unsigned long chunk, uint32_t column,
+        uint32_t *values) const {
+      const ChillduinoColumnsBlock &block = getBlock(chunk, column);
+      const unsigned char *data = getBlockData(chunk, column);
+      uint32_t rows = getChunkRows(chunk);
+      uint32_t count = 0;
+
+      if (block.encoding == CHILLDUINO_COLUMNS_RAW) {
+        memcpy(values, data, block.length);
+        return rows;
+      }
+
+      if (block.encoding == CHILLDUINO_COLUMNS_PACKED) {
+        const uint32_t *header = (const uint32_t *) data;
+        const uint64_t *words = (const uint64_t *) (header + 2);
+        uint32_t width = header[1];
+        uint64_t mask = (width == 32) ? 0xFFFFFFFFUL : (1UL << width) - 1;
+
+        for (uint32_t i = 0; i < rows; i++) {
+          uint64_t bit = (uint64_t) i * width;
+          unsigned int offset = bit & 63;
+          uint64_t value = (width > 0) ? words[bit >> 6] >> offset : 0;
+
+          if (offset + width > 64) {
+            value |= words[(bit >> 6) + 1] << (64 - offset);
+          }
+
+          values[i] = header[0] + (uint32_t) (value & mask);
+        }
+
+        return rows;
+      }
+
+      if (block.encoding == CHILLDUINO_COLUMNS_RLE) {
+        const uint32_t *runs = (const uint32_t *) data;
+
+        for (uint32_t i = 0; i < block.length / sizeof(uint32_t); i += 2) {
+          for (uint32_t j = 0; j < runs[i + 1] && count < rows; j++) {
+            values[count++] = runs[i];
+          }
+        }
+
+        return count;
+      }
+
+      uint32_t previous = 0;
+      uint32_t i = 0;
+
+      while (i < block.length && count < rows) {
+        uint32_t value = 0;
+        unsigned int shift = 0;
+
+        while (i < block.length && (data[i] & 0x80) && shift < 28) {
+          value |= (uint32_t) (data[i++] & 0x7F) << shift;
+          shift += 7;
+        }
+
+        if (i == block.length) {
+          break;
+        }
+
+        value |= (uint32_t) data[i++] << shift;
+        previous += (value & 1) ? ~(value >> 1) : (value >> 1);
+        values[count++] = previous;
+      }
+
+      return count;
+    }
+
+    /**
+     * Sums a column without expanding its run length blocks or its
+     * packed boolean blocks.
+     *
+     */
+    unsigned long sum(uint32_t column) const {
+      uint32_t *values = new uint32_t[_header->rowsPerChunk];
+      unsigned long total = 0;
+
+      for (unsigned long chunk = 0; chunk < _chunkCount; chunk++) {
+        const ChillduinoColumnsBlock &block = getBlock(chunk, column);
+        const uint32_t *data = (const uint32_t *) getBlockData(chunk, column);
+        uint32_t count = block.length / sizeof(uint32_t);
+
+        if (block.encoding == CHILLDUINO_COLUMNS_RLE) {
+          for (uint32_t i = 0; i < count; i += 2) {
+            total += (unsigned long) data[i] * data[i + 1];
+          }
+        }
+        else if (block.encoding == CHILLDUINO_COLUMNS_PACKED &&
+            data[1] <= 1) {
+          const uint64_t *words = (const uint64_t *) (data + 2);
+          uint32_t rows = getChunkRows(chunk);
+
+          total += (unsigned long) data[0] * rows;
+
+          for (uint32_t i = 0; data[1] == 1 && i < (rows + 63) / 64; i++) {
+            total += __builtin_popcountl(words[i]);
+          }
+        }
+        else {
+          if (block.encoding != CHILLDUINO_COLUMNS_RAW) {
+            count = decode(chunk, column, values);
+            data = values;
+          }
+
+          for (uint32_t i = 0; i < count; i++) {
+            total += data[i];
+          }
+        }
+      }
+
+      delete[] values;
+      return total;
+    }
+};
+
+#endif /* CHILLDUINO_COLUMNS_H */
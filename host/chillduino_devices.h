@@ -0,0 +1,342 @@
+/**
+ * Copyright (c) 2015 FirstBuild
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef CHILLDUINO_DEVICES_H
+#define CHILLDUINO_DEVICES_H
+
+#include <string.h>
+#include <chillduino_series.h>
+#include <host/chillhub_frame.h>
+
+/**
+ * The ChillHub resources created by the sketch in chillduino_announce().
+ *
+ * These must match the identifiers in chillduino.ino.
+ *
+ */
+#define CHILLDUINO_THERMISTOR_ID 0x91
+#define CHILLDUINO_COMPRESSOR_ID 0x92
+#define CHILLDUINO_DEFROST_ID    0x93
+#define CHILLDUINO_DOOR_ID       0x94
+#define CHILLDUINO_BIMETAL_ID    0x95
+#define CHILLDUINO_SERIES_ID     0x96
+
+/**
+ * The state and rolling statistics kept for a single device.
+ *
+ * The thermistor average is an exponentially weighted moving average
+ * stored in sixteenths of a count, with each reading weighted by 1/8.
+ *
+ */
+struct ChillduinoDevice {
+  unsigned char uuid[16];
+  unsigned long messages;
+  unsigned long thermistorReadings;
+  long thermistorAverage;
+  unsigned int thermistor;
+  unsigned int thermistorMinimum;
+  unsigned int thermistorMaximum;
+  unsigned long compressorStarts;
+  unsigned long defrostStarts;
+  unsigned long doorOpens;
+  unsigned long bimetalCutoffs;
+  unsigned char isCompressorRunning;
+  unsigned char isDefrostRunning;
+  unsigned char isDoorOpen;
+  unsigned char isBimetalCutoff;
+};
+
+/**
+ * Parses the first UUID found in the text into 16 bytes.
+ *
+ * Returns false if the text does not contain a UUID.
+ *
+ */
+inline bool chillduinoParseUuid(const unsigned char *text, unsigned int length,
+    unsigned char *uuid) {
+  static const unsigned char dashes[] = { 8, 13, 18, 23 };
+
+  for (unsigned int start = 0; start + 36 <= length; start++) {
+    unsigned int byte = 0;
+    unsigned int dash = 0;
+    unsigned int i = 0;
+
+    for (; i < 36; i++) {
+      unsigned char c = text[start + i];
+      unsigned int nibble;
+
+      if (dash < 4 && i == dashes[dash]) {
+        if (c != '-') {
+          break;
+        }
+
+        dash++;
+        continue;
+      }
+
+      if (c >= '0' && c <= '9') {
+        nibble = c - '0';
+      }
+      else if (c >= 'a' && c <= 'f') {
+        nibble = c - 'a' + 10;
+      }
+      else if (c >= 'A' && c <= 'F') {
+        nibble = c - 'A' + 10;
+      }
+      else {
+        break;
+      }
+
+      if (byte & 1) {
+        uuid[byte >> 1] |= nibble;
+      }
+      else {
+        uuid[byte >> 1] = nibble << 4;
+      }
+
+      byte++;
+    }
+
+    if (i == 36) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/**
+ * An open addressing table of devices keyed by UUID.
+ *
+ * Probing only touches a compact array of hash tags; the device
+ * records are read once a tag matches. The capacity is rounded up to a
+ * power of two and fixed when the table is created, so the index of a
+ * device never changes and can be cached by its connection. Devices
+ * are never removed.
+ *
+ */
+class ChillduinoDeviceTable {
+  private:
+    unsigned long *_tags;
+    ChillduinoDevice *_devices;
+    unsigned long _mask;
+    unsigned long _count;
+
+    ChillduinoDeviceTable(const ChillduinoDeviceTable &);
+    ChillduinoDeviceTable &operator=(const ChillduinoDeviceTable &);
+
+    static unsigned long hash(const unsigned char *uuid) {
+      unsigned long h = 2166136261UL;
+
+      for (int i = 0; i < 16; i++) {
+        h = (h ^ uuid[i]) * 16777619UL;
+      }
+
+      return h | 1;
+    }
+
+    void updateThermistor(ChillduinoDevice &device, unsigned int reading) {
+      if (device.thermistorReadings++ == 0) {
+        device.thermistorAverage = (long) reading << 4;
+        device.thermistorMinimum = reading;
+        device.thermistorMaximum = reading;
+      }
+      else {
+        device.thermistorAverage +=
+          (((long) reading << 4) - device.thermistorAverage) / 8;
+
+        if (reading < device.thermistorMinimum) {
+          device.thermistorMinimum = reading;
+        }
+
+        if (reading > device.thermistorMaximum) {
+          device.thermistorMaximum = reading;
+        }
+      }
+
+      device.thermistor = reading;
+    }
+
+    static bool updateFlag(unsigned char &flag, unsigned int value) {
+      bool isStarted = value && !flag;
+      flag = value ? 1 : 0;
+      return isStarted;
+    }
+
+  public:
+
+    /**
+     * Creates a table able to hold the given number of devices.
+     *
+     * The table is kept at most half full to keep probe sequences short.
+     *
+     */
+    explicit ChillduinoDeviceTable(unsigned long capacity) :
+      _tags(0),
+      _devices(0),
+      _mask(0),
+      _count(0) {
+      unsigned long size = 16;
+
+      while (size < 2 * capacity) {
+        size <<= 1;
+      }
+
+      _tags = new unsigned long[size];
+      _devices = new ChillduinoDevice[size];
+      _mask = size - 1;
+      memset(_tags, 0, size * sizeof(unsigned long));
+    }
+
+    ~ChillduinoDeviceTable(void) {
+      delete[] _tags;
+      delete[] _devices;
+    }
+
+    /**
+     * Finds the device with the UUID, adding it if it is not present.
+     *
+     * Returns -1 if the device is new and the table is full.
+     *
+     */
+    long insert(const unsigned char *uuid) {
+      unsigned long tag = hash(uuid);
+      unsigned long i = tag & _mask;
+
+      while (_tags[i] != 0) {
+        if (_tags[i] == tag && memcmp(_devices[i].uuid, uuid, 16) == 0) {
+          return (long) i;
+        }
+
+        i = (i + 1) & _mask;
+      }
+
+      if (2 * (_count + 1) > _mask + 1) {
+        return -1;
+      }
+
+      _tags[i] = tag;
+      memset(&_devices[i], 0, sizeof(ChillduinoDevice));
+      memcpy(_devices[i].uuid, uuid, 16);
+      _count++;
+      return (long) i;
+    }
+
+    /**
+     * Finds the device with the UUID.
+     *
+     * Returns -1 if the device is not present.
+     *
+     */
+    long find(const unsigned char *uuid) const {
+      unsigned long tag = hash(uuid);
+      unsigned long i = tag & _mask;
+
+      while (_tags[i] != 0) {
+        if (_tags[i] == tag && memcmp(_devices[i].uuid, uuid, 16) == 0) {
+          return (long) i;
+        }
+
+        i = (i + 1) & _mask;
+      }
+
+      return -1;
+    }
+
+    /**
+     * Gets the device stored at an index returned by insert or find.
+     *
+     */
+    ChillduinoDevice &get(long index) {
+      return _devices[index];
+    }
+
+    /**
+     * Gets the number of slots in the table, which bounds every index
+     * returned by insert or find.
+     *
+     */
+    unsigned long getCapacity(void) const {
+      return _mask + 1;
+    }
+
+    /**
+     * Gets the number of devices in the table.
+     *
+     */
+    unsigned long getCount(void) const {
+      return _count;
+    }
+
+    /**
+     * Applies a frame received from the device at the index.
+     *
+     */
+    void update(long index, const ChillhubFrame &frame) {
+      ChillduinoDevice &device = _devices[index];
+      unsigned int value = chillhubReadU16(frame);
+
+      device.messages++;
+
+      switch (frame.type) {
+        case CHILLDUINO_THERMISTOR_ID:
+          updateThermistor(device, value);
+          break;
+
+        case CHILLDUINO_COMPRESSOR_ID:
+          device.compressorStarts +=
+            updateFlag(device.isCompressorRunning, value);
+          break;
+
+        case CHILLDUINO_DEFROST_ID:
+          device.defrostStarts += updateFlag(device.isDefrostRunning, value);
+          break;
+
+        case CHILLDUINO_DOOR_ID:
+          device.doorOpens += updateFlag(device.isDoorOpen, value);
+          break;
+
+        case CHILLDUINO_BIMETAL_ID:
+          device.bimetalCutoffs += updateFlag(device.isBimetalCutoff, value);
+          break;
+
+        case CHILLDUINO_SERIES_ID:
+          // an array payload starts with its element count and type
+          if (frame.dataType == CHILLHUB_ARRAY_DATA_TYPE && frame.length >= 2) {
+            ChillduinoSeriesDecoder decoder(frame.payload + 2,
+              frame.length - 2);
+            int sample;
+
+            while (decoder.next(sample)) {
+              updateThermistor(device, (unsigned int) sample);
+            }
+          }
+          break;
+
+        default:
+          break;
+      }
+    }
+};
+
+#endif /* CHILLDUINO_DEVICES_H */
@@ -0,0 +1,352 @@
+/**
+ * Copyright (c) 2015 FirstBuild
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef CHILLDUINO_FLEET_H
+#define CHILLDUINO_FLEET_H
+
+#include <chillduino.h>
+#include <host/chillduino_radix_heap.h>
+
+/**
+ * The index returned when a unit cannot be added.
+ *
+ */
+#define CHILLDUINO_FLEET_FULL ((unsigned int) -1)
+
+#define CHILLDUINO_INPUT_THERMISTOR     0
+#define CHILLDUINO_INPUT_DOOR_SWITCH    1
+#define CHILLDUINO_INPUT_DEFROST_SWITCH 2
+#define CHILLDUINO_INPUT_MODE_SWITCH    3
+
+/**
+ * A change of one input of a simulated chillduino.
+ *
+ * The reading is set at the time, so the first tick that sees it is
+ * the one that follows.
+ *
+ */
+struct ChillduinoInput {
+  unsigned long time;
+  int reading;
+  unsigned char type;
+};
+
+/**
+ * Sets the chillduino input that the change is for.
+ *
+ */
+inline void chillduinoApplyInput(Chillduino &chillduino,
+    const ChillduinoInput &input) {
+  switch (input.type) {
+    case CHILLDUINO_INPUT_THERMISTOR:
+      chillduino.setCurrentFreshFoodThermistorReading(input.reading);
+      break;
+
+    case CHILLDUINO_INPUT_DOOR_SWITCH:
+      chillduino.setDoorSwitchReading(input.reading);
+      break;
+
+    case CHILLDUINO_INPUT_DEFROST_SWITCH:
+      chillduino.setDefrostSwitchReading(input.reading);
+      break;
+
+    case CHILLDUINO_INPUT_MODE_SWITCH:
+      chillduino.setModeSwitchReading(input.reading);
+      break;
+
+    default:
+      break;
+  }
+}
+
+/**
+ * Simulates many independent chillduinos as discrete events.
+ *
+ * Every unit is queued at its next deadline, which is either the
+ * expiry of one of its timers or its next scheduled input. Only the
+ * unit with the earliest deadline is advanced, straight to that
+ * deadline, so a unit costs nothing between its events. The outputs
+ * of a unit can only change at a deadline, which keeps the fleet
+ * totals exact.
+ *
+ * Each unit keeps its chillduino, its time and a pointer to its inputs.
+ * The inputs are not copied and must outlive the fleet. A unit is a
+ * whole Chillduino, so statistics should be left compiled out by not
+ * defining CHILLDUINO_STATISTICS, which takes a unit on a 64-bit host
+ * from 576 to 352 bytes.
+ *
+ * Every event runs the unit's full loop and reschedules it, so the
+ * fleet is built to be exact rather than fast. It handles a few
+ * million events per second, limited by that loop and, once the fleet
+ * no longer fits in cache, by memory, since units are visited in
+ * deadline order. A fleet where raw event throughput matters more than
+ * exact chillduino behavior needs its own compact model of the unit.
+ *
+ */
+class ChillduinoFleet {
+  private:
+    struct Unit {
+      Chillduino chillduino;
+      const ChillduinoInput *input;
+      const ChillduinoInput *end;
+      unsigned long time;
+
+      Unit(void) : chillduino(), input(0), end(0), time(0) { }
+    };
+
+    Unit *_units;
+    ChillduinoRadixHeap _deadlines;
+    unsigned int _capacity;
+    unsigned int _count;
+    unsigned long _time;
+    unsigned long _events;
+    unsigned long _runningCompressors;
+    unsigned long _peakRunningCompressors;
+    unsigned long _compressorTicks;
+    unsigned long _compressorStarts;
+    unsigned long _defrosts;
+
+    ChillduinoFleet(const ChillduinoFleet &);
+    ChillduinoFleet &operator=(const ChillduinoFleet &);
+
+    void schedule(unsigned int index, bool isChanged) {
+      Unit &unit = _units[index];
+      unsigned long ticks = isChanged
+        ? 1 : unit.chillduino.getTicksUntilNextEvent();
+      unsigned long deadline = (ticks > CHILLDUINO_NEVER - unit.time)
+        ? CHILLDUINO_NEVER : unit.time + ticks;
+
+      if (unit.input != unit.end && unit.input->time < deadline) {
+        deadline = unit.input->time;
+      }
+
+      if (deadline == CHILLDUINO_NEVER) {
+        _deadlines.remove(index);
+      }
+      else {
+        _deadlines.push(index, deadline);
+      }
+    }
+
+    void advance(unsigned int index, unsigned long time) {
+      Unit &unit = _units[index];
+      bool isCompressorRunning = unit.chillduino.isCompressorRunning();
+      bool isDefrostRunning = unit.chillduino.isDefrostRunning();
+      bool isChanged = false;
+
+      unit.chillduino.elapse(time - unit.time);
+      unit.time = time;
+
+      while (unit.input != unit.end && unit.input->time <= time) {
+        chillduinoApplyInput(unit.chillduino, *unit.input++);
+        isChanged = true;
+      }
+
+      if (unit.chillduino.isCompressorRunning() != isCompressorRunning) {
+        if (isCompressorRunning) {
+          _runningCompressors--;
+        }
+        else {
+          _runningCompressors++;
+          _compressorStarts++;
+        }
+      }
+
+      if (!isDefrostRunning && unit.chillduino.isDefrostRunning()) {
+        _defrosts++;
+      }
+
+      _events++;
+      schedule(index, isChanged || unit.chillduino.isChanged());
+    }
+
+    void advanceFleet(unsigned long time) {
+      if (time != _time && _runningCompressors > _peakRunningCompressors) {
+        _peakRunningCompressors = _runningCompressors;
+      }
+
+      _compressorTicks += _runningCompressors * (time - _time);
+      _time = time;
+    }
+
+  public:
+
+    /**
+     * Creates an empty fleet able to hold the given number of units.
+     *
+     */
+    explicit ChillduinoFleet(unsigned int capacity) :
+      _units(new Unit[capacity]),
+      _deadlines(capacity),
+      _capacity(capacity),
+      _count(0),
+      _time(0),
+      _events(0),
+      _runningCompressors(0),
+      _peakRunningCompressors(0),
+      _compressorTicks(0),
+      _compressorStarts(0),
+      _defrosts(0) { }
+
+    ~ChillduinoFleet(void) {
+      delete[] _units;
+    }
+
+    /**
+     * Adds a unit starting at the current time and returns its index.
+     *
+     * The inputs must be in order of time and none may be earlier than
+     * the current time. Returns CHILLDUINO_FLEET_FULL if the fleet is
+     * full.
+     *
+     */
+    unsigned int add(const Chillduino &chillduino,
+        const ChillduinoInput *inputs, unsigned int count) {
+      if (_count == _capacity) {
+        return CHILLDUINO_FLEET_FULL;
+      }
+
+      unsigned int index = _count++;
+      Unit &unit = _units[index];
+
+      unit.chillduino = chillduino;
+      unit.input = inputs;
+      unit.end = inputs + count;
+      unit.time = _time;
+
+      if (chillduino.isCompressorRunning()) {
+        _runningCompressors++;
+      }
+
+      schedule(index, true);
+      return index;
+    }
+
+    /**
+     * Gets the number of units.
+     *
+     */
+    unsigned int getCount(void) const {
+      return _count;
+    }
+
+    /**
+     * Gets the current time (in ticks).
+     *
+     */
+    unsigned long getTime(void) const {
+      return _time;
+    }
+
+    /**
+     * Gets a unit's chillduino as of the current time.
+     *
+     * Inputs may be changed between calls to elapse().
+     *
+     */
+    Chillduino &getChillduino(unsigned int index) {
+      Unit &unit = _units[index];
+
+      unit.chillduino.elapse(_time - unit.time);
+      unit.time = _time;
+      schedule(index, true);
+
+      return unit.chillduino;
+    }
+
+    /**
+     * Gets the number of unit events processed so far.
+     *
+     */
+    unsigned long getEvents(void) const {
+      return _events;
+    }
+
+    /**
+     * Gets the number of compressors running at the current time.
+     *
+     */
+    unsigned long getRunningCompressors(void) const {
+      return _runningCompressors;
+    }
+
+    /**
+     * Gets the largest number of compressors that ran at once.
+     *
+     * Units that change at the same time are counted once they have
+     * all changed.
+     *
+     */
+    unsigned long getPeakRunningCompressors(void) const {
+      return (_runningCompressors > _peakRunningCompressors)
+        ? _runningCompressors : _peakRunningCompressors;
+    }
+
+    /**
+     * Gets the ticks summed over every running compressor.
+     *
+     */
+    unsigned long getCompressorTicks(void) const {
+      return _compressorTicks;
+    }
+
+    /**
+     * Gets the number of times any compressor started.
+     *
+     */
+    unsigned long getCompressorStarts(void) const {
+      return _compressorStarts;
+    }
+
+    /**
+     * Gets the number of times any defrost started.
+     *
+     */
+    unsigned long getDefrosts(void) const {
+      return _defrosts;
+    }
+
+    /**
+     * Causes the amount of time (in ticks) to elapse for every unit.
+     *
+     */
+    void elapse(unsigned long ticks) {
+      unsigned long end = _time + ticks;
+
+      while (!_deadlines.isEmpty()) {
+        unsigned int index = _deadlines.top();
+        unsigned long time = _deadlines.getKey(index);
+
+        if (time > end) {
+          break;
+        }
+
+        advanceFleet(time);
+        advance(index, time);
+      }
+
+      advanceFleet(end);
+    }
+};
+
+#endif /* CHILLDUINO_FLEET_H */
@@ -0,0 +1,242 @@
+/**
+ * Copyright (c) 2015 FirstBuild
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef CHILLDUINO_FUZZER_H
+#define CHILLDUINO_FUZZER_H
+
+#include <stdlib.h>
+#include <chillduino.h>
+
+/**
+ * The number of bytes used to configure the chillduino.
+ *
+ */
+#define CHILLDUINO_FUZZER_HEADER_SIZE 8
+
+/**
+ * The number of bytes in each scheduled input.
+ *
+ */
+#define CHILLDUINO_FUZZER_INPUT_SIZE  2
+
+/**
+ * The largest delay exponent, limiting each delay to 4 << 12 ticks.
+ *
+ */
+#define CHILLDUINO_FUZZER_MAXIMUM_SHIFT 12
+
+/**
+ * Drives a chillduino through a schedule of inputs decoded from bytes
+ * and checks its safety invariants after every step.
+ *
+ * The first bytes configure the timers, kept short so that they
+ * overlap often. Every following pair of bytes is one input: the low
+ * two bits of the first byte pick the thermistor, door, defrost or mode
+ * switch, the next bit is the switch reading and the rest is the
+ * exponent of the delay before the input. The second byte holds the
+ * delay mantissa and the thermistor reading.
+ *
+ * Time only advances from one chillduino event to the next, so a
+ * schedule spanning hours costs a handful of steps. The whole schedule
+ * is always run, so the work per run is bounded by the length of the
+ * data, such as with libFuzzer's -max_len. One fuzzer is reset for
+ * every run, so nothing is allocated. A failed invariant aborts, whether or
+ * not NDEBUG is defined.
+ *
+ */
+class ChillduinoFuzzer {
+  private:
+    Chillduino _chillduino;
+    unsigned long _time;
+    unsigned long _compressorChangeTime;
+    unsigned long _minimumTicksForCompressorChange;
+    unsigned long _maximumCompressorTicksPerDefrost;
+    unsigned long _steps;
+    bool _isCompressorRunning;
+    bool _isOff;
+    bool _isInputChanged;
+
+    ChillduinoFuzzer(const ChillduinoFuzzer &);
+    ChillduinoFuzzer &operator=(const ChillduinoFuzzer &);
+
+    static void require(bool isHeld) {
+      if (!isHeld) {
+        abort();
+      }
+    }
+
+    void check(void) {
+      bool isCompressorRunning = _chillduino.isCompressorRunning();
+      bool isOff = _chillduino.getMode() == CHILLDUINO_MODE_OFF;
+
+      require(!(isCompressorRunning && _chillduino.isDefrostRunning()));
+      require(!(_isOff && isOff && isCompressorRunning));
+      require(!(_isOff && isOff && _chillduino.isDefrostRunning()));
+      require(_chillduino.getRemainingCompressorTicksUntilDefrost()
+        <= _maximumCompressorTicksPerDefrost);
+
+      if (isCompressorRunning != _isCompressorRunning) {
+        require(isOff || _time - _compressorChangeTime
+          >= _minimumTicksForCompressorChange);
+        _compressorChangeTime = _time;
+      }
+
+      _isCompressorRunning = isCompressorRunning;
+      _isOff = isOff;
+      _steps++;
+    }
+
+    void elapse(unsigned long ticks) {
+      while (ticks > 0) {
+        unsigned long step = (_isInputChanged || _chillduino.isChanged())
+          ? 1 : _chillduino.getTicksUntilNextEvent();
+
+        if (step > ticks) {
+          step = ticks;
+        }
+
+        _chillduino.elapse(step);
+        _time += step;
+        ticks -= step;
+        _isInputChanged = false;
+        check();
+      }
+    }
+
+    void apply(unsigned char type, unsigned char value) {
+      int reading = (type >> 2) & 1;
+
+      switch (type & 3) {
+        case 0:
+          _chillduino.setCurrentFreshFoodThermistorReading(350 + (value >> 2) % 60);
+          break;
+
+        case 1:
+          _chillduino.setDoorSwitchReading(reading);
+          break;
+
+        case 2:
+          _chillduino.setDefrostSwitchReading(reading);
+          break;
+
+        default:
+          _chillduino.setModeSwitchReading(reading);
+          break;
+      }
+
+      _isInputChanged = true;
+    }
+
+    void reset(const unsigned char *header) {
+      _chillduino = Chillduino();
+      _time = 0;
+      _minimumTicksForCompressorChange = 1 + 4 * header[1];
+      _maximumCompressorTicksPerDefrost = 1 + 8 * header[3] + 8 * header[4];
+      _steps = 0;
+      _isCompressorRunning = false;
+      _isInputChanged = true;
+
+      _chillduino
+        .setMode(header[0] & 3)
+        .setMinimumFreshFoodThermistorReading(370)
+        .setMaximumFreshFoodThermistorReading(392)
+        .setMinimumTicksForCompressorChange(_minimumTicksForCompressorChange)
+        .setDefrostDurationInTicks(1 + 4 * header[2])
+        .setMinimumCompressorTicksPerDefrost(1 + 8 * header[3])
+        .setMaximumCompressorTicksPerDefrost(_maximumCompressorTicksPerDefrost)
+        .setRemainingCompressorTicksUntilDefrost(
+          _maximumCompressorTicksPerDefrost)
+        .setMinimumTicksForDoorClose(1 + 8 * (header[5] & 0xF))
+        .setMinimumTicksForHeldModeSwitch(1 + 64 * (header[5] >> 4))
+        .setMinimumTicksForForceDefrost(1 + 16 * header[6])
+        .setMinimumTicksForCloseBeforeForceDefrost(1 + 4 * (header[7] & 0x3F))
+        .setMinimumOpensForForceDefrost(1 + ((header[0] >> 2) & 3))
+        .setMinimumTicksForBimetalCutoff(1 + 8 * (header[7] >> 6));
+
+      _isOff = _chillduino.getMode() == CHILLDUINO_MODE_OFF;
+      _compressorChangeTime = 0 - _minimumTicksForCompressorChange;
+    }
+
+  public:
+
+    /**
+     * Creates a fuzzer, configured by the header of each run.
+     *
+     */
+    ChillduinoFuzzer(void) :
+      _chillduino(),
+      _time(0),
+      _compressorChangeTime(0),
+      _minimumTicksForCompressorChange(0),
+      _maximumCompressorTicksPerDefrost(0),
+      _steps(0),
+      _isCompressorRunning(false),
+      _isOff(false),
+      _isInputChanged(false) { }
+
+    /**
+     * Resets the chillduino to the configuration in the header of the
+     * data, applies each following input after its delay, then lets
+     * every timer expire.
+     *
+     * Returns the number of steps checked, which is zero for data too
+     * short for a header.
+     *
+     */
+    unsigned long run(const unsigned char *data, unsigned long size) {
+      const unsigned char *inputs = data + CHILLDUINO_FUZZER_HEADER_SIZE;
+
+      if (size < CHILLDUINO_FUZZER_HEADER_SIZE) {
+        return 0;
+      }
+
+      reset(data);
+      size -= CHILLDUINO_FUZZER_HEADER_SIZE;
+
+      for (unsigned long i = 0; i + 1 < size; i += 2) {
+        unsigned long shift = (inputs[i] >> 3) % (CHILLDUINO_FUZZER_MAXIMUM_SHIFT + 1);
+
+        elapse((unsigned long) (1 + (inputs[i + 1] & 3)) << shift);
+        apply(inputs[i], inputs[i + 1]);
+      }
+
+      elapse((unsigned long) 4 << CHILLDUINO_FUZZER_MAXIMUM_SHIFT);
+      return _steps;
+    }
+};
+
+/**
+ * Runs a shared fuzzer over the data, ignoring data too short for a
+ * header.
+ *
+ * Returns the number of steps checked.
+ *
+ */
+inline unsigned long chillduinoFuzz(const unsigned char *data,
+    unsigned long size) {
+  static ChillduinoFuzzer fuzzer;
+
+  return fuzzer.run(data, size);
+}
+
+#endif /* CHILLDUINO_FUZZER_H */
@@ -0,0 +1,248 @@
+/**
+ * Copyright (c) 2015 FirstBuild
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef CHILLDUINO_RADIX_HEAP_H
+#define CHILLDUINO_RADIX_HEAP_H
+
+#include <limits.h>
+#include <stdlib.h>
+#include <chillduino.h>
+
+/**
+ * The key of an item that is not queued. It can never be queued.
+ *
+ */
+#define CHILLDUINO_RADIX_HEAP_NONE CHILLDUINO_NEVER
+
+/**
+ * The number of buckets, one for every bit of a key plus one.
+ *
+ */
+#define CHILLDUINO_RADIX_HEAP_BUCKETS (sizeof(unsigned long) * CHAR_BIT + 1)
+
+/**
+ * A monotone priority queue of items keyed by time.
+ *
+ * Items are numbered from zero to the capacity and each item is queued
+ * at most once. Bucket i holds the entries whose key first differs
+ * from the last key taken in bit i - 1, so taking an item only ever
+ * scans and splits the lowest non-empty bucket, moving every entry to
+ * a strictly lower one. Keys must never be earlier than the last key
+ * taken, which always holds when simulating forward in time.
+ *
+ * Moving or removing an item only changes its current key. The entry
+ * left behind is stale and is dropped when its bucket is next scanned.
+ *
+ */
+class ChillduinoRadixHeap {
+  private:
+    struct Entry {
+      unsigned long key;
+      unsigned int item;
+    };
+
+    struct Bucket {
+      Entry *entries;
+      unsigned int count;
+      unsigned int capacity;
+    };
+
+    unsigned long *_keys;
+    Bucket _buckets[CHILLDUINO_RADIX_HEAP_BUCKETS];
+    unsigned long _last;
+    unsigned int _count;
+
+    ChillduinoRadixHeap(const ChillduinoRadixHeap &);
+    ChillduinoRadixHeap &operator=(const ChillduinoRadixHeap &);
+
+    unsigned int getBucket(unsigned long key) const {
+      return (key == _last) ? 0
+        : sizeof(unsigned long) * CHAR_BIT - __builtin_clzl(key ^ _last);
+    }
+
+    bool isStale(const Entry &entry) const {
+      return _keys[entry.item] != entry.key;
+    }
+
+    void append(unsigned int bucket, const Entry &entry) {
+      Bucket &b = _buckets[bucket];
+
+      if (b.count == b.capacity) {
+        b.capacity = b.capacity ? 2 * b.capacity : 16;
+        b.entries = (Entry *) realloc(b.entries, b.capacity * sizeof(Entry));
+      }
+
+      b.entries[b.count++] = entry;
+    }
+
+    void split(void) {
+      unsigned int bucket = 1;
+
+      for (;;) {
+        while (_buckets[bucket].count == 0) {
+          bucket++;
+        }
+
+        Bucket &b = _buckets[bucket];
+        unsigned long minimum = CHILLDUINO_RADIX_HEAP_NONE;
+        unsigned int count = 0;
+
+        for (unsigned int i = 0; i < b.count; i++) {
+          if (!isStale(b.entries[i])) {
+            if (b.entries[i].key < minimum) {
+              minimum = b.entries[i].key;
+            }
+
+            b.entries[count++] = b.entries[i];
+          }
+        }
+
+        b.count = 0;
+
+        if (count > 0) {
+          _last = minimum;
+
+          for (unsigned int i = 0; i < count; i++) {
+            append(getBucket(b.entries[i].key), b.entries[i]);
+          }
+
+          return;
+        }
+      }
+    }
+
+  public:
+
+    /**
+     * Creates an empty queue for items numbered below the capacity.
+     *
+     */
+    explicit ChillduinoRadixHeap(unsigned int capacity) :
+      _keys(new unsigned long[capacity]),
+      _buckets(),
+      _last(0),
+      _count(0) {
+      for (unsigned int i = 0; i < capacity; i++) {
+        _keys[i] = CHILLDUINO_RADIX_HEAP_NONE;
+      }
+    }
+
+    ~ChillduinoRadixHeap(void) {
+      for (unsigned int i = 0; i < CHILLDUINO_RADIX_HEAP_BUCKETS; i++) {
+        free(_buckets[i].entries);
+      }
+
+      delete[] _keys;
+    }
+
+    /**
+     * Returns true if no items are queued.
+     *
+     */
+    bool isEmpty(void) const {
+      return _count == 0;
+    }
+
+    /**
+     * Returns true if the item is queued.
+     *
+     */
+    bool contains(unsigned int item) const {
+      return _keys[item] != CHILLDUINO_RADIX_HEAP_NONE;
+    }
+
+    /**
+     * Gets the key of an item, or CHILLDUINO_RADIX_HEAP_NONE if the
+     * item is not queued.
+     *
+     */
+    unsigned long getKey(unsigned int item) const {
+      return _keys[item];
+    }
+
+    /**
+     * Queues the item at the key, or moves it there if already queued.
+     *
+     */
+    void push(unsigned int item, unsigned long key) {
+      if (_keys[item] == key) {
+        return;
+      }
+
+      if (_keys[item] == CHILLDUINO_RADIX_HEAP_NONE) {
+        _count++;
+      }
+
+      Entry entry;
+      entry.key = key;
+      entry.item = item;
+
+      _keys[item] = key;
+      append(getBucket(key), entry);
+    }
+
+    /**
+     * Removes the item if it is queued.
+     *
+     */
+    void remove(unsigned int item) {
+      if (_keys[item] != CHILLDUINO_RADIX_HEAP_NONE) {
+        _keys[item] = CHILLDUINO_RADIX_HEAP_NONE;
+        _count--;
+      }
+    }
+
+    /**
+     * Gets an item with the earliest key without removing it.
+     *
+     * The queue must not be empty.
+     *
+     */
+    unsigned int top(void) {
+      Bucket &b = _buckets[0];
+
+      for (;;) {
+        while (b.count > 0 && isStale(b.entries[b.count - 1])) {
+          b.count--;
+        }
+
+        if (b.count > 0) {
+          return b.entries[b.count - 1].item;
+        }
+
+        split();
+      }
+    }
+
+    /**
+     * Removes and returns an item with the earliest key.
+     *
+     */
+    unsigned int pop(void) {
+      unsigned int item = top();
+      remove(item);
+      return item;
+    }
+};
+
+#endif /* CHILLDUINO_RADIX_HEAP_H */
@@ -0,0 +1,305 @@
+/**
+ * Copyright (c) 2015 FirstBuild
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef CHILLDUINO_SCENARIO_H
+#define CHILLDUINO_SCENARIO_H
+
+#include <chillduino.h>
+#include <host/chillduino_radix_heap.h>
+
+/**
+ * Starts the body of ChillduinoScenario::run().
+ *
+ */
+#define CHILLDUINO_SCENARIO_BEGIN() switch (_line) { case 0:
+
+/**
+ * Ends the body of ChillduinoScenario::run().
+ *
+ */
+#define CHILLDUINO_SCENARIO_END() } return false
+
+/**
+ * Suspends the scenario for the amount of time (in ticks).
+ *
+ */
+#define CHILLDUINO_AFTER(ticks) \
+  do { \
+    _line = __LINE__; \
+    waitFor(ticks); \
+    return true; \
+    case __LINE__:; \
+  } while (0)
+
+/**
+ * Suspends the scenario until the condition holds.
+ *
+ * The condition is checked on the tick after the scenario suspends and
+ * then whenever the chillduino could have changed, so it should only
+ * depend on the chillduino outputs and the scenario itself.
+ *
+ */
+#define CHILLDUINO_UNTIL(condition) \
+  do { \
+    if (!(condition)) { \
+      _line = __LINE__; \
+      waitUntil(); \
+      return true; \
+    } \
+    break; \
+    case __LINE__: \
+    if (!(condition)) { \
+      return true; \
+    } \
+  } while (0)
+
+class ChillduinoScenarioRunner;
+
+/**
+ * A script of inputs and checks against a single chillduino.
+ *
+ * The script is the body of run(), between CHILLDUINO_SCENARIO_BEGIN()
+ * and CHILLDUINO_SCENARIO_END(), and suspends itself with
+ * CHILLDUINO_AFTER() and CHILLDUINO_UNTIL(). Suspending returns from
+ * run() and the next call resumes where it left off, so local
+ * variables do not survive a suspension and anything that must is kept
+ * in the derived class instead. At most one suspension may be written
+ * on each line.
+ *
+ */
+class ChillduinoScenario {
+  friend class ChillduinoScenarioRunner;
+
+  private:
+    Chillduino _chillduino;
+    unsigned long _time;
+    unsigned long _wakeTime;
+    bool _isWaitingUntil;
+    bool _isFinished;
+
+    ChillduinoScenario(const ChillduinoScenario &);
+    ChillduinoScenario &operator=(const ChillduinoScenario &);
+
+  protected:
+    int _line;
+
+    void waitFor(unsigned long ticks) {
+      _wakeTime = _time + ticks;
+      _isWaitingUntil = false;
+    }
+
+    void waitUntil(void) {
+      _wakeTime = _time + 1;
+      _isWaitingUntil = true;
+    }
+
+    /**
+     * Runs the script up to its next suspension.
+     *
+     * Returns false once the script has finished.
+     *
+     */
+    virtual bool run(void) = 0;
+
+  public:
+
+    /**
+     * Creates a scenario for a copy of the chillduino.
+     *
+     */
+    explicit ChillduinoScenario(const Chillduino &chillduino) :
+      _chillduino(chillduino),
+      _time(0),
+      _wakeTime(0),
+      _isWaitingUntil(false),
+      _isFinished(false),
+      _line(0) { }
+
+    virtual ~ChillduinoScenario(void) { }
+
+    /**
+     * Gets the chillduino the script is run against.
+     *
+     */
+    Chillduino &getChillduino(void) {
+      return _chillduino;
+    }
+
+    /**
+     * Gets the time (in ticks) the script has reached.
+     *
+     */
+    unsigned long getTime(void) const {
+      return _time;
+    }
+
+    /**
+     * Returns true once the script has run to its end.
+     *
+     */
+    bool isFinished(void) const {
+      return _isFinished;
+    }
+};
+
+/**
+ * Runs many scenarios against a shared clock.
+ *
+ * Every suspended scenario is queued at the time it could next resume.
+ * A scenario waiting for an amount of time is queued at its end and its
+ * chillduino is then advanced in a single elapse(). A scenario waiting
+ * for a condition is queued at the next tick on which its chillduino
+ * could change, so waits cost one resume per chillduino event rather
+ * than one per tick.
+ *
+ * Scenarios are not owned by the runner and must outlive it.
+ *
+ */
+class ChillduinoScenarioRunner {
+  private:
+    ChillduinoScenario **_scenarios;
+    ChillduinoRadixHeap _wakeTimes;
+    unsigned int _capacity;
+    unsigned int _count;
+    unsigned int _finished;
+    unsigned long _time;
+    unsigned long _resumes;
+
+    ChillduinoScenarioRunner(const ChillduinoScenarioRunner &);
+    ChillduinoScenarioRunner &operator=(const ChillduinoScenarioRunner &);
+
+    void resume(unsigned int index) {
+      ChillduinoScenario &scenario = *_scenarios[index];
+
+      scenario._chillduino.elapse(_time - scenario._time);
+      scenario._time = _time;
+      _resumes++;
+
+      if (!scenario.run()) {
+        scenario._isFinished = true;
+        _finished++;
+        _wakeTimes.remove(index);
+        return;
+      }
+
+      if (scenario._isWaitingUntil && scenario._wakeTime <= _time) {
+        unsigned long ticks = scenario._chillduino.isChanged()
+          ? 1 : scenario._chillduino.getTicksUntilNextEvent();
+
+        if (ticks > CHILLDUINO_NEVER - _time) {
+          _wakeTimes.remove(index);
+          return;
+        }
+
+        scenario._wakeTime = _time + ticks;
+      }
+
+      _wakeTimes.push(index, scenario._wakeTime);
+    }
+
+  public:
+
+    /**
+     * Creates a runner able to hold the given number of scenarios.
+     *
+     */
+    explicit ChillduinoScenarioRunner(unsigned int capacity) :
+      _scenarios(new ChillduinoScenario *[capacity]),
+      _wakeTimes(capacity),
+      _capacity(capacity),
+      _count(0),
+      _finished(0),
+      _time(0),
+      _resumes(0) { }
+
+    ~ChillduinoScenarioRunner(void) {
+      delete[] _scenarios;
+    }
+
+    /**
+     * Adds a scenario that starts at the current time.
+     *
+     * Returns false if the runner is full.
+     *
+     */
+    bool add(ChillduinoScenario *scenario) {
+      if (_count == _capacity) {
+        return false;
+      }
+
+      scenario->_time = _time;
+      scenario->_wakeTime = _time;
+      _scenarios[_count] = scenario;
+      _wakeTimes.push(_count++, _time);
+      return true;
+    }
+
+    /**
+     * Gets the current time (in ticks).
+     *
+     */
+    unsigned long getTime(void) const {
+      return _time;
+    }
+
+    /**
+     * Gets the number of scenarios that have finished.
+     *
+     */
+    unsigned int getFinished(void) const {
+      return _finished;
+    }
+
+    /**
+     * Gets the number of times any scenario was resumed.
+     *
+     */
+    unsigned long getResumes(void) const {
+      return _resumes;
+    }
+
+    /**
+     * Causes the amount of time (in ticks) to elapse, resuming every
+     * scenario that is due along the way.
+     *
+     */
+    void elapse(unsigned long ticks) {
+      unsigned long end = _time + ticks;
+
+      while (!_wakeTimes.isEmpty()) {
+        unsigned int index = _wakeTimes.top();
+        unsigned long time = _wakeTimes.getKey(index);
+
+        if (time > end) {
+          break;
+        }
+
+        _time = time;
+        resume(index);
+      }
+
+      _time = end;
+    }
+};
+
+#endif /* CHILLDUINO_SCENARIO_H */
@@ -0,0 +1,618 @@
+/**
+ * Copyright (c) 2015 FirstBuild
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef CHILLDUINO_SIMULATOR_H
+#define CHILLDUINO_SIMULATOR_H
+
+#include <string.h>
+#include <chillduino.h>
+
+/**
+ * The number of values written by ChillduinoPlant::getState().
+ *
+ */
+#define CHILLDUINO_PLANT_STATE_SIZE 19
+
+/**
+ * The number of event boundaries remembered while looking for a cycle.
+ *
+ */
+#define CHILLDUINO_SIMULATOR_BOUNDARIES 1024
+
+/**
+ * A simple refrigerator for the chillduino to control.
+ *
+ * The fresh food thermistor reading moves one count at a time at a
+ * rate that depends on what is running: it falls while the compressor
+ * runs, rises while the defrost runs and otherwise rises slowly. The
+ * reading is kept within the given limits. Everything is an integer so
+ * that a steady state repeats exactly.
+ *
+ * The evaporator can optionally keep cooling for a fixed time after the
+ * compressor stops, so that the reading coasts on past where it was
+ * when the compressor stopped.
+ *
+ * Frost can optionally build up on the evaporator while the compressor
+ * runs. Each defrost first spends a fixed time warming the evaporator,
+ * then the heater melts the frost. Once it is gone the bimetal opens,
+ * cutting the heater, and its switch toggles until the defrost is
+ * stopped. Without frost the heater is never cut.
+ *
+ */
+class ChillduinoPlant {
+  private:
+    int _reading;
+    int _minimumReading;
+    int _maximumReading;
+    unsigned long _warmingTicksPerCount;
+    unsigned long _coolingTicksPerCount;
+    unsigned long _defrostingTicksPerCount;
+    unsigned long _ticksPerCount;
+    unsigned long _remainingTicksForChange;
+    unsigned long _compressorTicksPerDefrostTick;
+    unsigned long _bimetalToggleTicks;
+    unsigned long _defrostWarmupTicks;
+    unsigned long _remainingTicksForWarmup;
+    unsigned long _frost;
+    unsigned long _remainingTicksForToggle;
+    unsigned long _coastTicks;
+    unsigned long _remainingTicksForCoast;
+    int _direction;
+    int _defrostSwitchReading;
+    bool _isCooling;
+    bool _isDefrosting;
+
+    bool isMelted(void) const {
+      return _remainingTicksForWarmup == 0 && _frost == 0;
+    }
+
+    unsigned long getTicksUntilMelted(void) const {
+      return (isHeating() && _compressorTicksPerDefrostTick > 0)
+        ? _remainingTicksForWarmup
+          + (_frost + _compressorTicksPerDefrostTick - 1)
+          / _compressorTicksPerDefrostTick
+        : CHILLDUINO_NEVER;
+    }
+
+    void toggleDefrostSwitch(void) {
+      _defrostSwitchReading ^= 1;
+      _remainingTicksForToggle = _bimetalToggleTicks;
+    }
+
+  public:
+
+    /**
+     * Creates a plant at the reading, kept within the limits.
+     *
+     */
+    ChillduinoPlant(int reading, int minimumReading, int maximumReading) :
+      _reading(reading),
+      _minimumReading(minimumReading),
+      _maximumReading(maximumReading),
+      _warmingTicksPerCount(0),
+      _coolingTicksPerCount(0),
+      _defrostingTicksPerCount(0),
+      _ticksPerCount(0),
+      _remainingTicksForChange(CHILLDUINO_NEVER),
+      _compressorTicksPerDefrostTick(0),
+      _bimetalToggleTicks(10),
+      _defrostWarmupTicks(0),
+      _remainingTicksForWarmup(0),
+      _frost(0),
+      _remainingTicksForToggle(CHILLDUINO_NEVER),
+      _coastTicks(0),
+      _remainingTicksForCoast(0),
+      _direction(0),
+      _defrostSwitchReading(0),
+      _isCooling(false),
+      _isDefrosting(false) { }
+
+    /**
+     * Sets the ticks per count while nothing is running.
+     *
+     */
+    ChillduinoPlant& setWarmingTicksPerCount(unsigned long ticks) {
+      _warmingTicksPerCount = ticks;
+      return *this;
+    }
+
+    /**
+     * Sets the ticks per count while the compressor is running.
+     *
+     */
+    ChillduinoPlant& setCoolingTicksPerCount(unsigned long ticks) {
+      _coolingTicksPerCount = ticks;
+      return *this;
+    }
+
+    /**
+     * Sets the ticks per count while the defrost is running.
+     *
+     */
+    ChillduinoPlant& setDefrostingTicksPerCount(unsigned long ticks) {
+      _defrostingTicksPerCount = ticks;
+      return *this;
+    }
+
+    /**
+     * Sets the ticks the evaporator keeps cooling after the compressor
+     * stops.
+     *
+     */
+    ChillduinoPlant& setCoastTicks(unsigned long ticks) {
+      _coastTicks = ticks;
+      return *this;
+    }
+
+    /**
+     * Sets how many ticks of running compressor build up the frost that
+     * one tick of the defrost heater melts, enabling frost.
+     *
+     * Zero (the default) disables frost.
+     *
+     */
+    ChillduinoPlant& setCompressorTicksPerDefrostTick(unsigned long ticks) {
+      _compressorTicksPerDefrostTick = ticks;
+      return *this;
+    }
+
+    /**
+     * Sets the ticks each defrost heats the evaporator before the frost
+     * starts to melt.
+     *
+     */
+    ChillduinoPlant& setDefrostWarmupTicks(unsigned long ticks) {
+      _defrostWarmupTicks = ticks;
+      return *this;
+    }
+
+    /**
+     * Sets the ticks between toggles of the defrost switch while the
+     * bimetal is open.
+     *
+     */
+    ChillduinoPlant& setBimetalToggleTicks(unsigned long ticks) {
+      _bimetalToggleTicks = ticks;
+      return *this;
+    }
+
+    /**
+     * Gets the frost on the evaporator, in ticks of running compressor.
+     *
+     */
+    unsigned long getFrost(void) const {
+      return _frost;
+    }
+
+    /**
+     * Returns true if the defrost heater is drawing power.
+     *
+     */
+    bool isHeating(void) const {
+      return _isDefrosting
+        && (_compressorTicksPerDefrostTick == 0 || !isMelted());
+    }
+
+    /**
+     * Gets the current defrost switch reading.
+     *
+     */
+    int getDefrostSwitchReading(void) const {
+      return _defrostSwitchReading;
+    }
+
+    /**
+     * Gets the current thermistor reading.
+     *
+     */
+    int getReading(void) const {
+      return _reading;
+    }
+
+    /**
+     * Sets what is running for the following ticks.
+     *
+     * The time until the next change of reading restarts whenever the
+     * rate changes.
+     *
+     */
+    void setRunning(bool isCompressorRunning, bool isDefrostRunning) {
+      bool isDefrosting = isDefrostRunning && !isCompressorRunning;
+
+      if (isDefrosting && !_isDefrosting) {
+        _remainingTicksForWarmup = _defrostWarmupTicks;
+      }
+
+      if (isCompressorRunning || isDefrosting) {
+        _remainingTicksForCoast = 0;
+      }
+      else if (_isCooling) {
+        _remainingTicksForCoast = _coastTicks;
+      }
+
+      _isCooling = isCompressorRunning;
+      _isDefrosting = isDefrosting;
+
+      if (!_isDefrosting || _compressorTicksPerDefrostTick == 0) {
+        _remainingTicksForToggle = CHILLDUINO_NEVER;
+      }
+      else if (isMelted() && _remainingTicksForToggle == CHILLDUINO_NEVER) {
+        _remainingTicksForToggle = _bimetalToggleTicks;
+      }
+
+      bool isCoasting = _remainingTicksForCoast > 0;
+      int direction = (isCompressorRunning || isCoasting) ? -1 : 1;
+      unsigned long ticks = (isCompressorRunning || isCoasting)
+        ? _coolingTicksPerCount
+        : isHeating() ? _defrostingTicksPerCount
+        : _warmingTicksPerCount;
+
+      if (direction != _direction || ticks != _ticksPerCount ||
+          _remainingTicksForChange == CHILLDUINO_NEVER) {
+        _direction = direction;
+        _ticksPerCount = ticks;
+        _remainingTicksForChange = ticks;
+      }
+
+      if (ticks == 0 ||
+          (direction < 0 && _reading <= _minimumReading) ||
+          (direction > 0 && _reading >= _maximumReading)) {
+        _remainingTicksForChange = CHILLDUINO_NEVER;
+      }
+    }
+
+    /**
+     * Gets the number of ticks until the reading or the defrost switch
+     * changes, the frost has melted or the evaporator stops coasting.
+     *
+     */
+    unsigned long getTicksUntilChange(void) const {
+      unsigned long ticks = _remainingTicksForChange;
+
+      if (_remainingTicksForCoast > 0 && _remainingTicksForCoast < ticks) {
+        ticks = _remainingTicksForCoast;
+      }
+
+      if (_remainingTicksForToggle < ticks) {
+        ticks = _remainingTicksForToggle;
+      }
+
+      if (getTicksUntilMelted() < ticks) {
+        ticks = getTicksUntilMelted();
+      }
+
+      return ticks;
+    }
+
+    /**
+     * Causes no more than getTicksUntilChange() ticks to elapse.
+     *
+     */
+    void elapse(unsigned long ticks) {
+      if (_compressorTicksPerDefrostTick > 0) {
+        if (_isCooling) {
+          _frost += ticks;
+        }
+        else if (isHeating()) {
+          unsigned long warming = (_remainingTicksForWarmup < ticks)
+            ? _remainingTicksForWarmup : ticks;
+          unsigned long melted = (ticks - warming)
+            * _compressorTicksPerDefrostTick;
+
+          _remainingTicksForWarmup -= warming;
+          _frost = (_frost > melted) ? _frost - melted : 0;
+
+          if (isMelted()) {
+            toggleDefrostSwitch();
+          }
+        }
+        else if (_remainingTicksForToggle != CHILLDUINO_NEVER) {
+          _remainingTicksForToggle -= ticks;
+
+          if (_remainingTicksForToggle == 0) {
+            toggleDefrostSwitch();
+          }
+        }
+      }
+
+      if (_remainingTicksForCoast > 0) {
+        _remainingTicksForCoast -= ticks;
+      }
+
+      if (_remainingTicksForChange != CHILLDUINO_NEVER) {
+        _remainingTicksForChange -= ticks;
+
+        if (_remainingTicksForChange == 0) {
+          _reading += _direction;
+          _remainingTicksForChange = CHILLDUINO_NEVER;
+        }
+      }
+    }
+
+    /**
+     * Copies the values that determine the behavior of the plant into
+     * the state and returns the number of values.
+     *
+     */
+    unsigned int getState(unsigned long *state) const {
+      state[0] = _reading;
+      state[1] = _minimumReading;
+      state[2] = _maximumReading;
+      state[3] = _warmingTicksPerCount;
+      state[4] = _coolingTicksPerCount;
+      state[5] = _defrostingTicksPerCount;
+      state[6] = _ticksPerCount;
+      state[7] = _remainingTicksForChange;
+      state[8] = _direction;
+      state[9] = _compressorTicksPerDefrostTick;
+      state[10] = _bimetalToggleTicks;
+      state[11] = _frost;
+      state[12] = _remainingTicksForToggle;
+      state[13] = _defrostSwitchReading;
+      state[14] = (_isCooling << 0) | (_isDefrosting << 1);
+      state[15] = _defrostWarmupTicks;
+      state[16] = _remainingTicksForWarmup;
+      state[17] = _coastTicks;
+      state[18] = _remainingTicksForCoast;
+      return CHILLDUINO_PLANT_STATE_SIZE;
+    }
+};
+
+/**
+ * The totals accumulated by a simulation.
+ *
+ */
+struct ChillduinoTotals {
+  unsigned long ticks;
+  unsigned long compressorTicks;
+  unsigned long defrostTicks;
+  unsigned long heaterTicks;
+  unsigned long compressorStarts;
+  unsigned long defrosts;
+};
+
+/**
+ * Simulates a chillduino controlling a plant.
+ *
+ * The simulation jumps from event to event, where an event is either
+ * a change of the thermistor reading or the expiry of a chillduino
+ * timer. When cycle detection is enabled the complete state is
+ * remembered at every change of the chillduino outputs. Once a state
+ * repeats the simulation is on a periodic orbit, so as many whole
+ * periods as fit in the remaining time are skipped at once and their
+ * totals added by multiplication. Only the remainder is simulated.
+ *
+ * The chillduino's own statistics are not extrapolated, so they should
+ * be left disabled when cycle detection is enabled.
+ *
+ */
+class ChillduinoSimulator {
+  private:
+    struct Boundary {
+      unsigned long hash;
+      ChillduinoTotals totals;
+      unsigned long state[CHILLDUINO_STATE_SIZE + CHILLDUINO_PLANT_STATE_SIZE];
+    };
+
+    Chillduino _chillduino;
+    ChillduinoPlant _plant;
+    ChillduinoTotals _totals;
+    Boundary *_boundaries;
+    unsigned long _extrapolatedPeriods;
+    bool _isQuiescent;
+
+    ChillduinoSimulator(const ChillduinoSimulator &);
+    ChillduinoSimulator &operator=(const ChillduinoSimulator &);
+
+    static unsigned long hash(const unsigned long *state, unsigned int size) {
+      unsigned long h = 2166136261UL;
+
+      for (unsigned int i = 0; i < size; i++) {
+        h = (h ^ state[i]) * 16777619UL;
+      }
+
+      return h | 1;
+    }
+
+    unsigned long extrapolate(unsigned long ticks) {
+      Boundary current;
+
+      unsigned int size = _chillduino.getState(current.state);
+      size += _plant.getState(current.state + size);
+      current.hash = hash(current.state, size);
+      current.totals = _totals;
+
+      Boundary &previous =
+        _boundaries[current.hash % CHILLDUINO_SIMULATOR_BOUNDARIES];
+
+      if (previous.hash == current.hash &&
+          memcmp(previous.state, current.state, sizeof(current.state)) == 0) {
+        unsigned long period = _totals.ticks - previous.totals.ticks;
+        unsigned long periods = ticks / period;
+
+        _totals.ticks += periods * period;
+        _totals.compressorTicks += periods *
+          (_totals.compressorTicks - previous.totals.compressorTicks);
+        _totals.defrostTicks += periods *
+          (_totals.defrostTicks - previous.totals.defrostTicks);
+        _totals.heaterTicks += periods *
+          (_totals.heaterTicks - previous.totals.heaterTicks);
+        _totals.compressorStarts += periods *
+          (_totals.compressorStarts - previous.totals.compressorStarts);
+        _totals.defrosts += periods *
+          (_totals.defrosts - previous.totals.defrosts);
+
+        _extrapolatedPeriods += periods;
+        ticks -= periods * period;
+        current.totals = _totals;
+      }
+
+      previous = current;
+      return ticks;
+    }
+
+  public:
+
+    /**
+     * Creates a simulation of the chillduino controlling the plant.
+     *
+     */
+    ChillduinoSimulator(const Chillduino &chillduino,
+        const ChillduinoPlant &plant) :
+      _chillduino(chillduino),
+      _plant(plant),
+      _totals(),
+      _boundaries(0),
+      _extrapolatedPeriods(0),
+      _isQuiescent(false) {
+      _chillduino.setCurrentFreshFoodThermistorReading(_plant.getReading());
+      _chillduino.setDefrostSwitchReading(_plant.getDefrostSwitchReading());
+    }
+
+    ~ChillduinoSimulator(void) {
+      delete[] _boundaries;
+    }
+
+    /**
+     * Enables or disables cycle detection.
+     *
+     */
+    ChillduinoSimulator& setCycleDetectionEnabled(bool isEnabled) {
+      delete[] _boundaries;
+      _boundaries = 0;
+
+      if (isEnabled) {
+        _boundaries = new Boundary[CHILLDUINO_SIMULATOR_BOUNDARIES];
+        memset(_boundaries, 0,
+          CHILLDUINO_SIMULATOR_BOUNDARIES * sizeof(Boundary));
+      }
+
+      return *this;
+    }
+
+    /**
+     * Gets the simulated chillduino.
+     *
+     * Inputs may be changed between calls to elapse().
+     *
+     */
+    Chillduino &getChillduino(void) {
+      _isQuiescent = false;
+      return _chillduino;
+    }
+
+    /**
+     * Gets the simulated plant.
+     *
+     */
+    const ChillduinoPlant &getPlant(void) const {
+      return _plant;
+    }
+
+    /**
+     * Gets the totals accumulated so far.
+     *
+     */
+    const ChillduinoTotals &getTotals(void) const {
+      return _totals;
+    }
+
+    /**
+     * Gets the number of whole periods that were extrapolated.
+     *
+     */
+    unsigned long getExtrapolatedPeriods(void) const {
+      return _extrapolatedPeriods;
+    }
+
+    /**
+     * Causes the amount of time (in ticks) to elapse.
+     *
+     * Each tick the plant responds to what was running at the end of
+     * the previous tick, then the chillduino ticks and loops once with
+     * the new reading.
+     *
+     */
+    void elapse(unsigned long ticks) {
+      while (ticks > 0) {
+        bool isCompressorRunning = _chillduino.isCompressorRunning();
+        bool isDefrostRunning = _chillduino.isDefrostRunning();
+        unsigned long step = _isQuiescent
+          ? _chillduino.getTicksUntilNextEvent() : 1;
+
+        _plant.setRunning(isCompressorRunning, isDefrostRunning);
+        bool isHeating = _plant.isHeating();
+
+        bool isReadingChanged = _plant.getTicksUntilChange() <= step &&
+          _plant.getTicksUntilChange() <= ticks;
+
+        if (isReadingChanged) {
+          step = _plant.getTicksUntilChange();
+        }
+        else if (step > ticks) {
+          step = ticks;
+        }
+
+        _plant.elapse(step);
+
+        if (isReadingChanged) {
+          _chillduino.elapse(step - 1);
+          _chillduino.setCurrentFreshFoodThermistorReading(_plant.getReading());
+          _chillduino.setDefrostSwitchReading(_plant.getDefrostSwitchReading());
+          _chillduino.elapse(1);
+        }
+        else {
+          _chillduino.elapse(step);
+        }
+
+        ticks -= step;
+        _totals.ticks += step;
+
+        if (isCompressorRunning) {
+          _totals.compressorTicks += step;
+        }
+        else if (_chillduino.isCompressorRunning()) {
+          _totals.compressorStarts++;
+        }
+
+        if (isHeating) {
+          _totals.heaterTicks += step;
+        }
+
+        if (isDefrostRunning) {
+          _totals.defrostTicks += step;
+        }
+        else if (_chillduino.isDefrostRunning()) {
+          _totals.defrosts++;
+        }
+
+        _isQuiescent = !_chillduino.isChanged();
+
+        if (!_isQuiescent && _boundaries) {
+          ticks = extrapolate(ticks);
+        }
+      }
+    }
+};
+
+#endif /* CHILLDUINO_SIMULATOR_H */
@@ -0,0 +1,150 @@
+/**
+ * Copyright (c) 2015 FirstBuild
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef CHILLHUB_FRAME_H
+#define CHILLHUB_FRAME_H
+
+/**
+ * The ChillHub data types carried in the third byte of a frame.
+ *
+ */
+#define CHILLHUB_ARRAY_DATA_TYPE  0x01
+#define CHILLHUB_STRING_DATA_TYPE 0x02
+#define CHILLHUB_U8_DATA_TYPE     0x03
+#define CHILLHUB_U16_DATA_TYPE    0x05
+
+/**
+ * The ChillHub message type used to announce a device.
+ *
+ */
+#define CHILLHUB_DEVICE_ID_TYPE   0x01
+
+/**
+ * A single ChillHub message.
+ *
+ * The payload points into the buffer that was parsed, so a frame is
+ * only valid for as long as that buffer is left untouched.
+ *
+ */
+struct ChillhubFrame {
+  unsigned char type;
+  unsigned char dataType;
+  const unsigned char *payload;
+  unsigned int length;
+};
+
+/**
+ * Splits a buffer of serial bytes into ChillHub frames without copying.
+ *
+ * Each frame starts with the number of bytes that follow it, then the
+ * message type, the data type and the payload. A length too short to
+ * hold the message and data types is skipped so the parser can resync.
+ *
+ */
+class ChillhubFrameParser {
+  private:
+    const unsigned char *_buffer;
+    unsigned int _length;
+    unsigned int _position;
+
+  public:
+
+    /**
+     * Creates a parser for the received bytes.
+     *
+     */
+    ChillhubFrameParser(const unsigned char *buffer, unsigned int length) :
+      _buffer(buffer),
+      _length(length),
+      _position(0) { }
+
+    /**
+     * Parses the next complete frame.
+     *
+     * Returns false once the remaining bytes do not hold a complete
+     * frame. Those bytes should be kept and parsed again once more
+     * bytes have been received.
+     *
+     */
+    bool next(ChillhubFrame &frame) {
+      while (_position < _length) {
+        unsigned int size = _buffer[_position];
+
+        if (size < 2) {
+          _position++;
+          continue;
+        }
+
+        if (_position + 1 + size > _length) {
+          return false;
+        }
+
+        frame.type = _buffer[_position + 1];
+        frame.dataType = _buffer[_position + 2];
+        frame.payload = _buffer + _position + 3;
+        frame.length = size - 2;
+        _position += 1 + size;
+        return true;
+      }
+
+      return false;
+    }
+
+    /**
+     * Gets the number of bytes consumed by the parsed frames.
+     *
+     */
+    unsigned int getConsumed(void) const {
+      return _position;
+    }
+};
+
+/**
+ * Reads the big endian payload of a U16 frame.
+ *
+ */
+inline unsigned int chillhubReadU16(const ChillhubFrame &frame) {
+  if (frame.length < 2) {
+    return 0;
+  }
+
+  return (frame.payload[0] << 8) | frame.payload[1];
+}
+
+/**
+ * Writes a U16 frame into the buffer and returns its size.
+ *
+ * The buffer must hold at least five bytes.
+ *
+ */
+inline unsigned int chillhubWriteU16(unsigned char *buffer,
+    unsigned char type, unsigned int value) {
+  buffer[0] = 4;
+  buffer[1] = type;
+  buffer[2] = CHILLHUB_U16_DATA_TYPE;
+  buffer[3] = (unsigned char) (value >> 8);
+  buffer[4] = (unsigned char) value;
+  return 5;
+}
+
+#endif /* CHILLHUB_FRAME_H */
@@ -0,0 +1,296 @@
+/**
+ * Copyright (c) 2015 FirstBuild
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/**
+ * Collects ChillHub telemetry from many devices at once.
+ *
+ * Each device connects to a UNIX socket and streams the same frames it
+ * would send over serial, starting with its device id. Connections are
+ * served by a single thread using edge triggered epoll. Frames are
+ * parsed in place in the receive buffer of each connection and applied
+ * to a ChillduinoDeviceTable and to a ChillduinoAnomalyDetector. Once a
+ * second the detector takes a sample and the collector prints the
+ * number of devices, the messages ingested per second, the 99th
+ * percentile time from a read returning to its frames being applied
+ * and the number of devices flagged for each anomaly.
+ *
+ * Usage: collector <socket> [capacity]
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#include <chillduino_thermistor.h>
+#include <host/chillduino_anomalies.h>
+#include <host/chillduino_devices.h>
+
+#define BUFFER_SIZE        4096
+#define MAXIMUM_EVENTS     1024
+#define LATENCY_BUCKET_NS  64
+#define LATENCY_BUCKETS    4096
+
+// the limits are in one second samples; the cold end of the warmest
+// band is used for every device, since the collector does not know
+// which mode each one is in
+#define COMPRESSOR_RUN_LIMIT  (2 * 60 * 60)
+#define DOOR_OPEN_LIMIT       (30 * 60)
+#define DEFROST_TIMEOUT_LIMIT 2
+#define COLD_TEMPERATURE      59
+
+struct Connection {
+  int fd;
+  long device;
+  unsigned int length;
+  unsigned char buffer[BUFFER_SIZE];
+};
+
+static unsigned long latencies[LATENCY_BUCKETS + 1];
+static volatile sig_atomic_t running = 1;
+
+static void stop(int signal) {
+  (void) signal;
+  running = 0;
+}
+
+static unsigned long now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+
+static void record(unsigned long ns) {
+  unsigned long bucket = ns / LATENCY_BUCKET_NS;
+  latencies[bucket < LATENCY_BUCKETS ? bucket : LATENCY_BUCKETS]++;
+}
+
+static unsigned long percentile(unsigned long permille) {
+  unsigned long total = 0;
+  unsigned long seen = 0;
+
+  for (int i = 0; i <= LATENCY_BUCKETS; i++) {
+    total += latencies[i];
+  }
+
+  for (int i = 0; i <= LATENCY_BUCKETS; i++) {
+    seen += latencies[i];
+
+    if (seen * 1000 >= total * permille) {
+      return (i + 1) * LATENCY_BUCKET_NS;
+    }
+  }
+
+  return 0;
+}
+
+static unsigned long ingest(ChillduinoDeviceTable &devices,
+    ChillduinoAnomalyDetector &detector, Connection &connection) {
+  ChillhubFrameParser parser(connection.buffer, connection.length);
+  ChillhubFrame frame;
+  unsigned long messages = 0;
+
+  while (parser.next(frame)) {
+    messages++;
+
+    if (frame.type == CHILLHUB_DEVICE_ID_TYPE) {
+      unsigned char uuid[16];
+
+      if (chillduinoParseUuid(frame.payload, frame.length, uuid)) {
+        connection.device = devices.insert(uuid);
+      }
+    }
+    else if (connection.device >= 0) {
+      devices.update(connection.device, frame);
+      detector.update(connection.device, frame);
+    }
+  }
+
+  // only a partial frame is ever moved
+  connection.length -= parser.getConsumed();
+  memmove(connection.buffer, connection.buffer + parser.getConsumed(),
+    connection.length);
+
+  return messages;
+}
+
+static int listen_on(const char *path) {
+  struct sockaddr_un address;
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+  unlink(path);
+
+  if (fd < 0 ||
+      bind(fd, (struct sockaddr *) &address, sizeof(address)) < 0 ||
+      listen(fd, SOMAXCONN) < 0) {
+    perror(path);
+    exit(1);
+  }
+
+  return fd;
+}
+
+static void raise_file_limit(void) {
+  struct rlimit limit;
+
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+  }
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s <socket> [capacity]\n", argv[0]);
+    return 1;
+  }
+
+  ChillduinoDeviceTable devices(argc > 2 ? strtoul(argv[2], 0, 0) : 65536);
+  ChillduinoAnomalyDetector detector(devices.getCapacity(),
+    chillduinoThermistorReading(COLD_TEMPERATURE));
+  struct epoll_event events[MAXIMUM_EVENTS];
+  struct epoll_event event;
+  int listener = listen_on(argv[1]);
+  int poll = epoll_create1(0);
+  unsigned long messages = 0;
+  unsigned long reported = now();
+
+  detector
+    .setCompressorRunLimit(COMPRESSOR_RUN_LIMIT)
+    .setDoorOpenLimit(DOOR_OPEN_LIMIT)
+    .setDefrostTimeoutLimit(DEFROST_TIMEOUT_LIMIT);
+
+  raise_file_limit();
+  signal(SIGINT, stop);
+  signal(SIGTERM, stop);
+  signal(SIGPIPE, SIG_IGN);
+
+  event.events = EPOLLIN;
+  event.data.ptr = 0;
+
+  if (poll < 0 || epoll_ctl(poll, EPOLL_CTL_ADD, listener, &event) < 0) {
+    perror("epoll");
+    return 1;
+  }
+
+  while (running) {
+    int count = epoll_wait(poll, events, MAXIMUM_EVENTS, 100);
+
+    for (int i = 0; i < count; i++) {
+      Connection *connection = (Connection *) events[i].data.ptr;
+
+      if (connection == 0) {
+        int fd;
+
+        while ((fd = accept4(listener, 0, 0, SOCK_NONBLOCK)) >= 0) {
+          connection = (Connection *) malloc(sizeof(Connection));
+
+          if (connection == 0) {
+            close(fd);
+            continue;
+          }
+
+          connection->fd = fd;
+          connection->device = -1;
+          connection->length = 0;
+
+          event.events = EPOLLIN | EPOLLET;
+          event.data.ptr = connection;
+
+          if (epoll_ctl(poll, EPOLL_CTL_ADD, fd, &event) < 0) {
+            perror("epoll_ctl");
+            close(fd);
+            free(connection);
+          }
+        }
+
+        continue;
+      }
+
+      for (;;) {
+        ssize_t received = read(connection->fd,
+          connection->buffer + connection->length,
+          BUFFER_SIZE - connection->length);
+
+        if (received > 0) {
+          unsigned long started = now();
+          connection->length += received;
+          messages += ingest(devices, detector, *connection);
+          record(now() - started);
+        }
+        else if (received < 0 && errno == EINTR) {
+          continue;
+        }
+        else if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+          break;
+        }
+        else {
+          close(connection->fd);
+          free(connection);
+          break;
+        }
+      }
+    }
+
+    unsigned long current = now();
+
+    if (current - reported >= 1000000000UL) {
+      unsigned long flagged[3] = { 0, 0, 0 };
+
+      detector.sample();
+
+      for (unsigned long d = 0; d < detector.getCapacity(); d++) {
+        int32_t anomalies = detector.getAnomalies(d);
+
+        flagged[0] += (anomalies & CHILLDUINO_ANOMALY_COMPRESSOR_STUCK) != 0;
+        flagged[1] += (anomalies & CHILLDUINO_ANOMALY_DOOR_STUCK) != 0;
+        flagged[2] += (anomalies & CHILLDUINO_ANOMALY_DEFROST_FAILING) != 0;
+      }
+
+      printf("devices %lu messages/s %lu p99 %luns"
+        " compressor %lu door %lu defrost %lu\n",
+        devices.getCount(),
+        messages * 1000000000UL / (current - reported),
+        percentile(990), flagged[0], flagged[1], flagged[2]);
+      fflush(stdout);
+
+      memset(latencies, 0, sizeof(latencies));
+      messages = 0;
+      reported = current;
+    }
+  }
+
+  unlink(argv[1]);
+  return 0;
+}
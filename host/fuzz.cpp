@@ -0,0 +1,115 @@
+/**
+ * Copyright (c) 2015 FirstBuild
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/**
+ * A fuzzing harness for the chillduino safety invariants.
+ *
+ * Built with -DCHILLDUINO_LIBFUZZER and -fsanitize=fuzzer this is a
+ * libFuzzer target. Otherwise it replays the files given as arguments,
+ * or with no arguments runs random schedules of up to
+ * FUZZ_MAXIMUM_SIZE bytes and reports the rate. The cost of a run
+ * grows with its length, so libFuzzer should be given the same limit.
+ *
+ *   clang++ -I. -DCHILLDUINO_LIBFUZZER -fsanitize=fuzzer,address \
+ *     -o fuzz host/fuzz.cpp
+ *   ./fuzz -max_len=64
+ *
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <host/chillduino_fuzzer.h>
+
+#define FUZZ_RUNS        1000000
+#define FUZZ_MAXIMUM_SIZE 64
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  chillduinoFuzz(data, size);
+  return 0;
+}
+
+#ifndef CHILLDUINO_LIBFUZZER
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int replay(const char *path) {
+  static unsigned char data[1 << 20];
+  FILE *file = fopen(path, "rb");
+
+  if (file == NULL) {
+    perror(path);
+    return 1;
+  }
+
+  size_t size = fread(data, 1, sizeof(data), file);
+  fclose(file);
+
+  printf("%s: %lu steps\n", path, chillduinoFuzz(data, size));
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  unsigned char data[FUZZ_MAXIMUM_SIZE];
+  unsigned long random = 1;
+  unsigned long steps = 0;
+
+  if (argc > 1) {
+    int status = 0;
+
+    for (int i = 1; i < argc; i++) {
+      status |= replay(argv[i]);
+    }
+
+    return status;
+  }
+
+  double started = now();
+
+  for (unsigned long run = 0; run < FUZZ_RUNS; run++) {
+    unsigned long size;
+
+    random = random * 1103515245 + 12345;
+    size = CHILLDUINO_FUZZER_HEADER_SIZE + (random >> 16) %
+      (FUZZ_MAXIMUM_SIZE - CHILLDUINO_FUZZER_HEADER_SIZE);
+
+    for (unsigned long i = 0; i < size; i++) {
+      random = random * 1103515245 + 12345;
+      data[i] = random >> 16;
+    }
+
+    steps += chillduinoFuzz(data, size);
+  }
+
+  double seconds = now() - started;
+
+  printf("%d runs in %.3f s, %.0f runs/s, %.1f steps/run\n", FUZZ_RUNS,
+    seconds, FUZZ_RUNS / seconds, (double) steps / FUZZ_RUNS);
+  return 0;
+}
+
+#endif
@@ -0,0 +1,212 @@
+/**
+ * Copyright (c) 2015 FirstBuild
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/**
+ * Simulates many devices streaming telemetry to the collector.
+ *
+ * Each simulated device opens its own connection to the collector's
+ * UNIX socket, announces a UUID derived from its index, then sends
+ * batches of thermistor, compressor, defrost, door and bimetal updates
+ * as fast as the collector accepts them. The number of messages sent
+ * per second is printed when the run completes.
+ *
+ * Usage: loadgen <socket> <devices> <seconds>
+ *
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#include <host/chillduino_devices.h>
+
+#define FRAMES_PER_BATCH 16
+
+struct Device {
+  int fd;
+  unsigned int thermistor;
+  unsigned long random;
+};
+
+static unsigned long now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+
+static bool write_all(int fd, const unsigned char *data, size_t length) {
+  while (length > 0) {
+    ssize_t written = write(fd, data, length);
+
+    if (written < 0 && errno == EINTR) {
+      continue;
+    }
+
+    if (written <= 0) {
+      return false;
+    }
+
+    data += written;
+    length -= written;
+  }
+
+  return true;
+}
+
+static unsigned long next_random(unsigned long &state) {
+  state = state * 6364136223846793005UL + 1442695040888963407UL;
+  return state >> 33;
+}
+
+static int connect_to(const char *path) {
+  struct sockaddr_un address;
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+
+  if (fd < 0 || connect(fd, (struct sockaddr *) &address, sizeof(address)) < 0) {
+    perror(path);
+    exit(1);
+  }
+
+  return fd;
+}
+
+static void announce(Device &device, unsigned long index) {
+  static const char hex[] = "0123456789abcdef";
+  unsigned char frame[64];
+  char *uuid = (char *) frame + 3;
+  unsigned long state = index + 1;
+
+  frame[0] = 2 + 36;
+  frame[1] = CHILLHUB_DEVICE_ID_TYPE;
+  frame[2] = CHILLHUB_STRING_DATA_TYPE;
+
+  for (int i = 0; i < 36; i++) {
+    uuid[i] = (i == 8 || i == 13 || i == 18 || i == 23)
+      ? '-' : hex[next_random(state) & 0xF];
+  }
+
+  uuid[14] = '4';
+
+  if (!write_all(device.fd, frame, 3 + 36)) {
+    perror("announce");
+    exit(1);
+  }
+}
+
+static unsigned int batch(Device &device, unsigned char *buffer) {
+  unsigned int length = 0;
+
+  for (int i = 0; i < FRAMES_PER_BATCH; i++) {
+    unsigned long r = next_random(device.random);
+
+    switch (r & 7) {
+      case 0:
+        length += chillhubWriteU16(buffer + length,
+          CHILLDUINO_COMPRESSOR_ID, (r >> 3) & 1);
+        break;
+
+      case 1:
+        length += chillhubWriteU16(buffer + length,
+          CHILLDUINO_DEFROST_ID, (r >> 3) & 1);
+        break;
+
+      case 2:
+        length += chillhubWriteU16(buffer + length,
+          CHILLDUINO_DOOR_ID, (r >> 3) & 1);
+        break;
+
+      case 3:
+        length += chillhubWriteU16(buffer + length,
+          CHILLDUINO_BIMETAL_ID, (r >> 3) & 1);
+        break;
+
+      default:
+        device.thermistor += ((r >> 3) % 5) - 2;
+        length += chillhubWriteU16(buffer + length,
+          CHILLDUINO_THERMISTOR_ID, device.thermistor);
+        break;
+    }
+  }
+
+  return length;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 4) {
+    fprintf(stderr, "usage: %s <socket> <devices> <seconds>\n", argv[0]);
+    return 1;
+  }
+
+  unsigned long count = strtoul(argv[2], 0, 0);
+  time_t finished = time(0) + strtoul(argv[3], 0, 0);
+  Device *devices = new Device[count];
+  unsigned char buffer[FRAMES_PER_BATCH * 5];
+  unsigned long messages = 0;
+  struct rlimit limit;
+
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+  }
+
+  for (unsigned long i = 0; i < count; i++) {
+    devices[i].fd = connect_to(argv[1]);
+    devices[i].thermistor = 380;
+    devices[i].random = i * 2654435761UL + 1;
+    announce(devices[i], i);
+  }
+
+  unsigned long started = now();
+
+  while (time(0) < finished) {
+    for (unsigned long i = 0; i < count; i++) {
+      unsigned int length = batch(devices[i], buffer);
+
+      if (write(devices[i].fd, buffer, length) == (ssize_t) length) {
+        messages += FRAMES_PER_BATCH;
+      }
+    }
+  }
+
+  unsigned long elapsed = now() - started;
+
+  // a run of zero seconds may not measure any time at all
+  printf("devices %lu messages/s %lu\n", count, (unsigned long)
+    (messages * 1e9 / (elapsed > 0 ? elapsed : 1)));
+
+  for (unsigned long i = 0; i < count; i++) {
+    close(devices[i].fd);
+  }
+
+  delete[] devices;
+  return 0;
+}
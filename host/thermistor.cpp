@@ -0,0 +1,133 @@
+/**
+ * Copyright (c) 2015 FirstBuild
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/**
+ * Generates the thermistor calibration table.
+ *
+ * The table gives the temperature (in tenths of a degree Celsius) at
+ * every sixteenth reading of the 10-bit ADC, computed from the beta
+ * equation for an NTC thermistor between the supply and the ADC pin,
+ * with the series resistor between the ADC pin and ground. The reading
+ * therefore rises with the temperature. Temperatures beyond the range
+ * of the thermistor are clamped. Regenerate the table with:
+ *
+ *   scons thermistor
+ *
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NOMINAL_TEMPERATURE 25.0
+#define KELVIN              273.15
+#define ADC_READINGS        1024
+#define STEP_BITS           4
+#define MINIMUM_TEMPERATURE (-400)
+#define MAXIMUM_TEMPERATURE 1250
+
+static int temperature(double beta, double nominal, double series,
+    int reading) {
+  if (reading <= 0) {
+    return MINIMUM_TEMPERATURE;
+  }
+
+  if (reading >= ADC_READINGS) {
+    return MAXIMUM_TEMPERATURE;
+  }
+
+  double resistance = series * ((double) ADC_READINGS / reading - 1);
+  double kelvin = 1 / (1 / (NOMINAL_TEMPERATURE + KELVIN)
+    + log(resistance / nominal) / beta);
+  double tenths = floor((kelvin - KELVIN) * 10 + 0.5);
+
+  if (tenths < MINIMUM_TEMPERATURE) {
+    return MINIMUM_TEMPERATURE;
+  }
+
+  if (tenths > MAXIMUM_TEMPERATURE) {
+    return MAXIMUM_TEMPERATURE;
+  }
+
+  return (int) tenths;
+}
+
+int main(int argc, char **argv) {
+  long beta = (argc > 1) ? atol(argv[1]) : 3950;
+  long nominal = (argc > 2) ? atol(argv[2]) : 10000;
+  long series = (argc > 3) ? atol(argv[3]) : 10000;
+  int size = (ADC_READINGS >> STEP_BITS) + 1;
+
+  if (argc > 4 || beta <= 0 || nominal <= 0 || series <= 0) {
+    fprintf(stderr, "usage: %s [beta] [nominal ohms] [series ohms]\n",
+      argv[0]);
+    return 1;
+  }
+
+  FILE *license = fopen("LICENSE", "r");
+  printf("/**\n");
+
+  if (license != NULL) {
+    char line[256];
+    bool isCopyright = false;
+
+    while (fgets(line, sizeof(line), license) != NULL) {
+      isCopyright = isCopyright || strncmp(line, "Copyright", 9) == 0;
+
+      if (isCopyright) {
+        printf(line[0] == '\n' ? " *\n" : " * %s", line);
+      }
+    }
+
+    fclose(license);
+  }
+
+  printf(" */\n\n");
+  printf("#ifndef CHILLDUINO_THERMISTOR_TABLE_H\n");
+  printf("#define CHILLDUINO_THERMISTOR_TABLE_H\n\n");
+  printf("#include \"chillduino_progmem.h\"\n\n");
+  printf("/**\n");
+  printf(" * The thermistor calibration table.\n");
+  printf(" *\n");
+  printf(" * Generated by host/thermistor.cpp, do not edit.\n");
+  printf(" *\n");
+  printf(" */\n");
+  printf("#define CHILLDUINO_THERMISTOR_BETA               %ld\n", beta);
+  printf("#define CHILLDUINO_THERMISTOR_NOMINAL_RESISTANCE %ld\n", nominal);
+  printf("#define CHILLDUINO_THERMISTOR_SERIES_RESISTANCE  %ld\n", series);
+  printf("#define CHILLDUINO_THERMISTOR_STEP_BITS          %d\n", STEP_BITS);
+  printf("#define CHILLDUINO_THERMISTOR_TABLE_SIZE         %d\n\n", size);
+  printf("static const short CHILLDUINO_THERMISTOR_TABLE"
+    "[CHILLDUINO_THERMISTOR_TABLE_SIZE] PROGMEM = {");
+
+  for (int i = 0; i < size; i++) {
+    printf("%s%5d%s", (i % 8 == 0) ? "\n  " : " ",
+      temperature(beta, nominal, series, i << STEP_BITS),
+      (i + 1 < size) ? "," : "");
+  }
+
+  printf("\n};\n\n");
+  printf("#endif /* CHILLDUINO_THERMISTOR_TABLE_H */\n");
+  return 0;
+}
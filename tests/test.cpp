@@ -21,8 +21,26 @@
  *
  */
 
+#define CHILLDUINO_STATISTICS
+
 #include <chillduino.h>
+#include <chillduino_configuration.h>
+#include <chillduino_pins.h>
+#include <chillduino_series.h>
+#include <chillduino_zones.h>
+#include <host/chillduino_anomalies.h>
+#include <host/chillduino_building.h>
+#include <host/chillduino_columns.h>
+#include <host/chillduino_devices.h>
+#include <host/chillduino_fleet.h>
+#include <host/chillduino_fuzzer.h>
+#include <host/chillduino_scenario.h>
+#include <host/chillduino_simulator.h>
 #include <assert.h>
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
 
 #define TICKS_PER_SECOND   ((unsigned long) 1000)
 #define TICKS_PER_MINUTE   (60 * TICKS_PER_SECOND)
@@ -415,6 +433,1649 @@ void shouldPersistCompressorRuntime(void) {
     TICKS_PER_HOUR);
 }
 
+void shouldEncodeSlowlyChangingReadingsInOneBytePerSample(void) {
+  ChillduinoSeries<64> series;
+  const int samples[] = { 380, 381, 379, 379, 330, 1023, 0, 417 };
+  int sample;
+
+  for (int i = 0; i < 8; i++) {
+    assert(series.push(samples[i]));
+  }
+
+  assert(series.getCount() == 8);
+  assert(series.getLength() == 12);
+
+  ChillduinoSeriesDecoder decoder(series.getBuffer(), series.getLength());
+
+  for (int i = 0; i < 8; i++) {
+    assert(decoder.next(sample));
+    assert(sample == samples[i]);
+  }
+
+  assert(!decoder.next(sample));
+}
+
+void shouldRejectSamplesWhenSeriesIsFull(void) {
+  ChillduinoSeries<16> series;
+  unsigned int count = 0;
+
+  while (series.push(400 + (count & 1))) {
+    count++;
+  }
+
+  assert(series.isFull());
+  assert(series.getCount() == count);
+  assert(series.getLength() <= 16);
+
+  series.clear();
+  assert(!series.isFull());
+  assert(series.getCount() == 0);
+  assert(series.push(400));
+  assert(series.getLength() == 2);
+}
+
+void shouldParseFramesInPlaceAndKeepPartialFrames(void) {
+  unsigned char buffer[16];
+  unsigned int length = chillhubWriteU16(buffer, 0x91, 380);
+  ChillhubFrame frame;
+
+  buffer[length++] = 0;
+  length += chillhubWriteU16(buffer + length, 0x92, 1);
+
+  ChillhubFrameParser parser(buffer, length - 2);
+
+  assert(parser.next(frame));
+  assert(frame.type == 0x91);
+  assert(frame.dataType == CHILLHUB_U16_DATA_TYPE);
+  assert(frame.payload == buffer + 3);
+  assert(chillhubReadU16(frame) == 380);
+
+  assert(!parser.next(frame));
+  assert(parser.getConsumed() == 6);
+}
+
+void shouldTrackDevicesByUuid(void) {
+  static const char id[] = "chillduino 12345678-9abc-4def-8f01-0203040506ff";
+  ChillduinoDeviceTable devices(4);
+  unsigned char uuid[16];
+  unsigned char buffer[8];
+  ChillhubFrame frame;
+
+  assert(chillduinoParseUuid((const unsigned char *) id, sizeof(id) - 1, uuid));
+  assert(uuid[0] == 0x12 && uuid[6] == 0x4d && uuid[15] == 0xff);
+  assert(devices.find(uuid) == -1);
+
+  long index = devices.insert(uuid);
+  assert(index >= 0);
+  assert(devices.insert(uuid) == index);
+  assert(devices.find(uuid) == index);
+  assert(devices.getCount() == 1);
+
+  chillhubWriteU16(buffer, CHILLDUINO_COMPRESSOR_ID, 1);
+  ChillhubFrameParser(buffer, 5).next(frame);
+  devices.update(index, frame);
+  devices.update(index, frame);
+
+  chillhubWriteU16(buffer, CHILLDUINO_THERMISTOR_ID, 400);
+  ChillhubFrameParser(buffer, 5).next(frame);
+  devices.update(index, frame);
+
+  ChillduinoDevice &device = devices.get(index);
+  assert(device.messages == 3);
+  assert(device.compressorStarts == 1);
+  assert(device.isCompressorRunning);
+  assert(device.thermistorAverage == 400 * 16);
+}
+
+void shouldApplyEveryConfiguredSettingInOneFrame(void) {
+  Chillduino chillduino = createChillduino()
+    .setCurrentFreshFoodThermistorReading(380);
+  ChillduinoConfiguration configuration;
+  unsigned char frame[CHILLDUINO_CONFIGURATION_MAXIMUM_LENGTH];
+
+  for (unsigned int field = 0; field < CHILLDUINO_FIELD_COUNT; field++) {
+    configuration.set(field, field + 1);
+  }
+
+  assert(configuration.encode(frame) == CHILLDUINO_CONFIGURATION_MAXIMUM_LENGTH);
+
+  configuration = ChillduinoConfiguration()
+    .set(CHILLDUINO_FIELD_MINIMUM_FRESH_FOOD_THERMISTOR_READING, 300)
+    .set(CHILLDUINO_FIELD_MAXIMUM_FRESH_FOOD_THERMISTOR_READING, 350)
+    .set(CHILLDUINO_FIELD_MINIMUM_TICKS_FOR_COMPRESSOR_CHANGE, TICKS_PER_HOUR)
+    .setPersisted(true);
+
+  unsigned int length = configuration.encode(frame);
+  assert(length == 4 + 2 + 2 + 4);
+
+  ChillduinoConfiguration received;
+  assert(received.decode(frame, length));
+  assert(received.isPersisted());
+  assert(received.get(CHILLDUINO_FIELD_MAXIMUM_FRESH_FOOD_THERMISTOR_READING)
+    == 350);
+  assert(!received.has(CHILLDUINO_FIELD_MODE));
+
+  received.applyTo(chillduino);
+  chillduino.elapse(TICKS_PER_SECOND);
+  assert(chillduino.isCompressorRunning());
+
+  chillduino.setCurrentFreshFoodThermistorReading(290)
+    .elapse(30 * TICKS_PER_MINUTE);
+  assert(chillduino.isCompressorRunning());
+  assert(chillduino.getMode() == CHILLDUINO_MODE_COLDER);
+}
+
+void shouldConfigureSettingsPastTheSixteenthBit(void) {
+  Chillduino chillduino = createChillduino()
+    .setCurrentFreshFoodThermistorReading(400);
+  ChillduinoConfiguration configuration;
+  unsigned char frame[CHILLDUINO_CONFIGURATION_MAXIMUM_LENGTH];
+
+  unsigned int length = ChillduinoConfiguration()
+    .set(CHILLDUINO_FIELD_TARGET_DEFROST_DURATION_IN_TICKS, 0)
+    .set(CHILLDUINO_FIELD_START_DELAY_IN_TICKS, 10 * TICKS_PER_MINUTE)
+    .set(CHILLDUINO_FIELD_SHED_MARGIN_TEMPERATURE, 12)
+    .set(CHILLDUINO_FIELD_SLOPE_SAMPLE_TICKS, 0)
+    .setPersisted(true)
+    .encode(frame);
+
+  assert(length == 4 + 4 + 4 + 2 + 4);
+  assert(frame[1] == 0xC0);
+  assert(frame[2] == 0x03);
+  assert(frame[3] == 0x80);
+  assert(configuration.decode(frame, length));
+  assert(configuration.isPersisted());
+  assert(configuration.get(CHILLDUINO_FIELD_SHED_MARGIN_TEMPERATURE) == 12);
+  assert(configuration.get(CHILLDUINO_FIELD_START_DELAY_IN_TICKS)
+    == 10 * TICKS_PER_MINUTE);
+
+  assert(configuration.applyTo(chillduino));
+  chillduino.elapse(9 * TICKS_PER_MINUTE);
+  assert(!chillduino.isCompressorRunning());
+
+  chillduino.elapse(2 * TICKS_PER_MINUTE);
+  assert(chillduino.isCompressorRunning());
+}
+
+void shouldRejectInvalidConfigurationFrames(void) {
+  ChillduinoConfiguration configuration;
+  unsigned char frame[CHILLDUINO_CONFIGURATION_MAXIMUM_LENGTH];
+
+  unsigned int length = ChillduinoConfiguration()
+    .set(CHILLDUINO_FIELD_MINIMUM_FRESH_FOOD_THERMISTOR_READING, 350)
+    .set(CHILLDUINO_FIELD_MAXIMUM_FRESH_FOOD_THERMISTOR_READING, 300)
+    .encode(frame);
+
+  assert(!configuration.decode(frame, length));
+
+  // a persisted frame is applied again at every reboot, so it must not
+  // undo later changes to the mode or the runtime until defrost
+  length = ChillduinoConfiguration()
+    .set(CHILLDUINO_FIELD_MODE, CHILLDUINO_MODE_COLD)
+    .setPersisted(true)
+    .encode(frame);
+
+  assert(!configuration.decode(frame, length));
+
+  length = ChillduinoConfiguration()
+    .set(CHILLDUINO_FIELD_REMAINING_COMPRESSOR_TICKS_UNTIL_DEFROST, 1)
+    .setPersisted(true)
+    .encode(frame);
+
+  assert(!configuration.decode(frame, length));
+
+  Chillduino chillduino = createChillduino();
+
+  length = ChillduinoConfiguration()
+    .set(CHILLDUINO_FIELD_MODE, CHILLDUINO_MODE_COUNT)
+    .set(CHILLDUINO_FIELD_MINIMUM_TICKS_FOR_DOOR_CLOSE, 1)
+    .encode(frame);
+
+  assert(configuration.decode(frame, length));
+  assert(!configuration.applyTo(chillduino));
+  assert(chillduino.getMode() == CHILLDUINO_MODE_COLDER);
+
+  // one end of a range is checked against the other end in effect
+  length = ChillduinoConfiguration()
+    .set(CHILLDUINO_FIELD_MINIMUM_FRESH_FOOD_THERMISTOR_READING, 400)
+    .setPersisted(true)
+    .encode(frame);
+
+  assert(configuration.decode(frame, length));
+  assert(!configuration.applyTo(chillduino));
+  assert(chillduino.getMinimumFreshFoodThermistorReading() == 370);
+
+  length = ChillduinoConfiguration()
+    .set(CHILLDUINO_FIELD_MAXIMUM_COMPRESSOR_TICKS_PER_DEFROST,
+      TICKS_PER_HOUR / 2)
+    .encode(frame);
+
+  assert(configuration.decode(frame, length));
+  assert(!configuration.applyTo(chillduino));
+  assert(chillduino.getMaximumCompressorTicksPerDefrost()
+    == 2 * TICKS_PER_HOUR);
+
+  length = ChillduinoConfiguration()
+    .set(CHILLDUINO_FIELD_MINIMUM_FRESH_FOOD_THERMISTOR_READING, 380)
+    .encode(frame);
+
+  assert(configuration.decode(frame, length));
+  assert(configuration.applyTo(chillduino));
+  assert(chillduino.getMinimumFreshFoodThermistorReading() == 380);
+
+  length = ChillduinoConfiguration()
+    .set(CHILLDUINO_FIELD_DEFROST_DURATION_IN_TICKS, TICKS_PER_HOUR)
+    .encode(frame);
+
+  assert(!configuration.decode(frame, length - 1));
+  assert(configuration.decode(frame, length));
+
+  frame[3] |= 0x40;
+  assert(!configuration.decode(frame, length));
+  assert(!configuration.has(CHILLDUINO_FIELD_DEFROST_DURATION_IN_TICKS));
+}
+
+void shouldTrackCompressorDutyCycleOverTheWindow(void) {
+  Chillduino chillduino = createChillduino()
+    .setStatisticsWindowInTicks(TICKS_PER_HOUR)
+    .setCurrentFreshFoodThermistorReading(400);
+  ChillduinoStatistics statistics;
+
+  chillduino.getStatistics(statistics);
+  assert(statistics.getCompressorDutyCycle() == 0);
+
+  chillduino.elapse(30 * TICKS_PER_MINUTE);
+  chillduino.getStatistics(statistics);
+  assert(statistics.getCompressorStarts() == 1);
+  assert(statistics.getCompressorTicks() == 30 * TICKS_PER_MINUTE - 1);
+  assert(statistics.getWindowTicks() == 30 * TICKS_PER_MINUTE);
+  assert(statistics.getCompressorDutyCycle() == 999);
+
+  chillduino.setCurrentFreshFoodThermistorReading(360)
+    .elapse(30 * TICKS_PER_MINUTE);
+  chillduino.getStatistics(statistics);
+  assert(statistics.getCompressorTicks() == 30 * TICKS_PER_MINUTE);
+  assert(statistics.getWindowTicks() == 50 * TICKS_PER_MINUTE);
+  assert(statistics.getWindowCompressorStarts() == 0);
+  assert(statistics.getCompressorDutyCycle() == 400);
+
+  chillduino.elapse(2 * TICKS_PER_HOUR);
+  chillduino.getStatistics(statistics);
+  assert(statistics.getCompressorStarts() == 1);
+  assert(statistics.getWindowCompressorStarts() == 0);
+  assert(statistics.getWindowCompressorTicks() == 0);
+  assert(statistics.getCompressorDutyCycle() == 0);
+}
+
+void shouldCountDefrostsByHowTheyEnded(void) {
+  Chillduino chillduino = createChillduino()
+    .setStatisticsWindowInTicks(TICKS_PER_HOUR)
+    .setCurrentFreshFoodThermistorReading(400);
+  ChillduinoStatistics statistics;
+
+  chillduino.elapse(2 * TICKS_PER_HOUR + TICKS_PER_MINUTE);
+  chillduino.getStatistics(statistics);
+  assert(statistics.getDefrosts() == 1);
+
+  chillduino.elapse(30 * TICKS_PER_MINUTE);
+  chillduino.getStatistics(statistics);
+  assert(statistics.getTimedOutDefrosts() == 1);
+  assert(statistics.getAverageDefrostTicks() == 30 * TICKS_PER_MINUTE);
+
+  chillduino.elapse(TICKS_PER_HOUR + 10 * TICKS_PER_MINUTE);
+  assert(chillduino.isDefrostRunning());
+  chillduino.setDefrostSwitchReading(1);
+  chillduino.elapse(10);
+  assert(!chillduino.isDefrostRunning());
+
+  chillduino.getStatistics(statistics);
+  assert(statistics.getDefrosts() == 2);
+  assert(statistics.getBimetalDefrosts() == 1);
+  assert(statistics.getTimedOutDefrosts() == 1);
+  assert(statistics.getForcedDefrosts() == 0);
+  assert(statistics.getAbortedDefrosts() == 0);
+  assert(statistics.getAverageDefrostTicks() < 30 * TICKS_PER_MINUTE);
+}
+
+void shouldCountDefrostsStoppedByTurningOffAsAborted(void) {
+  Chillduino chillduino = createChillduino()
+    .setStatisticsWindowInTicks(TICKS_PER_HOUR)
+    .setCurrentFreshFoodThermistorReading(400);
+  ChillduinoStatistics statistics;
+
+  chillduino.elapse(2 * TICKS_PER_HOUR + TICKS_PER_MINUTE);
+  assert(chillduino.isDefrostRunning());
+
+  chillduino.setMode(CHILLDUINO_MODE_OFF);
+  chillduino.elapse(10);
+  assert(!chillduino.isDefrostRunning());
+
+  chillduino.getStatistics(statistics);
+  assert(statistics.getDefrosts() == 1);
+  assert(statistics.getAbortedDefrosts() == 1);
+  assert(statistics.getBimetalDefrosts() == 0);
+  assert(statistics.getTimedOutDefrosts() == 0);
+  assert(statistics.getAverageDefrostTicks() == 0);
+}
+
+void shouldCountDoorOpensAndForcedDefrosts(void) {
+  Chillduino chillduino = createChillduino()
+    .setStatisticsWindowInTicks(TICKS_PER_HOUR);
+
+  for (int i = 0; i < 3; i++) {
+    chillduino.setDoorSwitchReading(1);
+    chillduino.elapse(10);
+    chillduino.setDoorSwitchReading(0);
+    chillduino.elapse(TICKS_PER_SECOND);
+  }
+
+  chillduino.elapse(5 * TICKS_PER_SECOND);
+  assert(chillduino.isDefrostRunning());
+
+  ChillduinoStatistics statistics;
+  chillduino.getStatistics(statistics);
+  assert(statistics.getDoorOpens() == 3);
+  assert(statistics.getDoorOpenTicks() == 3 * 110);
+  assert(statistics.getForcedDefrosts() == 1);
+  assert(statistics.getDefrosts() == 1);
+}
+
+void shouldKeepTheWindowWhenTicksWrap(void) {
+  ChillduinoStatistics statistics;
+
+  statistics.setWindowInTicks(TICKS_PER_HOUR);
+  statistics.elapse(ULONG_MAX - 5 * TICKS_PER_MINUTE);
+  statistics.account();
+  statistics.setCompressorRunning(true);
+  statistics.elapse(10 * TICKS_PER_MINUTE);
+  statistics.account();
+  assert(statistics.getTicks() < 5 * TICKS_PER_MINUTE);
+  assert(statistics.getCompressorTicks() == 10 * TICKS_PER_MINUTE);
+  assert(statistics.getWindowCompressorStarts() == 1);
+  assert(statistics.getWindowCompressorTicks() == 10 * TICKS_PER_MINUTE);
+
+  statistics.elapse(TICKS_PER_HOUR);
+  statistics.account();
+  assert(statistics.getWindowCompressorTicks()
+    == statistics.getWindowTicks());
+  assert(statistics.getCompressorDutyCycle() == 1000);
+}
+
+void shouldNotCollectStatisticsUnlessEnabled(void) {
+  Chillduino chillduino = createChillduino()
+    .setCurrentFreshFoodThermistorReading(400);
+  ChillduinoStatistics statistics;
+
+  chillduino.elapse(TICKS_PER_MINUTE);
+  chillduino.getStatistics(statistics);
+  assert(!statistics.isEnabled());
+  assert(statistics.getTicks() == 0);
+  assert(statistics.getCompressorStarts() == 0);
+}
+
+void shouldSkipIdleTicksWithoutChangingBehavior(void) {
+  Chillduino ticked = createChillduino()
+    .setStatisticsWindowInTicks(TICKS_PER_HOUR)
+    .setStartDelayInTicks(30 * TICKS_PER_SECOND)
+    .setShedMarginTemperature(9)
+    .setSlopeSampleTicks(TICKS_PER_SECOND);
+  Chillduino skipped = createChillduino()
+    .setStatisticsWindowInTicks(TICKS_PER_HOUR)
+    .setStartDelayInTicks(30 * TICKS_PER_SECOND)
+    .setShedMarginTemperature(9)
+    .setSlopeSampleTicks(TICKS_PER_SECOND);
+  unsigned long random = 12345;
+  unsigned long expected[CHILLDUINO_STATE_SIZE];
+  unsigned long actual[CHILLDUINO_STATE_SIZE];
+  unsigned char expectedStatistics[CHILLDUINO_STATISTICS_LENGTH];
+  unsigned char actualStatistics[CHILLDUINO_STATISTICS_LENGTH];
+  ChillduinoStatistics statistics;
+
+  for (int i = 0; i < 4000; i++) {
+    random = random * 1103515245 + 12345;
+    unsigned long r = (random >> 8) & 0xFFFFFF;
+    unsigned long ticks = (r & 3) ? (r >> 4) % 40 + 1 : (r >> 4) % 20000;
+    int reading = 360 + (r >> 12) % 40;
+
+    switch (r % 7) {
+      case 0:
+        ticked.setCurrentFreshFoodThermistorReading(reading);
+        skipped.setCurrentFreshFoodThermistorReading(reading);
+        break;
+
+      case 1:
+      case 2:
+        ticked.setDoorSwitchReading((r >> 9) & 1);
+        skipped.setDoorSwitchReading((r >> 9) & 1);
+        break;
+
+      case 3:
+        ticked.setDefrostSwitchReading((r >> 9) & 1);
+        skipped.setDefrostSwitchReading((r >> 9) & 1);
+        break;
+
+      case 4:
+        ticked.setModeSwitchReading((r >> 9) & 1);
+        skipped.setModeSwitchReading((r >> 9) & 1);
+        break;
+
+      case 5:
+        ticked.setShedding((r >> 9) & 1);
+        skipped.setShedding((r >> 9) & 1);
+        break;
+
+      default:
+        break;
+    }
+
+    for (unsigned long t = 0; t < ticks; t++) {
+      ticked.tick();
+      ticked.loop();
+    }
+
+    skipped.elapse(ticks);
+
+    assert(ticked.getState(expected) == CHILLDUINO_STATE_SIZE);
+    assert(skipped.getState(actual) == CHILLDUINO_STATE_SIZE);
+    assert(memcmp(expected, actual, sizeof(expected)) == 0);
+
+    ticked.getStatistics(statistics);
+    statistics.encode(expectedStatistics);
+    skipped.getStatistics(statistics);
+    statistics.encode(actualStatistics);
+    assert(memcmp(expectedStatistics, actualStatistics,
+      CHILLDUINO_STATISTICS_LENGTH) == 0);
+  }
+}
+
+ChillduinoPlant createPlant(void) {
+  return ChillduinoPlant(400, 300, 450)
+    .setWarmingTicksPerCount(TICKS_PER_MINUTE)
+    .setCoolingTicksPerCount(30 * TICKS_PER_SECOND)
+    .setDefrostingTicksPerCount(10 * TICKS_PER_SECOND);
+}
+
+void shouldSimulatePlantAsIfTickedEveryTick(void) {
+  ChillduinoSimulator simulator(createChillduino(), createPlant());
+  Chillduino chillduino = createChillduino();
+  ChillduinoPlant plant = createPlant();
+  unsigned long expected[CHILLDUINO_STATE_SIZE];
+  unsigned long actual[CHILLDUINO_STATE_SIZE];
+
+  for (int hour = 0; hour < 6; hour++) {
+    for (unsigned long t = 0; t < TICKS_PER_HOUR; t++) {
+      plant.setRunning(chillduino.isCompressorRunning(),
+        chillduino.isDefrostRunning());
+      plant.elapse(1);
+      chillduino.setCurrentFreshFoodThermistorReading(plant.getReading());
+      chillduino.tick();
+      chillduino.loop();
+    }
+
+    simulator.elapse(TICKS_PER_HOUR);
+
+    chillduino.getState(expected);
+    simulator.getChillduino().getState(actual);
+    assert(memcmp(expected, actual, sizeof(expected)) == 0);
+    assert(plant.getReading() == simulator.getPlant().getReading());
+  }
+
+  assert(simulator.getTotals().ticks == 6 * TICKS_PER_HOUR);
+  assert(simulator.getTotals().compressorStarts > 1);
+  assert(simulator.getTotals().defrosts > 0);
+}
+
+void shouldExtrapolateSteadyStateCycles(void) {
+  ChillduinoSimulator simulated(createChillduino(), createPlant());
+  ChillduinoSimulator extrapolated(createChillduino(), createPlant());
+  unsigned long expected[CHILLDUINO_STATE_SIZE];
+  unsigned long actual[CHILLDUINO_STATE_SIZE];
+
+  extrapolated.setCycleDetectionEnabled(true);
+
+  simulated.elapse(60 * 24 * TICKS_PER_HOUR + 12345);
+  extrapolated.elapse(60 * 24 * TICKS_PER_HOUR + 12345);
+
+  assert(extrapolated.getExtrapolatedPeriods() > 0);
+  assert(memcmp(&simulated.getTotals(), &extrapolated.getTotals(),
+    sizeof(ChillduinoTotals)) == 0);
+
+  simulated.getChillduino().getState(expected);
+  extrapolated.getChillduino().getState(actual);
+  assert(memcmp(expected, actual, sizeof(expected)) == 0);
+}
+
+void shouldSimulateFleetAsIfEachUnitTickedEveryTick(void) {
+  const unsigned int units = 3;
+  const unsigned int count = 400;
+  ChillduinoInput inputs[units][count];
+  Chillduino ticked[units];
+  unsigned int next[units];
+  ChillduinoFleet fleet(units);
+  unsigned long random = 54321;
+  unsigned long running = 0;
+  unsigned long peak = 0;
+  unsigned long compressorTicks = 0;
+  unsigned long compressorStarts = 0;
+  unsigned long defrosts = 0;
+  unsigned long expected[CHILLDUINO_STATE_SIZE];
+  unsigned long actual[CHILLDUINO_STATE_SIZE];
+
+  for (unsigned int u = 0; u < units; u++) {
+    unsigned long time = 0;
+
+    for (unsigned int i = 0; i < count; i++) {
+      random = random * 1103515245 + 12345;
+      unsigned long r = (random >> 8) & 0xFFFFFF;
+
+      time += (r & 3) ? (r >> 4) % 40 : (r >> 4) % 100000;
+      inputs[u][i].time = time;
+      inputs[u][i].type = (r >> 2) % 4;
+      inputs[u][i].reading = (inputs[u][i].type == CHILLDUINO_INPUT_THERMISTOR)
+        ? 360 + (r >> 12) % 40 : (r >> 9) & 1;
+    }
+
+    ticked[u] = createChillduino()
+      .setMinimumTicksForCompressorChange((u + 1) * TICKS_PER_MINUTE)
+      .setMaximumFreshFoodThermistorReading(385 + 5 * u);
+    next[u] = 0;
+    assert(fleet.add(ticked[u], inputs[u], count) == u);
+  }
+
+  for (int quarter = 0; quarter < 4; quarter++) {
+    for (unsigned long t = 0; t < 30 * TICKS_PER_MINUTE; t++) {
+      for (unsigned int u = 0; u < units; u++) {
+        Chillduino &chillduino = ticked[u];
+        bool isCompressorRunning = chillduino.isCompressorRunning();
+        bool isDefrostRunning = chillduino.isDefrostRunning();
+
+        while (next[u] < count &&
+            inputs[u][next[u]].time == quarter * 30 * TICKS_PER_MINUTE + t) {
+          chillduinoApplyInput(chillduino, inputs[u][next[u]++]);
+        }
+
+        compressorTicks += isCompressorRunning;
+        chillduino.tick();
+        chillduino.loop();
+
+        running += chillduino.isCompressorRunning();
+        running -= isCompressorRunning;
+        compressorStarts +=
+          !isCompressorRunning && chillduino.isCompressorRunning();
+        defrosts += !isDefrostRunning && chillduino.isDefrostRunning();
+      }
+
+      peak = (running > peak) ? running : peak;
+    }
+
+    fleet.elapse(30 * TICKS_PER_MINUTE);
+
+    for (unsigned int u = 0; u < units; u++) {
+      ticked[u].getState(expected);
+      fleet.getChillduino(u).getState(actual);
+      assert(memcmp(expected, actual, sizeof(expected)) == 0);
+    }
+  }
+
+  assert(fleet.getTime() == 2 * TICKS_PER_HOUR);
+  assert(fleet.getRunningCompressors() == running);
+  assert(fleet.getPeakRunningCompressors() == peak);
+  assert(fleet.getCompressorTicks() == compressorTicks);
+  assert(fleet.getCompressorStarts() == compressorStarts);
+  assert(fleet.getDefrosts() == defrosts);
+  assert(compressorStarts > 3);
+  assert(fleet.getEvents() < units * 2 * TICKS_PER_HOUR / 1000);
+}
+
+class ForcedDefrostScenario : public ChillduinoScenario {
+  private:
+    unsigned long _offset;
+    int _round;
+
+    ForcedDefrostScenario(const ForcedDefrostScenario &);
+    ForcedDefrostScenario &operator=(const ForcedDefrostScenario &);
+
+  protected:
+    bool run(void) {
+      CHILLDUINO_SCENARIO_BEGIN();
+      CHILLDUINO_AFTER(_offset);
+
+      for (_round = 0; _round < 3; _round++) {
+        getChillduino().setDoorSwitchReading(0);
+        CHILLDUINO_AFTER(10);
+        getChillduino().setDoorSwitchReading(1);
+        CHILLDUINO_AFTER(10);
+        getChillduino().setDoorSwitchReading(0);
+        CHILLDUINO_AFTER(10);
+        getChillduino().setDoorSwitchReading(1);
+        CHILLDUINO_AFTER(TICKS_PER_SECOND);
+        assert(!getChillduino().isDefrostRunning());
+      }
+
+      CHILLDUINO_UNTIL(getChillduino().isDefrostRunning());
+      started = getTime() - _offset;
+      CHILLDUINO_UNTIL(!getChillduino().isDefrostRunning());
+      stopped = getTime() - _offset;
+      CHILLDUINO_SCENARIO_END();
+    }
+
+  public:
+    unsigned long started;
+    unsigned long stopped;
+
+    explicit ForcedDefrostScenario(unsigned long offset) :
+      ChillduinoScenario(createChillduino()),
+      _offset(offset),
+      _round(0),
+      started(0),
+      stopped(0) { }
+};
+
+void shouldRunScenariosOnASharedClock(void) {
+  const unsigned int count = 1000;
+  ForcedDefrostScenario *scenarios[count];
+  ChillduinoScenarioRunner runner(count);
+  Chillduino chillduino = createChillduino();
+  unsigned long started = 0;
+  unsigned long stopped = 0;
+
+  for (int round = 0; round < 3; round++) {
+    chillduino.setDoorSwitchReading(0);
+    chillduino.elapse(10);
+    chillduino.setDoorSwitchReading(1);
+    chillduino.elapse(10);
+    chillduino.setDoorSwitchReading(0);
+    chillduino.elapse(10);
+    chillduino.setDoorSwitchReading(1);
+    chillduino.elapse(TICKS_PER_SECOND);
+  }
+
+  for (started = 3 * (TICKS_PER_SECOND + 30); !chillduino.isDefrostRunning();
+      started++) {
+    chillduino.tick();
+    chillduino.loop();
+  }
+
+  for (stopped = started; chillduino.isDefrostRunning(); stopped++) {
+    chillduino.tick();
+    chillduino.loop();
+  }
+
+  for (unsigned int i = 0; i < count; i++) {
+    scenarios[i] = new ForcedDefrostScenario((i * 7919) % TICKS_PER_HOUR);
+    assert(runner.add(scenarios[i]));
+  }
+
+  assert(!runner.add(scenarios[0]));
+  runner.elapse(2 * TICKS_PER_HOUR);
+
+  assert(runner.getFinished() == count);
+  assert(runner.getResumes() < 20 * count);
+
+  for (unsigned int i = 0; i < count; i++) {
+    assert(scenarios[i]->isFinished());
+    assert(scenarios[i]->started == started);
+    assert(scenarios[i]->stopped == stopped);
+    delete scenarios[i];
+  }
+}
+
+void requestForcedDefrost(Chillduino &chillduino) {
+  for (int round = 0; round < 3; round++) {
+    chillduino.setDoorSwitchReading(0);
+    chillduino.elapse(10);
+    chillduino.setDoorSwitchReading(1);
+    chillduino.elapse(10);
+    chillduino.setDoorSwitchReading(0);
+    chillduino.elapse(10);
+    chillduino.setDoorSwitchReading(1);
+    chillduino.elapse(TICKS_PER_SECOND);
+  }
+
+  chillduino.elapse(5 * TICKS_PER_SECOND);
+}
+
+void shouldWaitForCompressorLockoutBeforeForcedDefrost(void) {
+  Chillduino chillduino = createChillduino()
+    .setCurrentFreshFoodThermistorReading(400);
+
+  chillduino.elapse(1);
+  assert(chillduino.isCompressorRunning());
+
+  requestForcedDefrost(chillduino);
+  assert(chillduino.isCompressorRunning());
+  assert(!chillduino.isDefrostRunning());
+
+  chillduino.elapse(10 * TICKS_PER_MINUTE);
+  assert(!chillduino.isCompressorRunning());
+  assert(chillduino.isDefrostRunning());
+}
+
+void shouldNotForceDefrostWhenOff(void) {
+  Chillduino chillduino = createChillduino()
+    .setMode(CHILLDUINO_MODE_OFF)
+    .setStatisticsWindowInTicks(TICKS_PER_HOUR);
+  ChillduinoStatistics statistics;
+
+  requestForcedDefrost(chillduino);
+  assert(!chillduino.isDefrostRunning());
+  chillduino.getStatistics(statistics);
+  assert(statistics.getForcedDefrosts() == 0);
+
+  chillduino.setMode(CHILLDUINO_MODE_COLDER);
+  chillduino.elapse(TICKS_PER_HOUR);
+  assert(!chillduino.isDefrostRunning());
+  chillduino.getStatistics(statistics);
+  assert(statistics.getDefrosts() == 0);
+}
+
+void shouldDefrostNoSoonerThanMinimumWhenDoorIsHeldOpen(void) {
+  Chillduino chillduino = createChillduino()
+    .setMinimumCompressorTicksPerDefrost(100)
+    .setRemainingCompressorTicksUntilDefrost(600);
+
+  for (int i = 0; i < 100; i++) {
+    chillduino.setDoorSwitchReading(0);
+    chillduino.elapse(10);
+    chillduino.setDoorSwitchReading(1);
+    chillduino.elapse(10);
+  }
+
+  chillduino.elapse(TICKS_PER_SECOND);
+  assert(!chillduino.isDoorOpen());
+  assert(chillduino.getRemainingCompressorTicksUntilDefrost() == 100);
+}
+
+void shouldHoldSafetyInvariantsForRandomInputSchedules(void) {
+  unsigned char data[64];
+  unsigned long random = 2024;
+  unsigned long steps = 0;
+
+  for (int run = 0; run < 2000; run++) {
+    for (unsigned int i = 0; i < sizeof(data); i++) {
+      random = random * 1103515245 + 12345;
+      data[i] = random >> 16;
+    }
+
+    steps += chillduinoFuzz(data, CHILLDUINO_FUZZER_HEADER_SIZE + run % 57);
+  }
+
+  assert(chillduinoFuzz(data, CHILLDUINO_FUZZER_HEADER_SIZE - 1) == 0);
+  assert(steps > 2000);
+}
+
+void shouldWriteAndMapColumnsChunkByChunk(void) {
+  const char *names[] = { "time", "running", "ticks", "door", "reading" };
+  char path[] = "/tmp/chillduino-columns-XXXXXX";
+  int fd = mkstemp(path);
+  uint32_t rows[250][5];
+  uint32_t values[100];
+  unsigned long sums[5] = { 0, 0, 0, 0, 0 };
+  unsigned long bytes = 0;
+
+  assert(fd >= 0);
+  unlink(path);
+
+  ChillduinoColumnWriter *writer = new ChillduinoColumnWriter(fd, names, 5, 100);
+
+  for (uint32_t i = 0; i < 250; i++) {
+    rows[i][0] = i * 1000;
+    rows[i][1] = (i / 60) % 2;
+    rows[i][2] = i * 2654435761U;
+    rows[i][3] = (i * 2654435761U) >> 31;
+    rows[i][4] = 300 + (i * 7) % 50;
+    writer->append(rows[i]);
+    assert(writer->getBytes() >= bytes);
+    bytes = writer->getBytes();
+
+    for (int c = 0; c < 5; c++) {
+      sums[c] += rows[i][c];
+    }
+  }
+
+  assert(writer->close());
+  assert(writer->getBytes() == (unsigned long) lseek(fd, 0, SEEK_END));
+  delete writer;
+
+  ChillduinoColumnReader reader(fd);
+
+  assert(reader.isOpen());
+  assert(reader.getRows() == 250);
+  assert(reader.getChunks() == 3);
+  assert(reader.getChunkRows(2) == 50);
+  assert(reader.findColumn("running") == 1);
+  assert(reader.findColumn("missing") == -1);
+  assert(reader.getEncoding(0, 0) == CHILLDUINO_COLUMNS_DELTA);
+  assert(reader.getEncoding(0, 1) == CHILLDUINO_COLUMNS_RLE);
+  assert(reader.getEncoding(0, 2) == CHILLDUINO_COLUMNS_RAW);
+  assert(reader.getEncoding(0, 3) == CHILLDUINO_COLUMNS_PACKED);
+  assert(reader.getEncoding(0, 4) == CHILLDUINO_COLUMNS_PACKED);
+  assert(reader.getRawValues(0, 1) == 0);
+  assert(reader.getRawValues(1, 2)[5] == rows[105][2]);
+
+  for (unsigned long chunk = 0; chunk < reader.getChunks(); chunk++) {
+    for (uint32_t c = 0; c < 5; c++) {
+      assert(reader.decode(chunk, c, values) == reader.getChunkRows(chunk));
+
+      for (uint32_t i = 0; i < reader.getChunkRows(chunk); i++) {
+        assert(values[i] == rows[chunk * 100 + i][c]);
+      }
+    }
+  }
+
+  for (uint32_t c = 0; c < 5; c++) {
+    assert(reader.sum(c) == sums[c]);
+  }
+
+  assert(ftruncate(fd, lseek(fd, 0, SEEK_END) - 8) == 0);
+  ChillduinoColumnReader truncated(fd);
+  assert(!truncated.isOpen());
+
+  close(fd);
+}
+
+#define FREEZER     0
+#define FRESH_FOOD  1
+#define CONVERTIBLE 2
+
+ChillduinoZones<3> createZones(void) {
+  ChillduinoZones<3> zones;
+
+  zones.setMode(CHILLDUINO_MODE_COLDER)
+    .setMinimumTicksForCompressorChange(10 * TICKS_PER_MINUTE);
+
+  for (unsigned int zone = 0; zone < zones.getZoneCount(); zone++) {
+    zones.setMinimumThermistorReading(zone, 370)
+      .setMaximumThermistorReading(zone, 392)
+      .setCurrentThermistorReading(zone, 380)
+      .setMinimumCompressorTicksPerDefrost(zone, TICKS_PER_HOUR)
+      .setMaximumCompressorTicksPerDefrost(zone, 2 * TICKS_PER_HOUR)
+      .setRemainingCompressorTicksUntilDefrost(zone, 2 * TICKS_PER_HOUR)
+      .setDefrostDurationInTicks(zone, 30 * TICKS_PER_MINUTE)
+      .setMinimumTicksForDoorClose(zone, 100)
+      .setMinimumTicksForBimetalCutoff(zone, 100);
+  }
+
+  return zones;
+}
+
+void shouldCoolOneZoneAtATimeByPriority(void) {
+  ChillduinoZones<3> zones = createZones();
+
+  zones.setCurrentThermistorReading(FRESH_FOOD, 400)
+    .setCurrentThermistorReading(FREEZER, 400);
+  zones.elapse(TICKS_PER_SECOND);
+
+  assert(zones.isCompressorRunning());
+  assert(zones.getCooledZone() == FREEZER);
+  assert(!zones.isZoneCooled(FRESH_FOOD));
+
+  zones.setCurrentThermistorReading(FREEZER, 360);
+  zones.elapse(TICKS_PER_MINUTE);
+  assert(zones.isZoneCooled(FREEZER));
+
+  zones.elapse(10 * TICKS_PER_MINUTE);
+  assert(zones.isCompressorRunning());
+  assert(zones.isZoneCooled(FRESH_FOOD));
+
+  zones.setCurrentThermistorReading(FRESH_FOOD, 360);
+  zones.elapse(TICKS_PER_SECOND);
+  assert(!zones.isCompressorRunning());
+  assert(zones.getCooledZone() == CHILLDUINO_ZONE_NONE);
+
+  zones.setCurrentThermistorReading(CONVERTIBLE, 400);
+  zones.elapse(TICKS_PER_SECOND);
+  assert(!zones.isCompressorRunning());
+
+  zones.elapse(10 * TICKS_PER_MINUTE);
+  assert(zones.isZoneCooled(CONVERTIBLE));
+}
+
+void shouldDefrostEachZoneOnItsOwnSchedule(void) {
+  ChillduinoZones<3> zones = createZones();
+
+  zones.setRemainingCompressorTicksUntilDefrost(FREEZER, TICKS_PER_HOUR)
+    .setCurrentThermistorReading(FREEZER, 400)
+    .setCurrentThermistorReading(FRESH_FOOD, 400);
+  zones.elapse(TICKS_PER_HOUR - TICKS_PER_MINUTE);
+
+  assert(zones.isZoneCooled(FREEZER));
+  assert(!zones.isDefrostRunning(FREEZER));
+  assert(zones.getRemainingCompressorTicksUntilDefrost(FRESH_FOOD)
+    == 2 * TICKS_PER_HOUR);
+
+  zones.elapse(2 * TICKS_PER_MINUTE);
+  assert(zones.isDefrostRunning(FREEZER));
+  assert(!zones.isDefrostRunning(FRESH_FOOD));
+  assert(zones.isZoneCooled(FRESH_FOOD));
+
+  zones.elapse(29 * TICKS_PER_MINUTE);
+  assert(zones.isDefrostRunning(FREEZER));
+  assert(!zones.isZoneCooled(FREEZER));
+
+  zones.elapse(TICKS_PER_MINUTE);
+  assert(!zones.isDefrostRunning(FREEZER));
+  assert(zones.getRemainingCompressorTicksUntilDefrost(FREEZER)
+    == TICKS_PER_HOUR);
+  assert(zones.isZoneCooled(FRESH_FOOD));
+
+  zones.setDefrostSwitchReading(FRESH_FOOD, 1);
+  zones.elapse(50);
+  assert(zones.isBimetalCutoff(FRESH_FOOD));
+  assert(zones.isZoneCooled(FRESH_FOOD));
+}
+
+void shouldDefrostZoneSoonerWhenItsDoorIsOpened(void) {
+  ChillduinoZones<3> zones = createZones();
+
+  zones.setDoorSwitchReading(FRESH_FOOD, 1);
+  zones.elapse(50);
+  zones.setDoorSwitchReading(FRESH_FOOD, 0);
+  zones.elapse(TICKS_PER_SECOND);
+
+  assert(zones.isDoorOpen(FRESH_FOOD) == false);
+  assert(zones.getRemainingCompressorTicksUntilDefrost(FRESH_FOOD)
+    == 2 * TICKS_PER_HOUR - 150);
+  assert(zones.getRemainingCompressorTicksUntilDefrost(FREEZER)
+    == 2 * TICKS_PER_HOUR);
+
+  zones.setDoorSwitchReading(FREEZER, 1);
+  zones.elapse(10);
+  assert(zones.isDoorOpen(FREEZER));
+  assert(!zones.isDoorOpen(FRESH_FOOD));
+}
+
+void shouldStopEveryZoneInOffMode(void) {
+  ChillduinoZones<3> zones = createZones();
+
+  zones.setRemainingCompressorTicksUntilDefrost(FREEZER, TICKS_PER_MINUTE)
+    .setCurrentThermistorReading(FREEZER, 400)
+    .setCurrentThermistorReading(FRESH_FOOD, 400);
+  zones.elapse(11 * TICKS_PER_MINUTE);
+
+  assert(zones.isDefrostRunning(FREEZER));
+  assert(zones.isCompressorRunning());
+
+  zones.setMode(CHILLDUINO_MODE_OFF);
+  zones.elapse(TICKS_PER_SECOND);
+
+  assert(!zones.isDefrostRunning(FREEZER));
+  assert(!zones.isCompressorRunning());
+
+  zones.elapse(TICKS_PER_HOUR);
+  assert(!zones.isCompressorRunning());
+}
+
+void shouldSkipIdleTicksInEveryZone(void) {
+  ChillduinoZones<3> ticked = createZones();
+  ChillduinoZones<3> skipped = createZones();
+  unsigned long random = 31337;
+
+  for (int i = 0; i < 4000; i++) {
+    random = random * 1103515245 + 12345;
+    unsigned long r = (random >> 8) & 0xFFFFFF;
+    unsigned long ticks = (r & 3) ? (r >> 4) % 40 + 1 : (r >> 4) % 20000;
+    unsigned int zone = (r >> 14) % 3;
+    int reading = 360 + (r >> 12) % 40;
+
+    switch (r % 6) {
+      case 0:
+      case 1:
+        ticked.setCurrentThermistorReading(zone, reading);
+        skipped.setCurrentThermistorReading(zone, reading);
+        break;
+
+      case 2:
+      case 3:
+        ticked.setDoorSwitchReading(zone, (r >> 9) & 1);
+        skipped.setDoorSwitchReading(zone, (r >> 9) & 1);
+        break;
+
+      case 4:
+        ticked.setDefrostSwitchReading(zone, (r >> 9) & 1);
+        skipped.setDefrostSwitchReading(zone, (r >> 9) & 1);
+        break;
+
+      default:
+        break;
+    }
+
+    for (unsigned long t = 0; t < ticks; t++) {
+      ticked.tick();
+      ticked.loop();
+    }
+
+    skipped.elapse(ticks);
+
+    assert(ticked.getCooledZone() == skipped.getCooledZone());
+    assert(ticked.getTicksUntilNextEvent() == skipped.getTicksUntilNextEvent());
+
+    for (zone = 0; zone < 3; zone++) {
+      assert(ticked.isDefrostRunning(zone) == skipped.isDefrostRunning(zone));
+      assert(ticked.isDoorOpen(zone) == skipped.isDoorOpen(zone));
+      assert(ticked.isBimetalCutoff(zone) == skipped.isBimetalCutoff(zone));
+      assert(ticked.getRemainingCompressorTicksUntilDefrost(zone)
+        == skipped.getRemainingCompressorTicksUntilDefrost(zone));
+    }
+  }
+}
+
+double betaTemperature(int reading) {
+  double resistance = CHILLDUINO_THERMISTOR_SERIES_RESISTANCE
+    * (1024.0 / reading - 1);
+
+  return 10 * (1 / (1 / 298.15 + log(resistance
+    / CHILLDUINO_THERMISTOR_NOMINAL_RESISTANCE)
+    / CHILLDUINO_THERMISTOR_BETA) - 273.15);
+}
+
+void shouldConvertReadingsWithinToleranceOfBetaEquation(void) {
+  int checked = 0;
+
+  for (int reading = 1; reading <= CHILLDUINO_THERMISTOR_MAXIMUM_READING;
+      reading++) {
+    double expected = betaTemperature(reading);
+    int temperature = chillduinoThermistorTemperature(reading);
+
+    assert(temperature >= chillduinoThermistorTemperature(reading - 1));
+
+    if (expected >= CHILLDUINO_THERMISTOR_MINIMUM_ACCURATE_TEMPERATURE &&
+        expected <= CHILLDUINO_THERMISTOR_MAXIMUM_ACCURATE_TEMPERATURE) {
+      assert(fabs(temperature - expected) <= CHILLDUINO_THERMISTOR_TOLERANCE);
+      checked++;
+    }
+  }
+
+  assert(checked > 600);
+  assert(chillduinoThermistorTemperature(-5) == -400);
+  assert(chillduinoThermistorTemperature(2000) == 1250);
+}
+
+void shouldConvertTemperatureSettingsToNearestReading(void) {
+  for (int temperature = CHILLDUINO_THERMISTOR_MINIMUM_ACCURATE_TEMPERATURE;
+      temperature <= CHILLDUINO_THERMISTOR_MAXIMUM_ACCURATE_TEMPERATURE;
+      temperature++) {
+    int reading = chillduinoThermistorReading(temperature);
+    int error = abs(chillduinoThermistorTemperature(reading) - temperature);
+
+    assert(error <= abs(chillduinoThermistorTemperature(reading - 1)
+      - temperature));
+    assert(error <= abs(chillduinoThermistorTemperature(reading + 1)
+      - temperature));
+    assert(reading <= chillduinoThermistorReading(temperature + 1));
+  }
+
+  assert(chillduinoThermistorReading(-1000) == 0);
+  assert(chillduinoThermistorReading(2000)
+    == CHILLDUINO_THERMISTOR_MAXIMUM_READING);
+
+  Chillduino chillduino = createChillduino()
+    .setMinimumFreshFoodTemperature(20)
+    .setMaximumFreshFoodTemperature(50)
+    .setCurrentFreshFoodTemperature(45);
+
+  assert(abs(chillduino.getMinimumFreshFoodTemperature() - 20) <= 1);
+  assert(abs(chillduino.getMaximumFreshFoodTemperature() - 50) <= 1);
+  assert(abs(chillduino.getFreshFoodTemperature() - 45) <= 1);
+
+  chillduino.elapse(TICKS_PER_SECOND);
+  assert(!chillduino.isCompressorRunning());
+
+  chillduino.setCurrentFreshFoodTemperature(55)
+    .elapse(TICKS_PER_SECOND);
+  assert(chillduino.isCompressorRunning());
+
+  chillduino.setCurrentFreshFoodThermistorReading(
+    chillduinoThermistorReading(15))
+    .elapse(10 * TICKS_PER_MINUTE);
+  assert(!chillduino.isCompressorRunning());
+}
+
+void shouldLengthenAdaptiveDefrostIntervalWhenBimetalCutsOffEarly(void) {
+  Chillduino chillduino = createChillduino()
+    .setTargetDefrostDurationInTicks(25 * TICKS_PER_MINUTE)
+    .setLearnedCompressorTicksPerDefrost(TICKS_PER_HOUR);
+
+  chillduino.setCurrentFreshFoodThermistorReading(400)
+    .elapse(2 * TICKS_PER_HOUR + TICKS_PER_MINUTE);
+  assert(chillduino.isDefrostRunning());
+
+  chillduino.elapse(10 * TICKS_PER_MINUTE);
+  chillduino.setDefrostSwitchReading(1);
+  chillduino.elapse(10);
+
+  assert(!chillduino.isDefrostRunning());
+  assert(chillduino.getLearnedCompressorTicksPerDefrost()
+    > 3 * TICKS_PER_HOUR / 2);
+  assert(chillduino.getLearnedCompressorTicksPerDefrost()
+    < 2 * TICKS_PER_HOUR);
+  assert(chillduino.getLearnedCompressorTicksPerDefrost()
+    - chillduino.getRemainingCompressorTicksUntilDefrost() < TICKS_PER_SECOND);
+}
+
+void shouldShortenAdaptiveDefrostIntervalWhenDefrostTimesOut(void) {
+  Chillduino chillduino = createChillduino()
+    .setTargetDefrostDurationInTicks(10 * TICKS_PER_MINUTE);
+
+  chillduino.setCurrentFreshFoodThermistorReading(400)
+    .elapse(2 * TICKS_PER_HOUR + TICKS_PER_MINUTE);
+  assert(chillduino.isDefrostRunning());
+  assert(chillduino.getLearnedCompressorTicksPerDefrost() == 0);
+
+  chillduino.elapse(30 * TICKS_PER_MINUTE);
+  assert(!chillduino.isDefrostRunning());
+  assert(chillduino.getLearnedCompressorTicksPerDefrost()
+    == 5 * TICKS_PER_HOUR / 4);
+  assert(5 * TICKS_PER_HOUR / 4
+    - chillduino.getRemainingCompressorTicksUntilDefrost() < TICKS_PER_MINUTE);
+
+  chillduino.elapse(5 * TICKS_PER_HOUR / 4);
+  assert(chillduino.isDefrostRunning());
+
+  chillduino.elapse(30 * TICKS_PER_MINUTE);
+  assert(!chillduino.isDefrostRunning());
+  assert(chillduino.getLearnedCompressorTicksPerDefrost() == TICKS_PER_HOUR);
+}
+
+void shouldSimulateFrostAsIfTickedEveryTick(void) {
+  Chillduino chillduino = createChillduino()
+    .setTargetDefrostDurationInTicks(20 * TICKS_PER_MINUTE);
+  ChillduinoPlant plant = createPlant()
+    .setCompressorTicksPerDefrostTick(12)
+    .setDefrostWarmupTicks(3 * TICKS_PER_MINUTE);
+  ChillduinoSimulator simulator(chillduino, plant);
+  unsigned long heaterTicks = 0;
+  unsigned long expected[CHILLDUINO_STATE_SIZE + CHILLDUINO_PLANT_STATE_SIZE];
+  unsigned long actual[CHILLDUINO_STATE_SIZE + CHILLDUINO_PLANT_STATE_SIZE];
+
+  for (int hour = 0; hour < 12; hour++) {
+    for (unsigned long t = 0; t < TICKS_PER_HOUR; t++) {
+      plant.setRunning(chillduino.isCompressorRunning(),
+        chillduino.isDefrostRunning());
+      heaterTicks += plant.isHeating();
+      plant.elapse(1);
+      chillduino.setCurrentFreshFoodThermistorReading(plant.getReading());
+      chillduino.setDefrostSwitchReading(plant.getDefrostSwitchReading());
+      chillduino.tick();
+      chillduino.loop();
+    }
+
+    simulator.elapse(TICKS_PER_HOUR);
+
+    unsigned int size = chillduino.getState(expected);
+    plant.getState(expected + size);
+    size = simulator.getChillduino().getState(actual);
+    simulator.getPlant().getState(actual + size);
+    assert(memcmp(expected, actual, sizeof(expected)) == 0);
+    assert(simulator.getTotals().heaterTicks == heaterTicks);
+  }
+
+  assert(simulator.getTotals().defrosts > 1);
+  assert(simulator.getTotals().heaterTicks
+    < simulator.getTotals().defrostTicks);
+  assert(chillduino.getLearnedCompressorTicksPerDefrost() > 0);
+}
+
+#define MODE_VACATION    4
+#define MODE_QUICK_CHILL 5
+
+const ChillduinoModeProfile MODE_PROFILES[] PROGMEM = {
+  { 0, 0, 0, 0, 1 << 0 },
+  { 59, 130, 0, 0, 1 << 1 },
+  { -21, 105, 0, 0, 1 << 2 },
+  { -41, 94, 0, 0, 1 << 3 },
+  { 120, 170, 0, 0, 1 << 4 },
+  { -21, 20, 0, 2 * TICKS_PER_MINUTE, 1 << 5 }
+};
+
+#define MODE_PROFILE_COUNT (sizeof(MODE_PROFILES) / sizeof(MODE_PROFILES[0]))
+
+void pressModeSwitch(Chillduino &chillduino) {
+  chillduino.setModeSwitchReading(1);
+  chillduino.elapse(TICKS_PER_SECOND);
+  chillduino.setModeSwitchReading(0);
+  chillduino.elapse(TICKS_PER_SECOND);
+}
+
+void shouldCycleThroughModeProfilesInTableOrder(void) {
+  Chillduino chillduino = createChillduino()
+    .setModeProfiles(MODE_PROFILES, MODE_PROFILE_COUNT)
+    .setMode(CHILLDUINO_MODE_COLDEST);
+
+  assert(chillduino.getModeCount() == 6);
+  assert(chillduino.getModeLeds() == 1 << 3);
+  assert(chillduino.getMaximumFreshFoodTemperature()
+    == chillduinoThermistorTemperature(chillduinoThermistorReading(94)));
+
+  pressModeSwitch(chillduino);
+  assert(chillduino.getMode() == MODE_VACATION);
+  assert(chillduino.getModeLeds() == 1 << 4);
+  assert(chillduino.getMinimumFreshFoodTemperature()
+    == chillduinoThermistorTemperature(chillduinoThermistorReading(120)));
+  assert(chillduino.getMaximumFreshFoodTemperature()
+    == chillduinoThermistorTemperature(chillduinoThermistorReading(170)));
+
+  pressModeSwitch(chillduino);
+  assert(chillduino.getMode() == MODE_QUICK_CHILL);
+  assert(chillduino.getModeLeds() == 1 << 5);
+
+  pressModeSwitch(chillduino);
+  assert(chillduino.getMode() == CHILLDUINO_MODE_OFF);
+  assert(chillduino.getModeLeds() == 1 << 0);
+  assert(chillduino.getMaximumFreshFoodTemperature()
+    == chillduinoThermistorTemperature(chillduinoThermistorReading(20)));
+}
+
+void shouldOverrideCompressorLockoutOnlyWhileInModeProfile(void) {
+  Chillduino chillduino = createChillduino()
+    .setModeProfiles(MODE_PROFILES, MODE_PROFILE_COUNT)
+    .setMode(MODE_QUICK_CHILL);
+
+  int warm = chillduinoThermistorReading(150);
+  int cold = chillduinoThermistorReading(-30);
+
+  chillduino.setCurrentFreshFoodThermistorReading(warm)
+    .elapse(TICKS_PER_SECOND);
+  assert(chillduino.isCompressorRunning());
+
+  chillduino.setCurrentFreshFoodThermistorReading(cold)
+    .elapse(2 * TICKS_PER_MINUTE);
+  assert(!chillduino.isCompressorRunning());
+
+  chillduino.setCurrentFreshFoodThermistorReading(warm)
+    .elapse(2 * TICKS_PER_MINUTE);
+  assert(chillduino.isCompressorRunning());
+
+  chillduino.setMode(CHILLDUINO_MODE_COLDER);
+  chillduino.setCurrentFreshFoodThermistorReading(cold)
+    .elapse(2 * TICKS_PER_MINUTE);
+  assert(!chillduino.isCompressorRunning());
+
+  chillduino.setCurrentFreshFoodThermistorReading(warm)
+    .elapse(2 * TICKS_PER_MINUTE);
+  assert(!chillduino.isCompressorRunning());
+
+  chillduino.elapse(8 * TICKS_PER_MINUTE);
+  assert(chillduino.isCompressorRunning());
+}
+
+void shouldSelectEveryModeProfileByFrame(void) {
+  Chillduino chillduino = createChillduino()
+    .setModeProfiles(MODE_PROFILES, MODE_PROFILE_COUNT);
+  Chillduino shorter = createChillduino()
+    .setModeProfiles(MODE_PROFILES, 2);
+  ChillduinoConfiguration configuration = ChillduinoConfiguration()
+    .set(CHILLDUINO_FIELD_MODE, MODE_QUICK_CHILL);
+
+  assert(configuration.applyTo(chillduino));
+  assert(chillduino.getMode() == MODE_QUICK_CHILL);
+
+  assert(!configuration.applyTo(shorter));
+  assert(shorter.getMode() == CHILLDUINO_MODE_OFF);
+
+  shorter.setMode(CHILLDUINO_MODE_COLDEST);
+  assert(shorter.getMode() == CHILLDUINO_MODE_OFF);
+}
+
+void shouldApplyConfiguredBandOverModeProfile(void) {
+  Chillduino chillduino = createChillduino()
+    .setModeProfiles(MODE_PROFILES, MODE_PROFILE_COUNT);
+
+  ChillduinoConfiguration()
+    .set(CHILLDUINO_FIELD_MAXIMUM_FRESH_FOOD_THERMISTOR_READING, 350)
+    .set(CHILLDUINO_FIELD_MODE, CHILLDUINO_MODE_COLD)
+    .applyTo(chillduino);
+
+  assert(chillduino.getMode() == CHILLDUINO_MODE_COLD);
+  assert(chillduino.getMinimumFreshFoodTemperature()
+    == chillduinoThermistorTemperature(chillduinoThermistorReading(59)));
+  assert(chillduino.getMaximumFreshFoodTemperature()
+    == chillduinoThermistorTemperature(350));
+
+  // the band of the mode in the frame is the one the maximum must clear
+  assert(!ChillduinoConfiguration()
+    .set(CHILLDUINO_FIELD_MAXIMUM_FRESH_FOOD_THERMISTOR_READING,
+      chillduinoThermistorReading(-41))
+    .set(CHILLDUINO_FIELD_MODE, CHILLDUINO_MODE_COLD)
+    .applyTo(chillduino));
+  assert(chillduino.getMaximumFreshFoodTemperature()
+    == chillduinoThermistorTemperature(350));
+}
+
+void shouldDelayFirstCompressorStartByStartDelay(void) {
+  Chillduino chillduino = createChillduino()
+    .setStartDelayInTicks(30 * TICKS_PER_SECOND)
+    .setCurrentFreshFoodThermistorReading(400);
+
+  chillduino.elapse(29 * TICKS_PER_SECOND);
+  assert(!chillduino.isCompressorRunning());
+
+  chillduino.elapse(TICKS_PER_SECOND);
+  assert(chillduino.isCompressorRunning());
+}
+
+void shouldDeferCompressorStartsWithinShedMargin(void) {
+  Chillduino chillduino = createChillduino()
+    .setShedMarginTemperature(9)
+    .setCurrentFreshFoodThermistorReading(400);
+
+  chillduino.elapse(TICKS_PER_SECOND);
+  assert(chillduino.isCompressorRunning());
+
+  chillduino.setShedding(true)
+    .elapse(TICKS_PER_HOUR);
+  assert(chillduino.isCompressorRunning());
+
+  chillduino.setCurrentFreshFoodThermistorReading(360)
+    .elapse(TICKS_PER_SECOND);
+  assert(!chillduino.isCompressorRunning());
+
+  chillduino.setCurrentFreshFoodThermistorReading(400)
+    .elapse(TICKS_PER_HOUR);
+  assert(!chillduino.isCompressorRunning());
+
+  chillduino.setStartDelayInTicks(30 * TICKS_PER_SECOND)
+    .setShedding(false)
+    .elapse(29 * TICKS_PER_SECOND);
+  assert(!chillduino.isCompressorRunning());
+
+  chillduino.elapse(TICKS_PER_SECOND);
+  assert(chillduino.isCompressorRunning());
+
+  chillduino.setShedding(true)
+    .setCurrentFreshFoodThermistorReading(360)
+    .elapse(10 * TICKS_PER_MINUTE);
+  assert(!chillduino.isCompressorRunning());
+
+  chillduino.setCurrentFreshFoodThermistorReading(403)
+    .elapse(10 * TICKS_PER_MINUTE);
+  assert(chillduino.isCompressorRunning());
+}
+
+void shouldMoveShedLimitWithTheMode(void) {
+  Chillduino chillduino = createChillduino()
+    .setModeProfiles(MODE_PROFILES, MODE_PROFILE_COUNT)
+    .setMode(CHILLDUINO_MODE_COLDER)
+    .setShedMarginTemperature(20)
+    .setShedding(true)
+    .setCurrentFreshFoodTemperature(120);
+
+  chillduino.elapse(TICKS_PER_SECOND);
+  assert(!chillduino.isCompressorRunning());
+
+  chillduino.setMode(CHILLDUINO_MODE_COLDEST)
+    .elapse(TICKS_PER_SECOND);
+  assert(chillduino.isCompressorRunning());
+}
+
+void shouldStaggerCompressorStartsAfterPowerIsRestored(void) {
+  ChillduinoBuilding together(10, TICKS_PER_SECOND);
+  ChillduinoBuilding staggered(10, TICKS_PER_SECOND);
+
+  for (unsigned long i = 0; i < 10; i++) {
+    together.add(createChillduino(), createPlant());
+    staggered.add(createChillduino()
+      .setStartDelayInTicks(i * 10 * TICKS_PER_SECOND), createPlant());
+  }
+
+  together.elapse(2 * TICKS_PER_MINUTE);
+  staggered.elapse(2 * TICKS_PER_MINUTE);
+
+  assert(together.getPeakCompressorStarts() == 10);
+  assert(staggered.getPeakCompressorStarts() == 1);
+  assert(staggered.getRunningCompressors() == 10);
+  assert(staggered.getOvershoot() > together.getOvershoot());
+}
+
+int simulateLowestReadingWhileCoasting(const Chillduino &reference) {
+  Chillduino chillduino = reference;
+  ChillduinoPlant plant = createPlant()
+    .setCoolingTicksPerCount(TICKS_PER_MINUTE)
+    .setCoastTicks(5 * TICKS_PER_MINUTE);
+  ChillduinoSimulator simulator(chillduino, plant);
+  unsigned long expected[CHILLDUINO_STATE_SIZE + CHILLDUINO_PLANT_STATE_SIZE];
+  unsigned long actual[CHILLDUINO_STATE_SIZE + CHILLDUINO_PLANT_STATE_SIZE];
+  int lowest = plant.getReading();
+
+  for (int hour = 0; hour < 8; hour++) {
+    for (unsigned long t = 0; t < TICKS_PER_HOUR; t++) {
+      plant.setRunning(chillduino.isCompressorRunning(),
+        chillduino.isDefrostRunning());
+      plant.elapse(1);
+      chillduino.setCurrentFreshFoodThermistorReading(plant.getReading());
+      chillduino.tick();
+      chillduino.loop();
+
+      if (hour >= 4 && plant.getReading() < lowest) {
+        lowest = plant.getReading();
+      }
+    }
+
+    simulator.elapse(TICKS_PER_HOUR);
+
+    unsigned int size = chillduino.getState(expected);
+    plant.getState(expected + size);
+    size = simulator.getChillduino().getState(actual);
+    simulator.getPlant().getState(actual + size);
+    assert(memcmp(expected, actual, sizeof(expected)) == 0);
+  }
+
+  return lowest;
+}
+
+void shouldStopCompressorEarlyByLearnedCoast(void) {
+  Chillduino hysteresis = createChillduino()
+    .setRemainingCompressorTicksUntilDefrost(24 * TICKS_PER_HOUR);
+  Chillduino predictive = Chillduino(hysteresis)
+    .setSlopeSampleTicks(TICKS_PER_MINUTE);
+
+  assert(simulateLowestReadingWhileCoasting(hysteresis) == 370 - 6);
+  assert(simulateLowestReadingWhileCoasting(predictive) >= 370 - 1);
+}
+
+void shouldCatchUpElapsedTicksInOneLoop(void) {
+  Chillduino ticked = createChillduino()
+    .setStatisticsWindowInTicks(TICKS_PER_HOUR)
+    .setStartDelayInTicks(30 * TICKS_PER_SECOND)
+    .setSlopeSampleTicks(TICKS_PER_SECOND);
+  Chillduino caught = Chillduino(ticked);
+  unsigned long random = 54321;
+  unsigned long expected[CHILLDUINO_STATE_SIZE];
+  unsigned long actual[CHILLDUINO_STATE_SIZE];
+
+  for (int i = 0; i < 20000; i++) {
+    random = random * 1103515245 + 12345;
+    unsigned long r = (random >> 8) & 0xFFFFFF;
+    unsigned long ticks = (r >> 4) % 100;
+    int reading = 360 + (r >> 12) % 40;
+    bool isChanged = false;
+
+    ticked.setCurrentFreshFoodThermistorReading(reading);
+    caught.setCurrentFreshFoodThermistorReading(reading);
+    ticked.setDoorSwitchReading((r & 7) == 0);
+    caught.setDoorSwitchReading((r & 7) == 0);
+    ticked.setModeSwitchReading((r & 0x1F) == 1);
+    caught.setModeSwitchReading((r & 0x1F) == 1);
+    ticked.setDefrostSwitchReading((r >> 2) & 1);
+    caught.setDefrostSwitchReading((r >> 2) & 1);
+
+    if (ticks == 0) {
+      ticked.loop();
+      isChanged = ticked.isChanged();
+    }
+
+    for (unsigned long t = 0; t < ticks; t++) {
+      ticked.tick();
+      ticked.loop();
+      isChanged = isChanged || ticked.isChanged();
+    }
+
+    caught.loop(ticks);
+    assert(caught.isChanged() == isChanged);
+
+    ticked.getState(expected);
+    caught.getState(actual);
+    expected[CHILLDUINO_STATE_SIZE - 1] &= ~(1UL << 5);
+    actual[CHILLDUINO_STATE_SIZE - 1] &= ~(1UL << 5);
+    assert(memcmp(expected, actual, sizeof(expected)) == 0);
+  }
+}
+
+void shouldDriveRelaysAndReadSwitchesThroughPorts(void) {
+  typedef ChillduinoPin<ChillduinoPortB, 5> Compressor;
+  typedef ChillduinoPin<ChillduinoPortB, 6> Defrost;
+  typedef ChillduinoPin<ChillduinoPortB, 7> DefrostSwitch;
+  typedef ChillduinoPin<ChillduinoPortB, 1> ModeSwitch;
+  typedef ChillduinoPin<ChillduinoPortF, 5> RelayWatchdog;
+  typedef ChillduinoPin<ChillduinoPortF, 1> DoorSwitch;
+
+  Compressor::output();
+  Defrost::output();
+  DefrostSwitch::input();
+  RelayWatchdog::output();
+  assert(ChillduinoPortB::directions() == 0x60);
+  assert(ChillduinoPortF::directions() == 0x20);
+
+  Compressor::write(true);
+  Defrost::write(false);
+  assert(ChillduinoPortB::outputs() == 0x20);
+  Defrost::set();
+  Compressor::clear();
+  assert(ChillduinoPortB::outputs() == 0x40);
+
+  RelayWatchdog::toggle();
+  assert(ChillduinoPortF::outputs() == 0x20);
+  RelayWatchdog::toggle();
+  assert(ChillduinoPortF::outputs() == 0x00);
+  assert(ChillduinoPortB::outputs() == 0x40);
+
+  ChillduinoPortB::pins() = 0x82;
+  ChillduinoPortF::pins() = 0x02;
+  unsigned char switches = ChillduinoPortB::read();
+  assert(DefrostSwitch::isSet(switches));
+  assert(ModeSwitch::isSet(switches));
+  assert(DoorSwitch::read());
+
+  ChillduinoPortB::pins() = 0x02;
+  assert(!DefrostSwitch::read());
+  assert(ModeSwitch::read());
+  assert(DefrostSwitch::isSet(switches));
+}
+
+void sendTelemetry(ChillduinoAnomalyDetector &detector, long device,
+    unsigned char id, unsigned int value) {
+  unsigned char buffer[8];
+  ChillhubFrame frame;
+
+  chillhubWriteU16(buffer, id, value);
+  ChillhubFrameParser(buffer, 5).next(frame);
+  detector.update(device, frame);
+}
+
+void shouldFlagStuckCompressorsDoorsAndFailingDefrosts(void) {
+  ChillduinoAnomalyDetector detector(5, 370);
+
+  detector
+    .setCompressorRunLimit(10)
+    .setDoorOpenLimit(5)
+    .setDefrostTimeoutLimit(2);
+
+  for (long device = 0; device < 5; device++) {
+    sendTelemetry(detector, device, CHILLDUINO_THERMISTOR_ID, 380);
+  }
+
+  // the second compressor reaches the band once, the first never does
+  sendTelemetry(detector, 0, CHILLDUINO_COMPRESSOR_ID, 1);
+  sendTelemetry(detector, 1, CHILLDUINO_COMPRESSOR_ID, 1);
+  sendTelemetry(detector, 2, CHILLDUINO_DOOR_ID, 1);
+
+  for (int i = 0; i < 12; i++) {
+    sendTelemetry(detector, 1, CHILLDUINO_THERMISTOR_ID, i == 3 ? 369 : 380);
+    detector.sample();
+  }
+
+  assert(detector.getAnomalies(0) == CHILLDUINO_ANOMALY_COMPRESSOR_STUCK);
+  assert(detector.getAnomalies(1) == 0);
+  assert(detector.getAnomalies(2) == CHILLDUINO_ANOMALY_DOOR_STUCK);
+  assert(detector.getCompressorRunSamples(1) == 12);
+  assert(detector.getDoorOpenSamples(2) == 12);
+  assert(detector.getThermistorAverage(0) == 380 * 16);
+  assert(detector.getCompressorDutyCycle(0) > 0);
+  assert(detector.getCompressorDutyCycle(3) == 0);
+
+  sendTelemetry(detector, 0, CHILLDUINO_COMPRESSOR_ID, 0);
+  sendTelemetry(detector, 2, CHILLDUINO_DOOR_ID, 0);
+
+  // the third unit's defrosts time out, the fourth's are cut off by a
+  // bimetal pulse that is over before the next sample
+  for (int i = 0; i < 2; i++) {
+    sendTelemetry(detector, 3, CHILLDUINO_DEFROST_ID, 1);
+    sendTelemetry(detector, 4, CHILLDUINO_DEFROST_ID, 1);
+    detector.sample();
+    sendTelemetry(detector, 3, CHILLDUINO_DEFROST_ID, 0);
+    sendTelemetry(detector, 4, CHILLDUINO_BIMETAL_ID, 1);
+    sendTelemetry(detector, 4, CHILLDUINO_DEFROST_ID, 0);
+    sendTelemetry(detector, 4, CHILLDUINO_BIMETAL_ID, 0);
+    detector.sample();
+  }
+
+  assert(detector.getAnomalies(0) == 0);
+  assert(detector.getAnomalies(2) == 0);
+  assert(detector.getAnomalies(3) == CHILLDUINO_ANOMALY_DEFROST_FAILING);
+  assert(detector.getAnomalies(4) == 0);
+  assert(detector.getDefrostTimeouts(3) == 2);
+  assert(detector.getDefrostTimeouts(4) == 0);
+  assert(detector.getSamples() == 16);
+}
+
+void shouldScoreAnomaliesTheSameWithAndWithoutSse2(void) {
+  const unsigned long devices = 37;
+  ChillduinoAnomalyDetector vector(devices, 370);
+  ChillduinoAnomalyDetector scalar(devices, 370);
+  unsigned long random = 777;
+
+  vector.setCompressorRunLimit(6).setDoorOpenLimit(4).setDefrostTimeoutLimit(2);
+  scalar.setCompressorRunLimit(6).setDoorOpenLimit(4).setDefrostTimeoutLimit(2)
+    .setVectorized(false);
+
+  for (unsigned long d = 0; d < devices; d += 5) {
+    vector.setColdReading(d, 390);
+    scalar.setColdReading(d, 390);
+  }
+
+  for (int i = 0; i < 2000; i++) {
+    for (unsigned long d = 0; d < devices; d++) {
+      random = random * 1103515245 + 12345;
+      unsigned long r = (random >> 8) & 0xFFFFFF;
+      int reading = 360 + (r >> 8) % 40;
+      int32_t state = 1 << (r & 3);
+      bool isSet = ((r >> 2) & 3) != 0;
+
+      vector.setReading(d, reading);
+      scalar.setReading(d, reading);
+
+      if ((r >> 4) & 1) {
+        vector.setState(d, state, isSet);
+        scalar.setState(d, state, isSet);
+      }
+    }
+
+    vector.sample();
+    scalar.sample();
+
+    for (unsigned long d = 0; d < devices; d++) {
+      assert(vector.getAnomalies(d) == scalar.getAnomalies(d));
+      assert(vector.getThermistorAverage(d) == scalar.getThermistorAverage(d));
+      assert(vector.getCompressorDutyCycle(d)
+        == scalar.getCompressorDutyCycle(d));
+      assert(vector.getCompressorRunSamples(d)
+        == scalar.getCompressorRunSamples(d));
+      assert(vector.getDoorOpenSamples(d) == scalar.getDoorOpenSamples(d));
+      assert(vector.getDefrostTimeouts(d) == scalar.getDefrostTimeouts(d));
+    }
+  }
+}
+
 int main(void) {
   shouldStartWithCompressorAndDefrostNotRunning();
   shouldStartCompressorWhenFreshFoodIsWarm();
@@ -435,6 +2096,52 @@ int main(void) {
   shouldTurnOffDefrostInOffMode();
   shouldLeaveOffCompressorAndDefrostInOffMode();
   shouldPersistCompressorRuntime();
+  shouldEncodeSlowlyChangingReadingsInOneBytePerSample();
+  shouldRejectSamplesWhenSeriesIsFull();
+  shouldParseFramesInPlaceAndKeepPartialFrames();
+  shouldTrackDevicesByUuid();
+  shouldApplyEveryConfiguredSettingInOneFrame();
+  shouldConfigureSettingsPastTheSixteenthBit();
+  shouldRejectInvalidConfigurationFrames();
+  shouldTrackCompressorDutyCycleOverTheWindow();
+  shouldCountDefrostsByHowTheyEnded();
+  shouldCountDefrostsStoppedByTurningOffAsAborted();
+  shouldCountDoorOpensAndForcedDefrosts();
+  shouldKeepTheWindowWhenTicksWrap();
+  shouldNotCollectStatisticsUnlessEnabled();
+  shouldSkipIdleTicksWithoutChangingBehavior();
+  shouldSimulatePlantAsIfTickedEveryTick();
+  shouldExtrapolateSteadyStateCycles();
+  shouldSimulateFleetAsIfEachUnitTickedEveryTick();
+  shouldRunScenariosOnASharedClock();
+  shouldWaitForCompressorLockoutBeforeForcedDefrost();
+  shouldNotForceDefrostWhenOff();
+  shouldDefrostNoSoonerThanMinimumWhenDoorIsHeldOpen();
+  shouldHoldSafetyInvariantsForRandomInputSchedules();
+  shouldWriteAndMapColumnsChunkByChunk();
+  shouldCoolOneZoneAtATimeByPriority();
+  shouldDefrostEachZoneOnItsOwnSchedule();
+  shouldDefrostZoneSoonerWhenItsDoorIsOpened();
+  shouldStopEveryZoneInOffMode();
+  shouldSkipIdleTicksInEveryZone();
+  shouldConvertReadingsWithinToleranceOfBetaEquation();
+  shouldConvertTemperatureSettingsToNearestReading();
+  shouldLengthenAdaptiveDefrostIntervalWhenBimetalCutsOffEarly();
+  shouldShortenAdaptiveDefrostIntervalWhenDefrostTimesOut();
+  shouldSimulateFrostAsIfTickedEveryTick();
+  shouldCycleThroughModeProfilesInTableOrder();
+  shouldOverrideCompressorLockoutOnlyWhileInModeProfile();
+  shouldApplyConfiguredBandOverModeProfile();
+  shouldSelectEveryModeProfileByFrame();
+  shouldDelayFirstCompressorStartByStartDelay();
+  shouldDeferCompressorStartsWithinShedMargin();
+  shouldMoveShedLimitWithTheMode();
+  shouldStaggerCompressorStartsAfterPowerIsRestored();
+  shouldStopCompressorEarlyByLearnedCoast();
+  shouldCatchUpElapsedTicksInOneLoop();
+  shouldDriveRelaysAndReadSwitchesThroughPorts();
+  shouldFlagStuckCompressorsDoorsAndFailingDefrosts();
+  shouldScoreAnomaliesTheSameWithAndWithoutSse2();
 
   return 0;
 }